@@ -22,6 +22,7 @@
 #define __DJVU_DOCUMENT_INTERNAL_H__
 
 #include "djvu-document.h"
+#include "djvu-text-index.h"
 
 #include <libdjvu/ddjvuapi.h>
 
@@ -41,6 +42,9 @@ struct _DjvuDocument {
 	ddjvu_fileinfo_t *fileinfo_pages;
 	gint		  n_pages;
 	GHashTable	 *file_ids;
+
+	/* Text of the pages searched so far, protected by the doc mutex */
+	DjvuTextIndex	**text_indexes;
 };
 
 int  djvu_document_get_n_pages (EvDocument   *document);
@@ -22,6 +22,7 @@
 #include <config.h>
 #include "djvu-document.h"
 #include "djvu-text-page.h"
+#include "djvu-text-index.h"
 #include "djvu-links.h"
 #include "djvu-document-private.h"
 #include "ev-file-exporter.h"
@@ -491,6 +492,14 @@ djvu_document_finalize (GObject *object)
 	if (djvu_document->file_ids)
 	    g_hash_table_destroy (djvu_document->file_ids);
 
+	if (djvu_document->text_indexes) {
+		gint i;
+
+		for (i = 0; i < djvu_document->n_pages; i++)
+			djvu_text_index_free (djvu_document->text_indexes[i]);
+		g_free (djvu_document->text_indexes);
+	}
+
 	ddjvu_context_release (djvu_document->d_context);
 	ddjvu_format_release (djvu_document->d_format);
 	ddjvu_format_release (djvu_document->thumbs_format);
@@ -791,35 +800,46 @@ djvu_document_init (DjvuDocument *djvu_document)
 	djvu_document->d_document = NULL;
 }
 
-static GList *
-djvu_document_find_find_text (EvDocumentFind   *document,
-			      EvPage           *page,
-			      const char       *text,
-			      gboolean          case_sensitive)
+static DjvuTextIndex *
+djvu_document_get_text_index (DjvuDocument *djvu_document,
+			      gint          page)
 {
-        DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
 	miniexp_t page_text;
-	gdouble width, height, dpi;
-	GList *matches = NULL, *l;
 
-	g_return_val_if_fail (text != NULL, NULL);
+	if (!djvu_document->text_indexes)
+		djvu_document->text_indexes = g_new0 (DjvuTextIndex *, djvu_document->n_pages);
+
+	if (djvu_document->text_indexes[page])
+		return djvu_document->text_indexes[page];
 
 	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
+							 page,
 							 "char")) == miniexp_dummy)
 		djvu_handle_events (djvu_document, TRUE, NULL);
 
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-		
-		djvu_text_page_index_text (tpage, case_sensitive);
-		if (tpage->links->len > 0) {
-			djvu_text_page_search (tpage, text);
-			matches = tpage->results;
-		}
-		djvu_text_page_free (tpage);
+	djvu_document->text_indexes[page] = djvu_text_index_new (page_text);
+	if (page_text != miniexp_nil)
 		ddjvu_miniexp_release (djvu_document->d_document, page_text);
-	}
+
+	return djvu_document->text_indexes[page];
+}
+
+static GList *
+djvu_document_find_find_text_with_options (EvDocumentFind   *document,
+					    EvPage           *page,
+					    const char       *text,
+					    EvFindOptions     options)
+{
+        DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
+	DjvuTextIndex *index;
+	const gchar *patterns[] = { text, NULL };
+	gdouble width, height, dpi;
+	GList *matches, *l;
+
+	g_return_val_if_fail (text != NULL, NULL);
+
+	index = djvu_document_get_text_index (djvu_document, page->index);
+	matches = djvu_text_index_search (index, patterns, options);
 	if (!matches)
 		return NULL;
 
@@ -828,8 +848,6 @@ djvu_document_find_find_text (EvDocumentFind   *document,
 		EvRectangle *r = (EvRectangle *)l->data;
 		gdouble      tmp;
 
-		tmp = r->y1;
-		
 		r->x1 *= 72.0 / dpi;
 		r->x2 *= 72.0 / dpi;
 
@@ -837,21 +855,33 @@ djvu_document_find_find_text (EvDocumentFind   *document,
 		r->y1 = height - r->y2 * 72.0 / dpi;
 		r->y2 = height - tmp * 72.0 / dpi;
 	}
-	
 
 	return matches;
 }
 
+static GList *
+djvu_document_find_find_text (EvDocumentFind   *document,
+			      EvPage           *page,
+			      const char       *text,
+			      gboolean          case_sensitive)
+{
+	return djvu_document_find_find_text_with_options (document, page, text,
+							  case_sensitive ?
+							  EV_FIND_CASE_SENSITIVE :
+							  EV_FIND_DEFAULT);
+}
+
 static EvFindOptions
 djvu_document_find_get_supported_options (EvDocumentFind *document)
 {
-	return EV_FIND_CASE_SENSITIVE;
+	return EV_FIND_CASE_SENSITIVE | EV_FIND_WHOLE_WORDS_ONLY;
 }
 
 static void
 djvu_document_find_iface_init (EvDocumentFindInterface *iface)
 {
         iface->find_text = djvu_document_find_find_text;
+	iface->find_text_with_options = djvu_document_find_find_text_with_options;
 	iface->get_supported_options = djvu_document_find_get_supported_options;
 }
 
@@ -0,0 +1,322 @@
+/*
+ * Searchable text of a DjVu page
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "djvu-text-index.h"
+
+/* Page coordinates are stored in 16 bits, enough for a A0 page at 600 dpi */
+typedef struct {
+	guint32 position;
+	guint32 folded_position;
+	guint16 x1, y1, x2, y2;
+} DjvuTextToken;
+
+struct _DjvuTextIndex {
+	gchar         *text;
+	gchar         *folded;
+	DjvuTextToken *tokens;
+	guint          n_tokens;
+};
+
+typedef struct {
+	GString   *text;
+	GString   *folded;
+	GArray    *tokens;
+	miniexp_t  char_symbol;
+} DjvuTextIndexBuilder;
+
+typedef struct {
+	guint start;
+	guint end;
+} DjvuTextMatch;
+
+static guint16
+djvu_text_index_coord (miniexp_t p,
+		       int       n)
+{
+	return CLAMP (miniexp_to_int (miniexp_nth (n, p)), 0, G_MAXUINT16);
+}
+
+static void
+djvu_text_index_append_text (DjvuTextIndexBuilder *builder,
+			     miniexp_t             p,
+			     gboolean              delimit)
+{
+	miniexp_t deeper;
+
+	g_return_if_fail (miniexp_consp (p) &&
+			  miniexp_symbolp (miniexp_car (p)));
+
+	delimit |= builder->char_symbol != miniexp_car (p);
+
+	deeper = miniexp_cddr (miniexp_cdddr (p));
+	while (deeper != miniexp_nil) {
+		miniexp_t data = miniexp_car (deeper);
+
+		if (miniexp_stringp (data)) {
+			DjvuTextToken token;
+			const char   *token_text;
+			char         *folded_text;
+
+			if (delimit && builder->text->len > 0) {
+				g_string_append_c (builder->text, ' ');
+				g_string_append_c (builder->folded, ' ');
+			}
+
+			token.position = builder->text->len;
+			token.folded_position = builder->folded->len;
+			token.x1 = djvu_text_index_coord (p, 1);
+			token.y1 = djvu_text_index_coord (p, 2);
+			token.x2 = djvu_text_index_coord (p, 3);
+			token.y2 = djvu_text_index_coord (p, 4);
+			g_array_append_val (builder->tokens, token);
+
+			token_text = miniexp_to_str (data);
+			folded_text = g_utf8_casefold (token_text, -1);
+			g_string_append (builder->text, token_text);
+			g_string_append (builder->folded, folded_text);
+			g_free (folded_text);
+		} else {
+			djvu_text_index_append_text (builder, data, delimit);
+		}
+		delimit = FALSE;
+		deeper = miniexp_cdr (deeper);
+	}
+}
+
+/**
+ * djvu_text_index_new:
+ * @text: S-expression of the page text, or miniexp_nil
+ *
+ * Extracts the text of a page. The s-expression can be released
+ * afterwards.
+ *
+ * Returns: new #DjvuTextIndex instance
+ */
+DjvuTextIndex *
+djvu_text_index_new (miniexp_t text)
+{
+	DjvuTextIndex        *index;
+	DjvuTextIndexBuilder  builder;
+
+	index = g_slice_new0 (DjvuTextIndex);
+	if (text == miniexp_nil)
+		return index;
+
+	builder.text = g_string_new (NULL);
+	builder.folded = g_string_new (NULL);
+	builder.tokens = g_array_new (FALSE, FALSE, sizeof (DjvuTextToken));
+	builder.char_symbol = miniexp_symbol ("char");
+
+	djvu_text_index_append_text (&builder, text, FALSE);
+
+	index->n_tokens = builder.tokens->len;
+	index->tokens = (DjvuTextToken *) g_array_free (builder.tokens, FALSE);
+	index->text = g_string_free (builder.text, FALSE);
+	index->folded = g_string_free (builder.folded, FALSE);
+
+	return index;
+}
+
+/**
+ * djvu_text_index_free:
+ * @index: #DjvuTextIndex instance
+ *
+ * Frees the given #DjvuTextIndex instance.
+ */
+void
+djvu_text_index_free (DjvuTextIndex *index)
+{
+	if (!index)
+		return;
+
+	g_free (index->text);
+	g_free (index->folded);
+	g_free (index->tokens);
+	g_slice_free (DjvuTextIndex, index);
+}
+
+/**
+ * djvu_text_index_token:
+ * @index: #DjvuTextIndex instance
+ * @position: index in the page text
+ * @folded: whether @position is in the case folded text
+ *
+ * Returns: the last token starting at or before @position
+ */
+static guint
+djvu_text_index_token (DjvuTextIndex *index,
+		       guint          position,
+		       gboolean       folded)
+{
+	guint low = 0;
+	guint hi = index->n_tokens;
+
+	while (hi - low > 1) {
+		guint   mid = (low + hi) / 2;
+		guint32 token_position;
+
+		token_position = folded ?
+			index->tokens[mid].folded_position :
+			index->tokens[mid].position;
+		if (token_position <= position)
+			low = mid;
+		else
+			hi = mid;
+	}
+
+	return low;
+}
+
+static gboolean
+djvu_text_index_is_word_boundary (const gchar *haystack,
+				  const gchar *match,
+				  const gchar *match_end)
+{
+	if (match > haystack &&
+	    g_unichar_isalnum (g_utf8_get_char (g_utf8_prev_char (match))))
+		return FALSE;
+
+	if (*match_end != '\0' &&
+	    g_unichar_isalnum (g_utf8_get_char (match_end)))
+		return FALSE;
+
+	return TRUE;
+}
+
+static gint
+djvu_text_match_compare (gconstpointer a,
+			 gconstpointer b)
+{
+	const DjvuTextMatch *match_a = a;
+	const DjvuTextMatch *match_b = b;
+
+	if (match_a->start != match_b->start)
+		return match_a->start < match_b->start ? -1 : 1;
+	if (match_a->end != match_b->end)
+		return match_a->end < match_b->end ? -1 : 1;
+
+	return 0;
+}
+
+static EvRectangle *
+djvu_text_index_box (DjvuTextIndex *index,
+		     guint          start,
+		     guint          end)
+{
+	EvRectangle *box;
+	guint        i;
+
+	box = ev_rectangle_new ();
+	box->x1 = index->tokens[start].x1;
+	box->y1 = index->tokens[start].y1;
+	box->x2 = index->tokens[start].x2;
+	box->y2 = index->tokens[start].y2;
+
+	for (i = start + 1; i <= end; i++) {
+		DjvuTextToken *token = &index->tokens[i];
+
+		box->x1 = MIN (box->x1, token->x1);
+		box->y1 = MIN (box->y1, token->y1);
+		box->x2 = MAX (box->x2, token->x2);
+		box->y2 = MAX (box->y2, token->y2);
+	}
+
+	return box;
+}
+
+/**
+ * djvu_text_index_search:
+ * @index: #DjvuTextIndex instance
+ * @patterns: %NULL terminated array of texts to search
+ * @options: #EvFindOptions
+ *
+ * Searches the page for any of the given texts, in a single pass over
+ * the page per text.
+ *
+ * Returns: the bounding boxes of the matches in page coordinates, in
+ * reading order. The list has to be externally freed afterwards.
+ */
+GList *
+djvu_text_index_search (DjvuTextIndex       *index,
+			const gchar * const *patterns,
+			EvFindOptions        options)
+{
+	gboolean     case_sensitive = (options & EV_FIND_CASE_SENSITIVE) != 0;
+	const gchar *haystack;
+	GArray      *matches;
+	GList       *results = NULL;
+	guint        i;
+
+	if (index->n_tokens == 0)
+		return NULL;
+
+	haystack = case_sensitive ? index->text : index->folded;
+	matches = g_array_new (FALSE, FALSE, sizeof (DjvuTextMatch));
+
+	for (i = 0; patterns[i]; i++) {
+		const gchar *match;
+		gchar       *needle;
+		gsize        needle_len;
+
+		needle = case_sensitive ?
+			g_strdup (patterns[i]) :
+			g_utf8_casefold (patterns[i], -1);
+		needle_len = strlen (needle);
+		if (needle_len == 0) {
+			g_free (needle);
+			continue;
+		}
+
+		match = haystack;
+		while ((match = strstr (match, needle)) != NULL) {
+			DjvuTextMatch m;
+
+			if ((options & EV_FIND_WHOLE_WORDS_ONLY) &&
+			    !djvu_text_index_is_word_boundary (haystack, match,
+							       match + needle_len)) {
+				match = g_utf8_next_char (match);
+				continue;
+			}
+
+			m.start = djvu_text_index_token (index, match - haystack,
+							 !case_sensitive);
+			m.end = djvu_text_index_token (index, match - haystack + needle_len - 1,
+						       !case_sensitive);
+			g_array_append_val (matches, m);
+
+			match += needle_len;
+		}
+		g_free (needle);
+	}
+
+	if (patterns[0] && patterns[1])
+		g_array_sort (matches, djvu_text_match_compare);
+
+	for (i = matches->len; i > 0; i--) {
+		DjvuTextMatch *m = &g_array_index (matches, DjvuTextMatch, i - 1);
+
+		results = g_list_prepend (results,
+					  djvu_text_index_box (index, m->start, m->end));
+	}
+	g_array_free (matches, TRUE);
+
+	return results;
+}
@@ -0,0 +1,40 @@
+/*
+ * Searchable text of a DjVu page
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __DJVU_TEXT_INDEX_H__
+#define __DJVU_TEXT_INDEX_H__
+
+#include "ev-document-find.h"
+
+#include <glib.h>
+#include <libdjvu/miniexp.h>
+
+/*
+ * The text of a page extracted once from its s-expression, in its
+ * original and case folded forms, with the position and bounding box
+ * of every token. Searching it does not need the s-expression anymore.
+ */
+typedef struct _DjvuTextIndex DjvuTextIndex;
+
+DjvuTextIndex *djvu_text_index_new    (miniexp_t            text);
+void           djvu_text_index_free   (DjvuTextIndex       *index);
+GList         *djvu_text_index_search (DjvuTextIndex       *index,
+				       const gchar * const *patterns,
+				       EvFindOptions        options);
+
+#endif /* __DJVU_TEXT_INDEX_H__ */
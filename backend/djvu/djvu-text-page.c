@@ -249,137 +249,6 @@ djvu_text_page_copy (DjvuTextPage *page,
 	return text;
 }
 
-/**
- * djvu_text_page_position:
- * @page: #DjvuTextPage instance
- * @position: index in the page text
- * 
- * Returns the closest s-expression that contains the given position in 
- * the page text.
- * 
- * Returns: closest s-expression
- */
-static miniexp_t
-djvu_text_page_position (DjvuTextPage *page, 
-			 int           position)
-{
-	GArray *links = page->links;
-	int low = 0;
-	int hi = links->len - 1;
-	int mid = 0;
-
-	g_return_val_if_fail (hi >= 0, miniexp_nil);
-
-	/* Shamelessly copied from GNU classpath */
-	while (low <= hi) {
-                DjvuTextLink *link;
-
-		mid = (low + hi) >> 1;
-		link = &g_array_index (links, DjvuTextLink, mid);
-		if (link->position == position)
-			break;
-		else if (link->position > position)
-			hi = --mid;
-		else
-			low = mid + 1;
-	}
-
-	return g_array_index (page->links, DjvuTextLink, mid).pair;
-}
-
-/**
- * djvu_text_page_sexpr_process:
- * @page: #DjvuTextPage instance
- * @p: s-expression to append
- * @start: first s-expression in the selection
- * @end: last s-expression in the selection
- * 
- * Appends the rectangle defined by @p to the internal bounding box rectangle.
- * 
- * Returns: whether the end was not reached in this s-expression
- */
-static gboolean
-djvu_text_page_sexpr_process (DjvuTextPage *page, 
-                              miniexp_t     p,
-                              miniexp_t     start, 
-                              miniexp_t     end)
-{
-	if (page->bounding_box || p == start) {
-		EvRectangle *new_rectangle = ev_rectangle_new ();
-		new_rectangle->x1 = miniexp_to_int (miniexp_nth (1, p));
-		new_rectangle->y1 = miniexp_to_int (miniexp_nth (2, p));
-		new_rectangle->x2 = miniexp_to_int (miniexp_nth (3, p));
-		new_rectangle->y2 = miniexp_to_int (miniexp_nth (4, p));
-		if (page->bounding_box) {
-			djvu_text_page_union (page->bounding_box,
-					      new_rectangle);
-			g_free (new_rectangle);
-		} else
-			page->bounding_box = new_rectangle;
-		if (p == end)
-			return FALSE;
-	}
-	return TRUE;
-}
-
-/**
- * djvu_text_page_sexpr:
- * @page: #DjvuTextPage instance
- * @p: tree to append
- * @start: first s-expression in the selection
- * @end: last s-expression in the selection
- * 
- * Walks the tree in @p and extends the rectangle with 
- * djvu_text_page_process() for all s-expressions between @start and @end.
- * 
- * Returns: whether the end was not reached in this subtree
- */
-static gboolean
-djvu_text_page_sexpr (DjvuTextPage *page, 
-		      miniexp_t p,
-		      miniexp_t start, 
-		      miniexp_t end)
-{
-        miniexp_t deeper;
-
-	g_return_val_if_fail (miniexp_consp (p) && miniexp_symbolp
-			      (miniexp_car (p)), FALSE);
-
-	deeper = miniexp_cddr (miniexp_cdddr (p));
-	while (deeper != miniexp_nil) {
-		miniexp_t str = miniexp_car (deeper);
-		if (miniexp_stringp (str)) {
-			if (!djvu_text_page_sexpr_process
-			    (page, p, start, end))
-				return FALSE;
-		} else {
-			if (!djvu_text_page_sexpr
-			    (page, str, start, end))
-				return FALSE;
-		}
-		deeper = miniexp_cdr (deeper);
-	}
-	return TRUE;
-}
-
-/**
- * djvu_text_page_box:
- * @page: #DjvuTextPage instance
- * @start: first s-expression in the selection
- * @end: last s-expression in the selection
- * 
- * Builds a rectangle that contains all s-expressions in the given range.
- */
-static EvRectangle *
-djvu_text_page_box (DjvuTextPage *page,
-		    miniexp_t     start, 
-		    miniexp_t     end)
-{
-	page->bounding_box = NULL;
-	djvu_text_page_sexpr (page, page->text_structure, start, end);
-	return page->bounding_box;
-}
-
 /**
  * djvu_text_page_append_search:
  * @page: #DjvuTextPage instance
@@ -436,39 +305,6 @@ djvu_text_page_append_text (DjvuTextPage *page,
 	}
 }
 
-/**
- * djvu_text_page_search:
- * @page: #DjvuTextPage instance
- * @text: text to search
- * 
- * Searches the page for the given text. The results list has to be 
- * externally freed afterwards.
- */
-void 
-djvu_text_page_search (DjvuTextPage *page, 
-		       const char   *text)
-{
-	char *haystack = page->text;
-	int search_len;
-	EvRectangle *result;
-	if (page->links->len == 0)
-		return;
-
-	search_len = strlen (text);
-	while ((haystack = strstr (haystack, text)) != NULL) {
-		int start_p = haystack - page->text;
-		miniexp_t start = djvu_text_page_position (page, start_p);
-		int end_p = start_p + search_len - 1;
-		miniexp_t end = djvu_text_page_position (page, end_p);
-		result = djvu_text_page_box (page, start, end);
-		g_assert (result);
-		page->results = g_list_prepend (page->results, result);
-		haystack = haystack + search_len;
-	}
-	page->results = g_list_reverse (page->results);
-}
-
-
 /**
  * djvu_text_page_index_text:
  * @page: #DjvuTextPage instance
@@ -35,7 +35,6 @@ struct _DjvuTextPage {
 	GList *results;
 	miniexp_t char_symbol;
 	miniexp_t word_symbol;
-	EvRectangle *bounding_box;
 	miniexp_t text_structure;
 	miniexp_t start;
 	miniexp_t end;
@@ -57,8 +56,6 @@ char         *djvu_text_page_copy                 (DjvuTextPage *page,
                                                    EvRectangle  *rectangle);
 void          djvu_text_page_index_text           (DjvuTextPage *page,
                                                    gboolean      case_sensitive);
-void          djvu_text_page_search               (DjvuTextPage *page,
-                                                   const char   *text);
 DjvuTextPage *djvu_text_page_new                  (miniexp_t     text);
 void          djvu_text_page_free                 (DjvuTextPage *page);
 
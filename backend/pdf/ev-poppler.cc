@@ -146,10 +146,26 @@ pdf_document_dispose (GObject *object)
 		pdf_document->annots = NULL;
 	}
 
+	if (pdf_document->dests) {
+		g_hash_table_destroy (pdf_document->dests);
+		pdf_document->dests = NULL;
+	}
+
 	if (pdf_document->document) {
 		g_object_unref (pdf_document->document);
 	}
 
+	/* The document reads from the mapping until it's destroyed */
+	if (pdf_document->mapped_data) {
+		g_bytes_unref (pdf_document->mapped_data);
+		pdf_document->mapped_data = NULL;
+	}
+
+	if (pdf_document->display_lists) {
+		ev_display_list_cache_free (pdf_document->display_lists);
+		pdf_document->display_lists = NULL;
+	}
+
 	if (pdf_document->font_info) { 
 		poppler_font_info_free (pdf_document->font_info);
 	}
@@ -159,8 +175,8 @@ pdf_document_dispose (GObject *object)
 	}
 
 	if (pdf_document->converter) {
-		g_object_unref (pspdf_document->converter);
-		pspdf_document->converter = NULL;
+		g_object_unref (pdf_document->converter);
+		pdf_document->converter = NULL;
 	}
 
 	G_OBJECT_CLASS (pdf_document_parent_class)->dispose (object);
@@ -170,6 +186,7 @@ static void
 pdf_document_init (PdfDocument *pdf_document)
 {
 	pdf_document->password = NULL;
+	pdf_document->display_lists = ev_display_list_cache_new ();
 }
 
 static void
@@ -228,21 +245,6 @@ pdf_document_save (EvDocument  *document,
 }
 
 
-static void
-conversion_finished (PSPDFConverter *converter,
-                     PdfDocument  *pdf_document)
-{
-	GString* data;
-	GError * poppler_error = NULL;
-
-	data = pspdf_converter_get_data(converter);
-	/* FIXME: Check for error */
-	pdf_document->document = poppler_document_new_from_data (data->str,
-			data->len,
-			NULL,
-			NULL);
-}
-
 static gboolean
 pdf_document_load (EvDocument   *document,
 		   const char   *uri,
@@ -253,6 +255,8 @@ pdf_document_load (EvDocument   *document,
 	PdfDocument *pdf_document = PDF_DOCUMENT (document);
 	gchar *mime_type;
 	gchar *filename;
+	gchar *converted_uri = NULL;
+	GBytes *mapped_data;
 
 	mime_type = ev_file_get_mime_type (uri, FALSE, &mime_error);
 	if (mime_type == NULL) {
@@ -264,36 +268,58 @@ pdf_document_load (EvDocument   *document,
 	g_free (mime_error);
 
 	if (g_content_type_equals (mime_type, "application/postscript")) {
-		/* FIXME: fill error */
+		g_free (mime_type);
+
 		filename = g_filename_from_uri (uri, NULL, error);
 		if (!filename)
-			g_return_val_if_fail (mime_type != NULL, FALSE);
+			return FALSE;
 
+		/* The converted document is written to the user cache,
+		 * and loaded from there like any other PDF file.
+		 */
+		if (pdf_document->converter)
+			g_object_unref (pdf_document->converter);
 		pdf_document->converter = pspdf_converter_new (filename);
+		g_free (filename);
 
-		g_signal_connect (G_OBJECT (pdf_document->converter), "conversion_finished",
-				  G_CALLBACK (conversion_finished),
-				  pdf_document);
-		pspdf_converter_start_sync(pdf_document->converter);
+		if (!pspdf_converter_convert_sync (pdf_document->converter, error))
+			return FALSE;
 
-		/*
-		pspdf_document->uri = g_strdup (uri);
-
-		g_warning ("load: %s", uri);
-
-		return FALSE;
-		*/
-		return TRUE;
+		converted_uri = g_filename_to_uri (pspdf_converter_get_output_file (pdf_document->converter),
+						   NULL, error);
+		if (!converted_uri)
+			return FALSE;
+		uri = converted_uri;
+	} else {
+		g_free (mime_type);
+	}
+
+	/* Poppler reads the mapped pages directly, they are shared with the
+	 * page cache and with other documents mapping the same file.
+	 */
+	mapped_data = ev_file_map (uri, NULL);
+	if (mapped_data && g_bytes_get_size (mapped_data) <= G_MAXINT) {
+		pdf_document->document =
+			poppler_document_new_from_data ((char *) g_bytes_get_data (mapped_data, NULL),
+							g_bytes_get_size (mapped_data),
+							pdf_document->password, &poppler_error);
+	} else {
+		pdf_document->document =
+			poppler_document_new_from_file (uri, pdf_document->password, &poppler_error);
 	}
-
-	pdf_document->document =
-		poppler_document_new_from_file (uri, pdf_document->password, &poppler_error);
+	g_free (converted_uri);
 
 	if (pdf_document->document == NULL) {
+		if (mapped_data)
+			g_bytes_unref (mapped_data);
 		convert_error (poppler_error, error);
 		return FALSE;
 	}
 
+	if (pdf_document->mapped_data)
+		g_bytes_unref (pdf_document->mapped_data);
+	pdf_document->mapped_data = mapped_data;
+
 	return TRUE;
 }
 
@@ -393,14 +419,23 @@ pdf_document_get_page_label (EvDocument *document,
 	return label;
 }
 
+static void
+pdf_page_draw (cairo_t *cr,
+	       gpointer page)
+{
+	poppler_page_render (POPPLER_PAGE (page), cr);
+}
+
 static cairo_surface_t *
-pdf_page_render (PopplerPage     *page,
+pdf_page_render (PdfDocument     *pdf_document,
+		 PopplerPage     *page,
 		 gint             width,
 		 gint             height,
 		 EvRenderContext *rc)
 {
 	cairo_surface_t *surface;
 	cairo_t *cr;
+	double width_points, height_points;
 
 	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
 					      width, height);
@@ -421,7 +456,11 @@ pdf_page_render (PopplerPage     *page,
 	}
 	cairo_scale (cr, rc->scale, rc->scale);
 	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
-	poppler_page_render (page, cr);
+	poppler_page_get_size (page, &width_points, &height_points);
+	ev_display_list_cache_draw (pdf_document->display_lists,
+				    rc->page->index,
+				    width_points, height_points,
+				    cr, pdf_page_draw, page);
 
 	cairo_set_operator (cr, CAIRO_OPERATOR_DEST_OVER);
 	cairo_set_source_rgb (cr, 1., 1., 1.);
@@ -453,10 +492,135 @@ pdf_document_render (EvDocument      *document,
 		height = (int) ((height_points * rc->scale) + 0.5);
 	}
 	
-	return pdf_page_render (poppler_page,
+	return pdf_page_render (PDF_DOCUMENT (document), poppler_page,
 				width, height, rc);
 }
 
+static gboolean
+pdf_document_render_region (EvDocument           *document,
+			    EvRenderContext      *rc,
+			    cairo_surface_t      *surface,
+			    const cairo_region_t *region)
+{
+	PopplerPage *poppler_page;
+	double width_points, height_points;
+	gint width, height;
+	cairo_t *cr;
+	gint n_rects, i;
+
+	poppler_page = POPPLER_PAGE (rc->page->backend_page);
+
+	poppler_page_get_size (poppler_page,
+			       &width_points, &height_points);
+
+	if (rc->rotation == 90 || rc->rotation == 270) {
+		width = (int) ((height_points * rc->scale) + 0.5);
+		height = (int) ((width_points * rc->scale) + 0.5);
+	} else {
+		width = (int) ((width_points * rc->scale) + 0.5);
+		height = (int) ((height_points * rc->scale) + 0.5);
+	}
+
+	cr = cairo_create (surface);
+
+	n_rects = cairo_region_num_rectangles (region);
+	for (i = 0; i < n_rects; i++) {
+		cairo_rectangle_int_t rect;
+
+		cairo_region_get_rectangle (region, i, &rect);
+		cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+	}
+	cairo_clip (cr);
+
+	/* Same steps as pdf_page_render() inside the clip, so that the
+	 * pixels match the ones of a full render.
+	 */
+	cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint (cr);
+	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+	switch (rc->rotation) {
+	        case 90:
+			cairo_translate (cr, width, 0);
+			break;
+	        case 180:
+			cairo_translate (cr, width, height);
+			break;
+	        case 270:
+			cairo_translate (cr, 0, height);
+			break;
+	        default:
+			cairo_translate (cr, 0, 0);
+	}
+	cairo_scale (cr, rc->scale, rc->scale);
+	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
+	ev_display_list_cache_draw (PDF_DOCUMENT (document)->display_lists,
+				    rc->page->index,
+				    width_points, height_points,
+				    cr, pdf_page_draw, poppler_page);
+
+	cairo_identity_matrix (cr);
+	cairo_set_operator (cr, CAIRO_OPERATOR_DEST_OVER);
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_paint (cr);
+
+	cairo_destroy (cr);
+
+	return TRUE;
+}
+
+/* Embedded thumbnails up to this fraction smaller or bigger than the
+ * requested size are rescaled instead of rendering the page
+ */
+#define EMBEDDED_THUMBNAIL_SIZE_TOLERANCE   0.25
+#define EMBEDDED_THUMBNAIL_ASPECT_TOLERANCE 0.05
+
+/* Renders a thumbnail in draft quality: without the annotations, which
+ * are parsed and drawn separately by poppler, and with the cheapest
+ * antialiasing. At thumbnail sizes the difference isn't visible.
+ */
+static cairo_surface_t *
+pdf_page_render_draft (PopplerPage     *page,
+		       gint             width,
+		       gint             height,
+		       EvRenderContext *rc)
+{
+	cairo_surface_t *surface;
+	cairo_t *cr;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					      width, height);
+	cr = cairo_create (surface);
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE (1, 12, 0)
+	cairo_set_antialias (cr, CAIRO_ANTIALIAS_FAST);
+#endif
+
+	switch (rc->rotation) {
+	        case 90:
+			cairo_translate (cr, width, 0);
+			break;
+	        case 180:
+			cairo_translate (cr, width, height);
+			break;
+	        case 270:
+			cairo_translate (cr, 0, height);
+			break;
+	        default:
+			cairo_translate (cr, 0, 0);
+	}
+	cairo_scale (cr, rc->scale, rc->scale);
+	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
+	poppler_page_render_for_printing_with_options (page, cr, POPPLER_PRINT_DOCUMENT);
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_DEST_OVER);
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_paint (cr);
+
+	cairo_destroy (cr);
+
+	return surface;
+}
+
 static GdkPixbuf *
 make_thumbnail_for_page (PopplerPage     *poppler_page,
 			 EvRenderContext *rc,
@@ -467,7 +631,7 @@ make_thumbnail_for_page (PopplerPage     *poppler_page,
 	cairo_surface_t *surface;
 
 	ev_document_fc_mutex_lock ();
-	surface = pdf_page_render (poppler_page, width, height, rc);
+	surface = pdf_page_render_draft (poppler_page, width, height, rc);
 	ev_document_fc_mutex_unlock ();
 	
 	pixbuf = ev_document_misc_pixbuf_from_surface (surface);
@@ -476,13 +640,56 @@ make_thumbnail_for_page (PopplerPage     *poppler_page,
 	return pixbuf;
 }
 
+/* Returns the embedded thumbnail of the page scaled to @width x @height,
+ * unrotated, if it's close enough to that size and has the same shape.
+ */
+static GdkPixbuf *
+get_embedded_thumbnail (PopplerPage *poppler_page,
+			gint         width,
+			gint         height)
+{
+	cairo_surface_t *surface;
+	GdkPixbuf *pixbuf;
+	GdkPixbuf *scaled_pixbuf;
+	gint thumb_width, thumb_height;
+	gdouble aspect, thumb_aspect;
+
+	if (!poppler_page_get_thumbnail_size (poppler_page, &thumb_width, &thumb_height))
+		return NULL;
+
+	if (thumb_width <= 0 || thumb_height <= 0 ||
+	    ABS (thumb_width - width) > width * EMBEDDED_THUMBNAIL_SIZE_TOLERANCE)
+		return NULL;
+
+	aspect = (gdouble)width / height;
+	thumb_aspect = (gdouble)thumb_width / thumb_height;
+	if (ABS (thumb_aspect - aspect) > aspect * EMBEDDED_THUMBNAIL_ASPECT_TOLERANCE)
+		return NULL;
+
+	surface = poppler_page_get_thumbnail (poppler_page);
+	if (!surface)
+		return NULL;
+
+	pixbuf = ev_document_misc_pixbuf_from_surface (surface);
+	cairo_surface_destroy (surface);
+
+	if (gdk_pixbuf_get_width (pixbuf) == width &&
+	    gdk_pixbuf_get_height (pixbuf) == height)
+		return pixbuf;
+
+	scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf, width, height,
+						 GDK_INTERP_BILINEAR);
+	g_object_unref (pixbuf);
+
+	return scaled_pixbuf;
+}
+
 static GdkPixbuf *
 pdf_document_get_thumbnail (EvDocument      *document,
 			    EvRenderContext *rc)
 {
 	PopplerPage *poppler_page;
-	cairo_surface_t *surface;
-	GdkPixbuf *pixbuf = NULL;
+	GdkPixbuf *pixbuf;
 	double page_width, page_height;
 	gint width, height;
 
@@ -494,6 +701,21 @@ pdf_document_get_thumbnail (EvDocument      *document,
 	width = MAX ((gint)(page_width * rc->scale + 0.5), 1);
 	height = MAX ((gint)(page_height * rc->scale + 0.5), 1);
 
+	pixbuf = get_embedded_thumbnail (poppler_page, width, height);
+	if (pixbuf) {
+		GdkPixbuf *rotated_pixbuf;
+
+		if (rc->rotation == 0)
+			return pixbuf;
+
+		rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf,
+							   (GdkPixbufRotation) (360 - rc->rotation));
+		g_object_unref (pixbuf);
+
+		return rotated_pixbuf;
+	}
+
+	/* There is no usable provided thumbnail. We need to make one. */
 	if (rc->rotation == 90 || rc->rotation == 270) {
 		gint  temp;
 
@@ -502,35 +724,7 @@ pdf_document_get_thumbnail (EvDocument      *document,
 		height = temp;
 	}
 
-	surface = poppler_page_get_thumbnail (poppler_page);
-	if (surface) {
-		pixbuf = ev_document_misc_pixbuf_from_surface (surface);
-		cairo_surface_destroy (surface);
-	}
-
-	if (pixbuf != NULL) {
-		int thumb_width = (rc->rotation == 90 || rc->rotation == 270) ?
-			gdk_pixbuf_get_height (pixbuf) :
-			gdk_pixbuf_get_width (pixbuf);
-
-		if (thumb_width == width) {
-			GdkPixbuf *rotated_pixbuf;
-
-			rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf,
-								   (GdkPixbufRotation) (360 - rc->rotation));
-			g_object_unref (pixbuf);
-			pixbuf = rotated_pixbuf;
-		} else {
-			/* The provided thumbnail has a different size */
-			g_object_unref (pixbuf);
-			pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
-		}
-	} else {
-		/* There is no provided thumbnail. We need to make one. */
-		pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
-	}
-
-	return pixbuf;
+	return make_thumbnail_for_page (poppler_page, rc, width, height);
 }
 
 /* reference:
@@ -959,6 +1153,7 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	ev_document_class->get_page_size = pdf_document_get_page_size;
 	ev_document_class->get_page_label = pdf_document_get_page_label;
 	ev_document_class->render = pdf_document_render;
+	ev_document_class->render_region = pdf_document_render_region;
 	ev_document_class->get_thumbnail = pdf_document_get_thumbnail;
 	ev_document_class->get_info = pdf_document_get_info;
 	ev_document_class->get_backend_info = pdf_document_get_backend_info;
@@ -1223,6 +1418,33 @@ pdf_document_links_has_document_links (EvDocumentLinks *document_links)
 	return TRUE;
 }
 
+/* Named destinations are resolved by poppler walking the document's
+ * name tree every time, so we keep the ones already resolved (including
+ * the ones that don't exist). It's always used with the doc mutex held.
+ */
+static PopplerDest *
+pdf_document_find_dest (PdfDocument *pdf_document,
+			const gchar *name)
+{
+	PopplerDest *dest;
+
+	if (!pdf_document->dests) {
+		pdf_document->dests = g_hash_table_new_full (g_str_hash,
+							     g_str_equal,
+							     g_free,
+							     (GDestroyNotify)poppler_dest_free);
+	}
+
+	if (g_hash_table_lookup_extended (pdf_document->dests, name,
+					  NULL, (gpointer *)&dest))
+		return dest;
+
+	dest = poppler_document_find_dest (pdf_document->document, name);
+	g_hash_table_insert (pdf_document->dests, g_strdup (name), dest);
+
+	return dest;
+}
+
 static EvLinkDest *
 ev_link_dest_from_dest (PdfDocument *pdf_document,
 			PopplerDest *dest)
@@ -1329,6 +1551,14 @@ ev_link_from_action (PdfDocument   *pdf_document,
 			dest = ev_link_dest_from_dest (pdf_document, action->goto_dest.dest);
 			ev_action = ev_link_action_new_dest (dest);
 			g_object_unref (dest);
+
+			/* Links are usually created from a job thread, resolve
+			 * named destinations now so that looking them up later
+			 * from the UI is a cache hit.
+			 */
+			if (action->goto_dest.dest->type == POPPLER_DEST_NAMED)
+				pdf_document_find_dest (pdf_document,
+							action->goto_dest.dest->named_dest);
 		}
 			break;
 	        case POPPLER_ACTION_GOTO_REMOTE: {
@@ -1419,13 +1649,23 @@ ev_link_from_action (PdfDocument   *pdf_document,
 	return link;	
 }
 
+#define PENDING_NODES_KEY "pdf-document-pending-nodes"
+
+/* Only the children of open outline items are built upfront, the other
+ * nodes get a placeholder child row, and the poppler iter needed to
+ * build their children later is kept in a table attached to the model,
+ * indexed by the row (GtkTreeStore iters are persistent).
+ */
 static void
 build_tree (PdfDocument      *pdf_document,
 	    GtkTreeModel     *model,
 	    GtkTreeIter      *parent,
 	    PopplerIndexIter *iter)
 {
-	
+	GHashTable *pending_nodes;
+
+	pending_nodes = (GHashTable *)g_object_get_data (G_OBJECT (model), PENDING_NODES_KEY);
+
 	do {
 		GtkTreeIter tree_iter;
 		PopplerIndexIter *child;
@@ -1462,9 +1702,15 @@ build_tree (PdfDocument      *pdf_document,
 		g_object_unref (link);
 		
 		child = poppler_index_iter_get_child (iter);
-		if (child)
+		if (child && !expand) {
+			GtkTreeIter placeholder;
+
+			gtk_tree_store_append (GTK_TREE_STORE (model), &placeholder, &tree_iter);
+			g_hash_table_insert (pending_nodes, tree_iter.user_data, child);
+		} else if (child) {
 			build_tree (pdf_document, model, &tree_iter, child);
-		poppler_index_iter_free (child);
+			poppler_index_iter_free (child);
+		}
 		poppler_action_free (action);
 		
 	} while (poppler_index_iter_next (iter));
@@ -1487,6 +1733,12 @@ pdf_document_links_get_links_model (EvDocumentLinks *document_links)
 							     G_TYPE_OBJECT,
 							     G_TYPE_BOOLEAN,
 							     G_TYPE_STRING);
+		g_object_set_data_full (G_OBJECT (model), PENDING_NODES_KEY,
+					g_hash_table_new_full (g_direct_hash,
+							       g_direct_equal,
+							       NULL,
+							       (GDestroyNotify)poppler_index_iter_free),
+					(GDestroyNotify)g_hash_table_destroy);
 		build_tree (pdf_document, model, NULL, iter);
 		poppler_index_iter_free (iter);
 	}
@@ -1494,6 +1746,37 @@ pdf_document_links_get_links_model (EvDocumentLinks *document_links)
 	return model;
 }
 
+static gboolean
+pdf_document_links_expand_links_node (EvDocumentLinks *document_links,
+				      GtkTreeModel    *model,
+				      GtkTreeIter     *iter)
+{
+	PdfDocument      *pdf_document = PDF_DOCUMENT (document_links);
+	GHashTable       *pending_nodes;
+	PopplerIndexIter *child;
+	GtkTreeIter       placeholder;
+
+	pending_nodes = (GHashTable *)g_object_get_data (G_OBJECT (model), PENDING_NODES_KEY);
+	if (!pending_nodes)
+		return FALSE;
+
+	child = (PopplerIndexIter *)g_hash_table_lookup (pending_nodes, iter->user_data);
+	if (!child)
+		return FALSE;
+
+	g_hash_table_steal (pending_nodes, iter->user_data);
+
+	/* The placeholder is removed after adding the new rows,
+	 * so that the node never becomes childless while expanding.
+	 */
+	gtk_tree_model_iter_children (model, &placeholder, iter);
+	build_tree (pdf_document, model, iter, child);
+	gtk_tree_store_remove (GTK_TREE_STORE (model), &placeholder);
+	poppler_index_iter_free (child);
+
+	return TRUE;
+}
+
 static EvMappingList *
 pdf_document_links_get_links (EvDocumentLinks *document_links,
 			      EvPage          *page)
@@ -1541,12 +1824,9 @@ pdf_document_links_find_link_dest (EvDocumentLinks  *document_links,
 	EvLinkDest *ev_dest = NULL;
 
 	pdf_document = PDF_DOCUMENT (document_links);
-	dest = poppler_document_find_dest (pdf_document->document,
-					   link_name);
-	if (dest) {
+	dest = pdf_document_find_dest (pdf_document, link_name);
+	if (dest)
 		ev_dest = ev_link_dest_from_dest (pdf_document, dest);
-		poppler_dest_free (dest);
-	}
 
 	return ev_dest;
 }
@@ -1560,12 +1840,9 @@ pdf_document_links_find_link_page (EvDocumentLinks  *document_links,
 	gint         retval = -1;
 
 	pdf_document = PDF_DOCUMENT (document_links);
-	dest = poppler_document_find_dest (pdf_document->document,
-					   link_name);
-	if (dest) {
+	dest = pdf_document_find_dest (pdf_document, link_name);
+	if (dest)
 		retval = dest->page_num - 1;
-		poppler_dest_free (dest);
-	}
 
 	return retval;
 }
@@ -1575,6 +1852,7 @@ pdf_document_document_links_iface_init (EvDocumentLinksInterface *iface)
 {
 	iface->has_document_links = pdf_document_links_has_document_links;
 	iface->get_links_model = pdf_document_links_get_links_model;
+	iface->expand_links_node = pdf_document_links_expand_links_node;
 	iface->get_links = pdf_document_links_get_links;
 	iface->find_link_dest = pdf_document_links_find_link_dest;
 	iface->find_link_page = pdf_document_links_find_link_page;
@@ -2018,6 +2296,10 @@ pdf_document_document_print_iface_init (EvDocumentPrintInterface *iface)
 	iface->print_page = pdf_document_print_print_page;
 }
 
+/* Style of the selection drawn on a surface, the incremental redraw
+ * is only possible when the previous selection has the same style */
+static cairo_user_data_key_t selection_style_key;
+
 static void
 pdf_selection_render_selection (EvSelection      *selection,
 				EvRenderContext  *rc,
@@ -2052,15 +2334,63 @@ pdf_selection_render_selection (EvSelection      *selection,
 	if (*surface == NULL) {
 		*surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
 						       width, height);
-		
+		old_points = NULL;
+	} else if (GPOINTER_TO_INT (cairo_surface_get_user_data (*surface, &selection_style_key)) != style + 1) {
+		old_points = NULL;
 	}
+	cairo_surface_set_user_data (*surface, &selection_style_key,
+				     GINT_TO_POINTER (style + 1), NULL);
 
 	cr = cairo_create (*surface);
-	cairo_scale (cr, rc->scale, rc->scale);
 	cairo_surface_set_device_offset (*surface, 0, 0);
-	memset (cairo_image_surface_get_data (*surface), 0x00,
-		cairo_image_surface_get_height (*surface) *
-		cairo_image_surface_get_stride (*surface));
+
+	if (old_points) {
+		cairo_region_t *damage;
+		cairo_region_t *region;
+		gint            n_rects, i;
+
+		/* Only the glyphs that were selected or unselected since the
+		 * previous selection need to be drawn again, that's what makes
+		 * dragging a selection on big pages fast.
+		 */
+		damage = poppler_page_get_selected_region (poppler_page, rc->scale,
+							   (PopplerSelectionStyle)style,
+							   (PopplerRectangle *)old_points);
+		region = poppler_page_get_selected_region (poppler_page, rc->scale,
+							   (PopplerSelectionStyle)style,
+							   (PopplerRectangle *)points);
+		cairo_region_xor (damage, region);
+		cairo_region_destroy (region);
+
+		if (cairo_region_is_empty (damage)) {
+			cairo_region_destroy (damage);
+			cairo_destroy (cr);
+
+			return;
+		}
+
+		/* Grow the rectangles a bit to cover antialiased edges */
+		n_rects = cairo_region_num_rectangles (damage);
+		for (i = 0; i < n_rects; i++) {
+			cairo_rectangle_int_t rect;
+
+			cairo_region_get_rectangle (damage, i, &rect);
+			cairo_rectangle (cr, rect.x - 1, rect.y - 1, rect.width + 2, rect.height + 2);
+		}
+		cairo_region_destroy (damage);
+
+		cairo_clip (cr);
+		cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+		cairo_paint (cr);
+		cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+	} else {
+		memset (cairo_image_surface_get_data (*surface), 0x00,
+			cairo_image_surface_get_height (*surface) *
+			cairo_image_surface_get_stride (*surface));
+		cairo_surface_mark_dirty (*surface);
+	}
+
+	cairo_scale (cr, rc->scale, rc->scale);
 	poppler_page_render_selection (poppler_page,
 				       cr,
 				       (PopplerRectangle *)points,
@@ -2531,6 +2861,7 @@ pdf_document_forms_form_field_text_set_text (EvDocumentForms *document,
 	
 	poppler_form_field_text_set_text (poppler_field, text);
 	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static void
@@ -2546,6 +2877,7 @@ pdf_document_forms_form_field_button_set_state (EvDocumentForms *document,
 	
 	poppler_form_field_button_set_state (poppler_field, state);
 	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static gboolean
@@ -2627,6 +2959,7 @@ pdf_document_forms_form_field_choice_select_item (EvDocumentForms *document,
 
 	poppler_form_field_choice_select_item (poppler_field, index);
 	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static void
@@ -2642,6 +2975,7 @@ pdf_document_forms_form_field_choice_toggle_item (EvDocumentForms *document,
 
 	poppler_form_field_choice_toggle_item (poppler_field, index);
 	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static void
@@ -2656,6 +2990,7 @@ pdf_document_forms_form_field_choice_unselect_all (EvDocumentForms *document,
 	
 	poppler_form_field_choice_unselect_all (poppler_field);
 	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static void
@@ -2671,6 +3006,7 @@ pdf_document_forms_form_field_choice_set_text (EvDocumentForms *document,
 	
 	poppler_form_field_choice_set_text (poppler_field, text);
 	PDF_DOCUMENT (document)->forms_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static gchar *
@@ -3099,6 +3435,7 @@ pdf_document_annotations_remove_annotation (EvDocumentAnnotations *document_anno
 	g_object_unref (poppler_annot);
 
 	pdf_document->annots_modified = TRUE;
+	ev_display_list_cache_clear (pdf_document->display_lists);
 }
 
 static void
@@ -3205,6 +3542,7 @@ pdf_document_annotations_add_annotation (EvDocumentAnnotations *document_annotat
 	}
 
 	pdf_document->annots_modified = TRUE;
+	ev_display_list_cache_clear (pdf_document->display_lists);
 }
 
 static void
@@ -3262,6 +3600,7 @@ pdf_document_annotations_save_annotation (EvDocumentAnnotations *document_annota
 	}
 
 	PDF_DOCUMENT (document_annotations)->annots_modified = TRUE;
+	ev_display_list_cache_clear (PDF_DOCUMENT (document_annotations)->display_lists);
 }
 
 static void
@@ -3493,6 +3832,7 @@ pdf_document_layers_show_layer (EvDocumentLayers *document,
 
 	poppler_layer = POPPLER_LAYER (g_object_get_data (G_OBJECT (layer), "poppler-layer"));
 	poppler_layer_show (poppler_layer);
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static void
@@ -3503,6 +3843,7 @@ pdf_document_layers_hide_layer (EvDocumentLayers *document,
 
 	poppler_layer = POPPLER_LAYER (g_object_get_data (G_OBJECT (layer), "poppler-layer"));
 	poppler_layer_hide (poppler_layer);
+	ev_display_list_cache_clear (PDF_DOCUMENT (document)->display_lists);
 }
 
 static gboolean
@@ -22,6 +22,7 @@
 #include "config.h"
 #include "ev-document.h"
 #include "ev-file-exporter.h"
+#include "ev-display-list.h"
 #include "pdfdocument-converter.h"
 
 G_BEGIN_DECLS
@@ -74,8 +75,15 @@ struct _PdfDocument
 	PdfPrintContext *print_ctx;
 
 	GHashTable *annots;
+	GHashTable *dests;
 
 	PSPDFConverter *converter;
+
+	/* Mapped file contents, when loaded with ev_file_map() */
+	GBytes *mapped_data;
+
+	/* Recorded drawing of the slowest pages */
+	EvDisplayListCache *display_lists;
 };
 
 G_END_DECLS
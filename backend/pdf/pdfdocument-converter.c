@@ -21,14 +21,23 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib/gstdio.h>
+#include <glib/gi18n-lib.h>
+#include <gio/gio.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include <errno.h>
 
 #include "pdfdocument-converter.h"
+#include "ev-document.h"
 
 #define MAX_BUFSIZE 1024
 
+/* Converted documents are kept in the user cache up to this size */
+#define MAX_CACHE_SIZE (G_GINT64_CONSTANT (1) << 30)
+#define CHECKSUM_BUFSIZE (64 * 1024)
+
 enum { // signals
     CONVERSION_FINISHED,
     LAST_SIGNAL
@@ -49,7 +58,8 @@ struct _PSPDFConverter {
 
     gchar *filename;        /* the currently loaded filename */
     GString *pdfdata;       /* the conversion result */
-    
+    gchar *output_file;     /* the cached conversion result */
+
 };
 
 struct _PSPDFConverterClass {
@@ -75,6 +85,11 @@ pspdf_converter_dispose (GObject *object)
         ps2pdf->filename = NULL;
     }
 
+    if (ps2pdf->output_file) {
+        g_free (ps2pdf->output_file);
+        ps2pdf->output_file = NULL;
+    }
+
     pspdf_converter_stop (ps2pdf);
 
     G_OBJECT_CLASS (pspdf_converter_parent_class)->dispose (object);
@@ -228,13 +243,63 @@ pspdf_converter_new (const gchar *filename)
 #define NUM_GS_ARGS (NUM_ARGS - 20)
 #define NUM_PS2PDF_ARGS 10
 
+/* Returns the NULL terminated command line of gs writing the PDF
+ * document to @output, "-" for the standard output
+ */
+static GPtrArray *
+pspdf_converter_get_argv (PSPDFConverter *ps2pdf,
+                          const gchar    *output,
+                          GError        **error)
+{
+    GPtrArray *argv;
+    gchar *gs_path, *escaped;
+    gchar **gs_args, **ps2pdf_args;
+    gint i;
+
+    gs_path = g_find_program_in_path ("gs");
+    if (!gs_path) {
+        g_set_error_literal (error, EV_DOCUMENT_ERROR, EV_DOCUMENT_ERROR_INVALID,
+                             _("Ghostscript is needed to open PostScript documents"));
+        return NULL;
+    }
+
+    argv = g_ptr_array_new_with_free_func (g_free);
+
+    gs_args = g_strsplit (gs_path, " ", NUM_GS_ARGS);
+    g_free (gs_path);
+    for (i = 0; gs_args[i]; i++)
+        g_ptr_array_add (argv, g_strdup (gs_args[i]));
+    g_strfreev (gs_args);
+
+    ps2pdf_args = g_strsplit (PS_TO_PDF_PARAMS, " ", NUM_PS2PDF_ARGS);
+    for (i = 0; ps2pdf_args[i]; i++)
+        g_ptr_array_add (argv, g_strdup (ps2pdf_args[i]));
+    g_strfreev (ps2pdf_args);
+
+    g_ptr_array_add (argv, g_strdup ("-q"));
+    g_ptr_array_add (argv, g_strdup ("-dSAFER"));
+    g_ptr_array_add (argv, g_strdup ("-dNOPAUSE"));
+    g_ptr_array_add (argv, g_strdup ("-dBATCH"));
+
+    /* gs expands %d in output file names to the page number */
+    gs_args = g_strsplit (output, "%", -1);
+    escaped = g_strjoinv ("%%", gs_args);
+    g_strfreev (gs_args);
+    g_ptr_array_add (argv, g_strdup_printf ("-sOutputFile=%s", escaped));
+    g_free (escaped);
+
+    g_ptr_array_add (argv, g_strdup (ps2pdf->filename));
+    g_ptr_array_add (argv, NULL);
+
+    return argv;
+}
+
 void
 pspdf_converter_start (PSPDFConverter *ps2pdf)
 {
-    gchar *argv[NUM_ARGS], *dir, *gs_path;
-    gchar **gs_args, **ps2pdf_args = NULL;
+    GPtrArray *argv;
+    gchar *dir;
     gint pin, pout, perr;
-    gint argc = 0, i;
     GError *error = NULL;
 
     g_assert (ps2pdf->filename != NULL);
@@ -243,28 +308,16 @@ pspdf_converter_start (PSPDFConverter *ps2pdf)
     pspdf_converter_stop (ps2pdf);
 
     dir = g_path_get_dirname (ps2pdf->filename);
-    gs_path = g_find_program_in_path ("gs");
-    gs_args = g_strsplit (gs_path, " ", NUM_GS_ARGS);
-    g_free (gs_path);
-    for (i = 0; i < NUM_GS_ARGS && gs_args[i]; i++, argc++) {
-        argv[argc] = gs_args[i];
-    }
-    
-    ps2pdf_args = g_strsplit (PS_TO_PDF_PARAMS, " ", NUM_PS2PDF_ARGS);
-    for (i = 0; i < NUM_PS2PDF_ARGS && ps2pdf_args[i]; i++, argc++) {
-        argv[argc] = ps2pdf_args[i];
-    }
-
-    argv[argc++] = "-q";
-    argv[argc++] = "-dSAFER";
-    argv[argc++] = "-dNOPAUSE";
-    argv[argc++] = "-dBATCH";
-    argv[argc++] = "-sOutputFile=-"; // stdout
-    argv[argc++] = ps2pdf->filename;
+    argv = pspdf_converter_get_argv (ps2pdf, "-", &error);
+    if (!argv) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+        g_free (dir);
 
-    argv[argc++] = NULL;
+        return;
+    }
 
-    if (g_spawn_async_with_pipes (dir, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+    if (g_spawn_async_with_pipes (dir, (gchar **)argv->pdata, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
                                   NULL, NULL,
                                   &(ps2pdf->pid), &pin, &pout, &perr,
                                   &error)) {
@@ -300,17 +353,15 @@ pspdf_converter_start (PSPDFConverter *ps2pdf)
     }
 
     g_free (dir);
-    g_strfreev (gs_args);
-    g_strfreev (ps2pdf_args);
+    g_ptr_array_free (argv, TRUE);
 }
 
 void
 pspdf_converter_start_sync (PSPDFConverter *ps2pdf)
 {
-    gchar *argv[NUM_ARGS], *dir, *gs_path;
-    gchar **gs_args, **ps2pdf_args = NULL;
+    GPtrArray *argv;
+    gchar *dir;
     gint pin, pout, perr;
-    gint argc = 0, i;
     GError *error = NULL;
 
     GIOStatus status;
@@ -323,28 +374,16 @@ pspdf_converter_start_sync (PSPDFConverter *ps2pdf)
     pspdf_converter_stop (ps2pdf);
 
     dir = g_path_get_dirname (ps2pdf->filename);
-    gs_path = g_find_program_in_path ("gs");
-    gs_args = g_strsplit (gs_path, " ", NUM_GS_ARGS);
-    g_free (gs_path);
-    for (i = 0; i < NUM_GS_ARGS && gs_args[i]; i++, argc++) {
-        argv[argc] = gs_args[i];
-    }
-    
-    ps2pdf_args = g_strsplit (PS_TO_PDF_PARAMS, " ", NUM_PS2PDF_ARGS);
-    for (i = 0; i < NUM_PS2PDF_ARGS && ps2pdf_args[i]; i++, argc++) {
-        argv[argc] = ps2pdf_args[i];
-    }
-
-    argv[argc++] = "-q";
-    argv[argc++] = "-dSAFER";
-    argv[argc++] = "-dNOPAUSE";
-    argv[argc++] = "-dBATCH";
-    argv[argc++] = "-sOutputFile=-"; // stdout
-    argv[argc++] = ps2pdf->filename;
+    argv = pspdf_converter_get_argv (ps2pdf, "-", &error);
+    if (!argv) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+        g_free (dir);
 
-    argv[argc++] = NULL;
+        return;
+    }
 
-    if (g_spawn_async_with_pipes (dir, argv, NULL, 0,
+    if (g_spawn_async_with_pipes (dir, (gchar **)argv->pdata, NULL, 0,
                                   NULL, NULL,
                                   &(ps2pdf->pid), &pin, &pout, &perr,
                                   &error)) {
@@ -371,8 +410,7 @@ pspdf_converter_start_sync (PSPDFConverter *ps2pdf)
     }
 
     g_free (dir);
-    g_strfreev (gs_args);
-    g_strfreev (ps2pdf_args);
+    g_ptr_array_free (argv, TRUE);
 
 }
 
@@ -424,3 +462,242 @@ pspdf_converter_get_data(PSPDFConverter *ps2pdf)
 {
     return ps2pdf->pdfdata;
 }
+
+static gchar *
+pspdf_converter_get_cache_dir (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "evince", "ps2pdf", NULL);
+}
+
+/* The conversion depends on the contents of the file and on the
+ * parameters given to gs
+ */
+static gchar *
+pspdf_converter_get_checksum (PSPDFConverter *ps2pdf,
+                              GError        **error)
+{
+    GFile *file;
+    GFileInputStream *stream;
+    GChecksum *checksum;
+    guchar *buffer;
+    gssize bytes;
+    gchar *retval = NULL;
+
+    file = g_file_new_for_path (ps2pdf->filename);
+    stream = g_file_read (file, NULL, error);
+    g_object_unref (file);
+    if (!stream)
+        return NULL;
+
+    checksum = g_checksum_new (G_CHECKSUM_SHA256);
+    g_checksum_update (checksum, (const guchar *)PS_TO_PDF_PARAMS, -1);
+
+    buffer = g_malloc (CHECKSUM_BUFSIZE);
+    while ((bytes = g_input_stream_read (G_INPUT_STREAM (stream), buffer,
+                                         CHECKSUM_BUFSIZE, NULL, error)) > 0) {
+        g_checksum_update (checksum, buffer, bytes);
+    }
+    if (bytes == 0)
+        retval = g_strdup (g_checksum_get_string (checksum));
+
+    g_free (buffer);
+    g_checksum_free (checksum);
+    g_object_unref (stream);
+
+    return retval;
+}
+
+typedef struct {
+    gchar  *path;
+    time_t  mtime;
+    goffset size;
+} CachedConversion;
+
+static gint
+compare_cached_conversions (gconstpointer a,
+                            gconstpointer b)
+{
+    const CachedConversion *conv_a = a;
+    const CachedConversion *conv_b = b;
+
+    /* Most recently used first */
+    return conv_a->mtime < conv_b->mtime ? 1 : (conv_a->mtime > conv_b->mtime ? -1 : 0);
+}
+
+/* Removes the least recently used conversions above MAX_CACHE_SIZE */
+static void
+pspdf_converter_prune_cache (const gchar *dir)
+{
+    GDir *gdir;
+    const gchar *name;
+    GArray *conversions;
+    goffset total = 0;
+    guint i;
+
+    gdir = g_dir_open (dir, 0, NULL);
+    if (!gdir)
+        return;
+
+    conversions = g_array_new (FALSE, FALSE, sizeof (CachedConversion));
+    while ((name = g_dir_read_name (gdir))) {
+        CachedConversion conv;
+        GStatBuf statbuf;
+
+        if (!g_str_has_suffix (name, ".pdf"))
+            continue;
+
+        conv.path = g_build_filename (dir, name, NULL);
+        if (g_stat (conv.path, &statbuf) != 0) {
+            g_free (conv.path);
+            continue;
+        }
+        conv.mtime = statbuf.st_mtime;
+        conv.size = statbuf.st_size;
+        g_array_append_val (conversions, conv);
+    }
+    g_dir_close (gdir);
+
+    g_array_sort (conversions, compare_cached_conversions);
+    for (i = 0; i < conversions->len; i++) {
+        CachedConversion *conv = &g_array_index (conversions, CachedConversion, i);
+
+        /* Always keep the most recent one, it's the one being opened */
+        total += conv->size;
+        if (i > 0 && total > MAX_CACHE_SIZE)
+            g_unlink (conv->path);
+        g_free (conv->path);
+    }
+    g_array_free (conversions, TRUE);
+}
+
+/**
+ * pspdf_converter_convert_sync:
+ * @ps2pdf: a #PSPDFConverter
+ * @error: a location for a #GError, or %NULL
+ *
+ * Converts the document to a PDF file in the user cache, which is reused
+ * by later conversions of the same document. gs writes the file directly,
+ * so the document is never held in memory, and it's moved in place only
+ * once the conversion succeeded.
+ *
+ * Returns: %TRUE on success, the file is then returned by
+ * pspdf_converter_get_output_file()
+ */
+gboolean
+pspdf_converter_convert_sync (PSPDFConverter *ps2pdf,
+                              GError        **error)
+{
+    GPtrArray *argv;
+    gchar *checksum, *cache_dir, *dir, *basename;
+    gchar *output, *partial;
+    gchar *errors = NULL;
+    gint status;
+    gint fd;
+    gboolean retval;
+
+    g_return_val_if_fail (PSPDF_IS_CONVERTER (ps2pdf), FALSE);
+
+    checksum = pspdf_converter_get_checksum (ps2pdf, error);
+    if (!checksum)
+        return FALSE;
+
+    cache_dir = pspdf_converter_get_cache_dir ();
+    basename = g_strdup_printf ("%s.pdf", checksum);
+    output = g_build_filename (cache_dir, basename, NULL);
+    g_free (basename);
+    g_free (checksum);
+
+    if (g_file_test (output, G_FILE_TEST_IS_REGULAR)) {
+        /* Mark it as recently used, see pspdf_converter_prune_cache() */
+        g_utime (output, NULL);
+        g_free (ps2pdf->output_file);
+        ps2pdf->output_file = output;
+        g_free (cache_dir);
+
+        return TRUE;
+    }
+
+    if (g_mkdir_with_parents (cache_dir, 0700) != 0) {
+        int errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     _("Failed to create directory “%s”: %s"),
+                     cache_dir, g_strerror (errsv));
+        g_free (output);
+        g_free (cache_dir);
+
+        return FALSE;
+    }
+
+    /* Unique even for conversions of the same document running
+     * at the same time, in this process or another one */
+    partial = g_strdup_printf ("%s.part.XXXXXX", output);
+    fd = g_mkstemp (partial);
+    if (fd == -1) {
+        int errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     _("Failed to create a temporary file: %s"),
+                     g_strerror (errsv));
+        g_free (partial);
+        g_free (output);
+        g_free (cache_dir);
+
+        return FALSE;
+    }
+    close (fd);
+
+    argv = pspdf_converter_get_argv (ps2pdf, partial, error);
+    if (!argv) {
+        g_unlink (partial);
+        g_free (partial);
+        g_free (output);
+        g_free (cache_dir);
+
+        return FALSE;
+    }
+
+    dir = g_path_get_dirname (ps2pdf->filename);
+    retval = g_spawn_sync (dir, (gchar **)argv->pdata, NULL,
+                           G_SPAWN_STDOUT_TO_DEV_NULL,
+                           NULL, NULL, NULL, &errors, &status, error);
+    g_free (dir);
+    g_ptr_array_free (argv, TRUE);
+
+    if (retval && !g_spawn_check_exit_status (status, NULL)) {
+        g_set_error (error, EV_DOCUMENT_ERROR, EV_DOCUMENT_ERROR_INVALID,
+                     _("Failed to convert PostScript document: %s"),
+                     errors && *errors ? g_strstrip (errors) : _("unknown error"));
+        retval = FALSE;
+    }
+    g_free (errors);
+
+    if (retval && g_rename (partial, output) != 0) {
+        int errsv = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     _("Failed to rename file “%s”: %s"),
+                     partial, g_strerror (errsv));
+        retval = FALSE;
+    }
+
+    if (retval) {
+        g_free (ps2pdf->output_file);
+        ps2pdf->output_file = output;
+        pspdf_converter_prune_cache (cache_dir);
+    } else {
+        g_unlink (partial);
+        g_free (output);
+    }
+
+    g_free (partial);
+    g_free (cache_dir);
+
+    return retval;
+}
+
+const gchar *
+pspdf_converter_get_output_file (PSPDFConverter *ps2pdf)
+{
+    return ps2pdf->output_file;
+}
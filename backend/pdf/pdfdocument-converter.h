@@ -41,6 +41,9 @@ void            pspdf_converter_start       (PSPDFConverter *ps2pdf);
 void            pspdf_converter_start_sync  (PSPDFConverter *ps2pdf);
 void            pspdf_converter_stop        (PSPDFConverter *ps2pdf);
 GString *       pspdf_converter_get_data    (PSPDFConverter *ps2pdf);
+gboolean        pspdf_converter_convert_sync (PSPDFConverter *ps2pdf,
+                                             GError        **error);
+const gchar *   pspdf_converter_get_output_file (PSPDFConverter *ps2pdf);
 G_END_DECLS
 
 #endif /* __PSPDF_CONVERTER_H__ */
@@ -24,6 +24,7 @@
 
 #include <config.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -39,11 +40,19 @@ struct _TiffDocumentClass
   EvDocumentClass parent_class;
 };
 
+typedef struct {
+	GBytes       *bytes;
+	const guchar *data;
+	toff_t        size;
+	toff_t        offset;
+} TiffMappedSource;
+
 struct _TiffDocument
 {
   EvDocument parent_instance;
 
   TIFF *tiff;
+  TiffMappedSource *mapped_source;
   gint n_pages;
   TIFF2PSContext *ps_export_ctx;
   
@@ -77,6 +86,129 @@ pop_handlers (void)
 	TIFFSetWarningHandler (orig_warning_handler);
 }
 
+static tsize_t
+tiff_mapped_read (thandle_t handle,
+		  tdata_t   buffer,
+		  tsize_t   size)
+{
+	TiffMappedSource *source = (TiffMappedSource *) handle;
+
+	if (source->offset >= source->size)
+		return 0;
+
+	size = MIN ((toff_t) size, source->size - source->offset);
+	memcpy (buffer, source->data + source->offset, size);
+	source->offset += size;
+
+	return size;
+}
+
+static tsize_t
+tiff_mapped_write (thandle_t handle,
+		   tdata_t   buffer,
+		   tsize_t   size)
+{
+	return -1;
+}
+
+static toff_t
+tiff_mapped_seek (thandle_t handle,
+		  toff_t    offset,
+		  int       whence)
+{
+	TiffMappedSource *source = (TiffMappedSource *) handle;
+
+	switch (whence) {
+	case SEEK_SET:
+		source->offset = offset;
+		break;
+	case SEEK_CUR:
+		source->offset += offset;
+		break;
+	case SEEK_END:
+		source->offset = source->size + offset;
+		break;
+	default:
+		return (toff_t) -1;
+	}
+
+	return source->offset;
+}
+
+/* The source is owned by the document, libtiff versions differ on
+ * whether the close proc is called when opening fails.
+ */
+static int
+tiff_mapped_close (thandle_t handle)
+{
+	return 0;
+}
+
+static void
+tiff_mapped_source_free (TiffMappedSource *source)
+{
+	g_bytes_unref (source->bytes);
+	g_free (source);
+}
+
+static toff_t
+tiff_mapped_size (thandle_t handle)
+{
+	return ((TiffMappedSource *) handle)->size;
+}
+
+/* libtiff reads the strips in place instead of copying them */
+static int
+tiff_mapped_map (thandle_t handle,
+		 tdata_t  *data,
+		 toff_t   *size)
+{
+	TiffMappedSource *source = (TiffMappedSource *) handle;
+
+	*data = (tdata_t) source->data;
+	*size = source->size;
+
+	return 1;
+}
+
+static void
+tiff_mapped_unmap (thandle_t handle,
+		   tdata_t   data,
+		   toff_t    size)
+{
+}
+
+static TIFF *
+tiff_document_open_mapped (TiffDocument *tiff_document,
+			   const gchar  *uri,
+			   const gchar  *filename)
+{
+	TiffMappedSource *source;
+	GBytes           *bytes;
+	TIFF             *tiff;
+
+	bytes = ev_file_map (uri, NULL);
+	if (!bytes)
+		return NULL;
+
+	source = g_new0 (TiffMappedSource, 1);
+	source->bytes = bytes;
+	source->data = g_bytes_get_data (bytes, NULL);
+	source->size = g_bytes_get_size (bytes);
+
+	tiff = TIFFClientOpen (filename, "r", (thandle_t) source,
+			       tiff_mapped_read, tiff_mapped_write,
+			       tiff_mapped_seek, tiff_mapped_close,
+			       tiff_mapped_size,
+			       tiff_mapped_map, tiff_mapped_unmap);
+	if (tiff)
+		tiff_document->mapped_source = source;
+	else
+		tiff_mapped_source_free (source);
+
+	return tiff;
+}
+
 static gboolean
 tiff_document_load (EvDocument  *document,
 		    const char  *uri,
@@ -92,6 +224,8 @@ tiff_document_load (EvDocument  *document,
 	
 	push_handlers ();
 
+	tiff = tiff_document_open_mapped (tiff_document, uri, filename);
+	if (!tiff) {
 #ifdef G_OS_WIN32
 {
 	wchar_t *wfilename = g_utf8_to_utf16 (filename, -1, NULL, NULL, error);
@@ -106,6 +240,7 @@ tiff_document_load (EvDocument  *document,
 #else
 	tiff = TIFFOpen (filename, "r");
 #endif
+	}
 	if (tiff) {
 		guint32 w, h;
 		
@@ -426,6 +561,8 @@ tiff_document_finalize (GObject *object)
 
 	if (tiff_document->tiff)
 		TIFFClose (tiff_document->tiff);
+	if (tiff_document->mapped_source)
+		tiff_mapped_source_free (tiff_document->mapped_source);
 	if (tiff_document->uri)
 		g_free (tiff_document->uri);
 
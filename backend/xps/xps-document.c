@@ -26,6 +26,7 @@
 #include "ev-document-links.h"
 #include "ev-document-print.h"
 #include "ev-document-misc.h"
+#include "ev-display-list.h"
 
 struct _XPSDocument {
 	EvDocument    object;
@@ -33,8 +34,16 @@ struct _XPSDocument {
 	GFile        *file;
 	GXPSFile     *xps;
 	GXPSDocument *doc;
+
+	/* Recorded drawing of the slowest pages */
+	EvDisplayListCache *display_lists;
 };
 
+typedef struct {
+	GXPSPage *page;
+	GError   *error;
+} XPSPageDraw;
+
 struct _XPSDocumentClass {
 	EvDocumentClass parent_class;
 };
@@ -54,6 +63,7 @@ EV_BACKEND_REGISTER_WITH_CODE (XPSDocument, xps_document,
 static void
 xps_document_init (XPSDocument *ps_document)
 {
+	ps_document->display_lists = ev_display_list_cache_new ();
 }
 
 static void
@@ -76,6 +86,11 @@ xps_document_dispose (GObject *object)
 		xps->doc = NULL;
 	}
 
+	if (xps->display_lists) {
+		ev_display_list_cache_free (xps->display_lists);
+		xps->display_lists = NULL;
+	}
+
 	G_OBJECT_CLASS (xps_document_parent_class)->dispose (object);
 }
 
@@ -194,6 +209,15 @@ xps_document_get_backend_info (EvDocument            *document,
 	return TRUE;
 }
 
+static void
+xps_page_draw (cairo_t *cr,
+	       gpointer user_data)
+{
+	XPSPageDraw *draw = (XPSPageDraw *)user_data;
+
+	gxps_page_render (draw->page, cr, &draw->error);
+}
+
 static cairo_surface_t *
 xps_document_render (EvDocument      *document,
 		     EvRenderContext *rc)
@@ -203,7 +227,7 @@ xps_document_render (EvDocument      *document,
 	guint            width, height;
 	cairo_surface_t *surface;
 	cairo_t         *cr;
-	GError          *error = NULL;
+	XPSPageDraw      draw;
 
 	xps_page = GXPS_PAGE (rc->page->backend_page);
 
@@ -239,13 +263,18 @@ xps_document_render (EvDocument      *document,
 
 	cairo_scale (cr, rc->scale, rc->scale);
 	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
-	gxps_page_render (xps_page, cr, &error);
+	draw.page = xps_page;
+	draw.error = NULL;
+	ev_display_list_cache_draw (XPS_DOCUMENT (document)->display_lists,
+				    rc->page->index,
+				    page_width, page_height,
+				    cr, xps_page_draw, &draw);
 	cairo_destroy (cr);
 
-	if (error) {
+	if (draw.error) {
 		g_warning ("Error rendering page %d: %s\n",
-			   rc->page->index, error->message);
-		g_error_free (error);
+			   rc->page->index, draw.error->message);
+		g_error_free (draw.error);
 	}
 
 	return surface;
@@ -0,0 +1,169 @@
+/* ev-bzip2-decompressor.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_BZLIB
+
+#include <string.h>
+#include <bzlib.h>
+
+#include "ev-bzip2-decompressor.h"
+
+/* A #GConverter decompressing bzip2 data with libbz2, the
+ * equivalent of #GZlibDecompressor for .bz2 documents.
+ */
+struct _EvBzip2Decompressor {
+	GObject   parent_instance;
+
+	bz_stream bzstream;
+	gboolean  at_stream_boundary;
+};
+
+struct _EvBzip2DecompressorClass {
+	GObjectClass parent_class;
+};
+
+static void ev_bzip2_decompressor_iface_init (GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EvBzip2Decompressor, _ev_bzip2_decompressor, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER,
+						ev_bzip2_decompressor_iface_init))
+
+static void
+_ev_bzip2_decompressor_init (EvBzip2Decompressor *decompressor)
+{
+	memset (&decompressor->bzstream, 0, sizeof (bz_stream));
+	BZ2_bzDecompressInit (&decompressor->bzstream, 0, 0);
+}
+
+static void
+ev_bzip2_decompressor_finalize (GObject *object)
+{
+	EvBzip2Decompressor *decompressor = EV_BZIP2_DECOMPRESSOR (object);
+
+	BZ2_bzDecompressEnd (&decompressor->bzstream);
+
+	G_OBJECT_CLASS (_ev_bzip2_decompressor_parent_class)->finalize (object);
+}
+
+static void
+_ev_bzip2_decompressor_class_init (EvBzip2DecompressorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = ev_bzip2_decompressor_finalize;
+}
+
+static void
+ev_bzip2_decompressor_reset (GConverter *converter)
+{
+	EvBzip2Decompressor *decompressor = EV_BZIP2_DECOMPRESSOR (converter);
+
+	BZ2_bzDecompressEnd (&decompressor->bzstream);
+	memset (&decompressor->bzstream, 0, sizeof (bz_stream));
+	BZ2_bzDecompressInit (&decompressor->bzstream, 0, 0);
+	decompressor->at_stream_boundary = FALSE;
+}
+
+static GConverterResult
+ev_bzip2_decompressor_convert (GConverter      *converter,
+			       const void      *inbuf,
+			       gsize            inbuf_size,
+			       void            *outbuf,
+			       gsize            outbuf_size,
+			       GConverterFlags  flags,
+			       gsize           *bytes_read,
+			       gsize           *bytes_written,
+			       GError         **error)
+{
+	EvBzip2Decompressor *decompressor = EV_BZIP2_DECOMPRESSOR (converter);
+	gint                 res;
+
+	decompressor->bzstream.next_in = (char *)inbuf;
+	decompressor->bzstream.avail_in = inbuf_size;
+	decompressor->bzstream.next_out = outbuf;
+	decompressor->bzstream.avail_out = outbuf_size;
+
+	res = BZ2_bzDecompress (&decompressor->bzstream);
+
+	*bytes_read = inbuf_size - decompressor->bzstream.avail_in;
+	*bytes_written = outbuf_size - decompressor->bzstream.avail_out;
+
+	if (*bytes_read > 0)
+		decompressor->at_stream_boundary = FALSE;
+
+	switch (res) {
+	case BZ_OK:
+		if (*bytes_read == 0 && *bytes_written == 0) {
+			if ((flags & G_CONVERTER_INPUT_AT_END) &&
+			    decompressor->at_stream_boundary)
+				return G_CONVERTER_FINISHED;
+
+			if (flags & G_CONVERTER_INPUT_AT_END) {
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+						     "Unexpected end of bzip2 data");
+			} else if (outbuf_size == 0) {
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+						     "Not enough space in the output buffer");
+			} else {
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+						     "Need more input");
+			}
+
+			return G_CONVERTER_ERROR;
+		}
+
+		return G_CONVERTER_CONVERTED;
+	case BZ_STREAM_END:
+		/* Files created by parallel compressors contain
+		 * several concatenated streams.
+		 */
+		if (*bytes_read < inbuf_size || !(flags & G_CONVERTER_INPUT_AT_END)) {
+			ev_bzip2_decompressor_reset (converter);
+			decompressor->at_stream_boundary = TRUE;
+
+			return G_CONVERTER_CONVERTED;
+		}
+
+		return G_CONVERTER_FINISHED;
+	case BZ_MEM_ERROR:
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "Not enough memory to decompress bzip2 data");
+		return G_CONVERTER_ERROR;
+	default:
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "Invalid bzip2 data (error %d)", res);
+		return G_CONVERTER_ERROR;
+	}
+}
+
+static void
+ev_bzip2_decompressor_iface_init (GConverterIface *iface)
+{
+	iface->convert = ev_bzip2_decompressor_convert;
+	iface->reset = ev_bzip2_decompressor_reset;
+}
+
+GConverter *
+_ev_bzip2_decompressor_new (void)
+{
+	return G_CONVERTER (g_object_new (EV_TYPE_BZIP2_DECOMPRESSOR, NULL));
+}
+
+#endif /* HAVE_BZLIB */
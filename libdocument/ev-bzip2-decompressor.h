@@ -0,0 +1,42 @@
+/* ev-bzip2-decompressor.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef EV_BZIP2_DECOMPRESSOR_H
+#define EV_BZIP2_DECOMPRESSOR_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define EV_TYPE_BZIP2_DECOMPRESSOR         (_ev_bzip2_decompressor_get_type ())
+#define EV_BZIP2_DECOMPRESSOR(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EV_TYPE_BZIP2_DECOMPRESSOR, EvBzip2Decompressor))
+#define EV_IS_BZIP2_DECOMPRESSOR(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), EV_TYPE_BZIP2_DECOMPRESSOR))
+
+typedef struct _EvBzip2Decompressor      EvBzip2Decompressor;
+typedef struct _EvBzip2DecompressorClass EvBzip2DecompressorClass;
+
+GType       _ev_bzip2_decompressor_get_type (void) G_GNUC_CONST;
+GConverter *_ev_bzip2_decompressor_new      (void);
+
+G_END_DECLS
+
+#endif /* EV_BZIP2_DECOMPRESSOR_H */
@@ -0,0 +1,257 @@
+/* ev-display-list.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <math.h>
+
+#include "ev-display-list.h"
+
+/* Pages taking longer than this to draw are recorded the next time */
+#define SLOW_PAGE_USEC  (50 * 1000)
+
+/* Backends reduce the resolution of images to the one of the target
+ * when drawing them, so pages are recorded at a bigger scale to keep
+ * images sharp when zooming in.
+ */
+#define RECORDING_SCALE 4.0
+
+typedef struct {
+	gint             page;
+	cairo_surface_t *surface;
+} EvDisplayList;
+
+struct _EvDisplayListCache {
+	GMutex      mutex;
+	GList      *lists;      /* Most recently used first */
+	GHashTable *slow_pages;
+};
+
+static volatile gint display_list_max_pages = 0;
+
+/*
+ * ev_display_list_set_max_pages:
+ * @max_pages: the number of pages recorded per document
+ *
+ * Display lists are disabled when @max_pages is 0, which is the default.
+ */
+void
+ev_display_list_set_max_pages (guint max_pages)
+{
+	g_atomic_int_set (&display_list_max_pages, max_pages);
+}
+
+static void
+ev_display_list_free (EvDisplayList *list)
+{
+	cairo_surface_destroy (list->surface);
+	g_slice_free (EvDisplayList, list);
+}
+
+EvDisplayListCache *
+ev_display_list_cache_new (void)
+{
+	EvDisplayListCache *cache;
+
+	cache = g_slice_new0 (EvDisplayListCache);
+	g_mutex_init (&cache->mutex);
+	cache->slow_pages = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	return cache;
+}
+
+void
+ev_display_list_cache_free (EvDisplayListCache *cache)
+{
+	if (!cache)
+		return;
+
+	g_list_free_full (cache->lists, (GDestroyNotify)ev_display_list_free);
+	g_hash_table_destroy (cache->slow_pages);
+	g_mutex_clear (&cache->mutex);
+	g_slice_free (EvDisplayListCache, cache);
+}
+
+/*
+ * ev_display_list_cache_clear:
+ *
+ * Drops the recorded pages, to be called when the contents of the document
+ * change: forms, annotations or visibility of the layers.
+ */
+void
+ev_display_list_cache_clear (EvDisplayListCache *cache)
+{
+	if (!cache)
+		return;
+
+	g_mutex_lock (&cache->mutex);
+	g_list_free_full (cache->lists, (GDestroyNotify)ev_display_list_free);
+	cache->lists = NULL;
+	g_mutex_unlock (&cache->mutex);
+}
+
+static cairo_surface_t *
+ev_display_list_cache_lookup (EvDisplayListCache *cache,
+			      gint                page)
+{
+	cairo_surface_t *surface = NULL;
+	GList           *l;
+
+	g_mutex_lock (&cache->mutex);
+	for (l = cache->lists; l; l = g_list_next (l)) {
+		EvDisplayList *list = l->data;
+
+		if (list->page != page)
+			continue;
+
+		cache->lists = g_list_remove_link (cache->lists, l);
+		cache->lists = g_list_concat (l, cache->lists);
+		surface = cairo_surface_reference (list->surface);
+		break;
+	}
+	g_mutex_unlock (&cache->mutex);
+
+	return surface;
+}
+
+static void
+ev_display_list_cache_insert (EvDisplayListCache *cache,
+			      gint                page,
+			      cairo_surface_t    *surface,
+			      guint               max_pages)
+{
+	EvDisplayList *list;
+	GList         *l;
+
+	g_mutex_lock (&cache->mutex);
+
+	for (l = cache->lists; l; l = g_list_next (l)) {
+		if (((EvDisplayList *)l->data)->page == page) {
+			g_mutex_unlock (&cache->mutex);
+			return;
+		}
+	}
+
+	list = g_slice_new (EvDisplayList);
+	list->page = page;
+	list->surface = cairo_surface_reference (surface);
+	cache->lists = g_list_prepend (cache->lists, list);
+
+	while (g_list_length (cache->lists) > max_pages) {
+		l = g_list_last (cache->lists);
+		ev_display_list_free (l->data);
+		cache->lists = g_list_delete_link (cache->lists, l);
+	}
+
+	g_mutex_unlock (&cache->mutex);
+}
+
+static void
+ev_display_list_replay (cairo_surface_t *surface,
+			cairo_t         *cr)
+{
+	cairo_save (cr);
+	cairo_scale (cr, 1. / RECORDING_SCALE, 1. / RECORDING_SCALE);
+	cairo_set_source_surface (cr, surface, 0, 0);
+	cairo_paint (cr);
+	cairo_restore (cr);
+}
+
+/*
+ * ev_display_list_cache_draw:
+ * @cache: an #EvDisplayListCache, or %NULL
+ * @page: the index of the page
+ * @width: the width of the page in points
+ * @height: the height of the page in points
+ * @cr: the cairo context to draw to, transformed to page coordinates
+ * @draw_func: the function drawing the page
+ * @user_data: data passed to @draw_func
+ *
+ * Draws the page with its display list if it has been recorded. Otherwise
+ * calls @draw_func on @cr, recording the drawing first when the page has
+ * been slow to draw before.
+ */
+void
+ev_display_list_cache_draw (EvDisplayListCache   *cache,
+			    gint                  page,
+			    gdouble               width,
+			    gdouble               height,
+			    cairo_t              *cr,
+			    EvDisplayListDrawFunc draw_func,
+			    gpointer              user_data)
+{
+	cairo_surface_t      *surface;
+	cairo_rectangle_t     extents;
+	cairo_t              *record_cr;
+	gboolean              slow;
+	guint                 max_pages;
+
+	max_pages = g_atomic_int_get (&display_list_max_pages);
+	if (!cache || max_pages == 0) {
+		draw_func (cr, user_data);
+		return;
+	}
+
+	surface = ev_display_list_cache_lookup (cache, page);
+	if (surface) {
+		ev_display_list_replay (surface, cr);
+		cairo_surface_destroy (surface);
+		return;
+	}
+
+	g_mutex_lock (&cache->mutex);
+	slow = g_hash_table_lookup (cache->slow_pages, GINT_TO_POINTER (page)) != NULL;
+	g_mutex_unlock (&cache->mutex);
+
+	if (!slow) {
+		gint64 start;
+
+		start = g_get_monotonic_time ();
+		draw_func (cr, user_data);
+		if (g_get_monotonic_time () - start >= SLOW_PAGE_USEC) {
+			g_mutex_lock (&cache->mutex);
+			g_hash_table_insert (cache->slow_pages,
+					     GINT_TO_POINTER (page),
+					     GINT_TO_POINTER (TRUE));
+			g_mutex_unlock (&cache->mutex);
+		}
+
+		return;
+	}
+
+	extents.x = 0;
+	extents.y = 0;
+	extents.width = ceil (width * RECORDING_SCALE);
+	extents.height = ceil (height * RECORDING_SCALE);
+	surface = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, &extents);
+
+	record_cr = cairo_create (surface);
+	cairo_scale (record_cr, RECORDING_SCALE, RECORDING_SCALE);
+	draw_func (record_cr, user_data);
+	cairo_destroy (record_cr);
+
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		draw_func (cr, user_data);
+		return;
+	}
+
+	ev_display_list_cache_insert (cache, page, surface, max_pages);
+	ev_display_list_replay (surface, cr);
+	cairo_surface_destroy (surface);
+}
@@ -0,0 +1,61 @@
+/* ev-display-list.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef __EV_DISPLAY_LIST_H__
+#define __EV_DISPLAY_LIST_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A display list is the drawing of a page recorded once in a cairo
+ * recording surface, so that rendering the page again at another scale,
+ * rotation or for another part of the page replays the drawing operations
+ * instead of interpreting the page contents again. Only pages that are
+ * slow to draw are recorded, and a limited number of them is kept per
+ * document.
+ */
+
+typedef struct _EvDisplayListCache EvDisplayListCache;
+
+/* Draws the page in points, with the origin in the top left corner */
+typedef void (* EvDisplayListDrawFunc) (cairo_t *cr,
+					gpointer user_data);
+
+void                ev_display_list_set_max_pages (guint                  max_pages);
+
+EvDisplayListCache *ev_display_list_cache_new     (void);
+void                ev_display_list_cache_free    (EvDisplayListCache    *cache);
+void                ev_display_list_cache_clear   (EvDisplayListCache    *cache);
+void                ev_display_list_cache_draw    (EvDisplayListCache    *cache,
+						   gint                   page,
+						   gdouble                width,
+						   gdouble                height,
+						   cairo_t               *cr,
+						   EvDisplayListDrawFunc  draw_func,
+						   gpointer               user_data);
+
+G_END_DECLS
+
+#endif /* __EV_DISPLAY_LIST_H__ */
@@ -31,6 +31,7 @@
 
 #include "ev-backend-info.h"
 #include "ev-document-factory.h"
+#include "ev-document-private.h"
 #include "ev-file-helpers.h"
 #include "ev-module.h"
 
@@ -40,6 +41,9 @@
 
 #define BACKEND_DATA_KEY "ev-backend-info"
 
+/* Uncompressed bytes used to guess the type of compressed documents */
+#define CONTENT_SNIFF_SIZE 4096
+
 static GList *ev_backends_list = NULL;
 static GHashTable *ev_module_hash = NULL;
 static gchar *ev_backends_dir = NULL;
@@ -216,6 +220,119 @@ free_uncompressed_uri (gchar *uri_unc)
 	g_free (uri_unc);
 }
 
+/*
+ * load_compressed_from_memory:
+ * @document: the #EvDocument to load
+ * @uri: the URI of the compressed document
+ * @compression: the document's compression type
+ * @result: a location to store whether the document was loaded
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Uncompresses @uri in process and feeds the data directly to the backend
+ * when it can load documents from a stream, so that no temporary file is
+ * written. The uncompressed data is kept as "data-uncompressed" so that
+ * the document can be loaded again, e.g. after asking for a password.
+ *
+ * Only PDF data is loaded this way: the stream loader of the PDF backend
+ * hands the data to poppler, while other formats it accepts, such as
+ * PostScript, are converted from a file when loading from a URI.
+ *
+ * Returns: %FALSE if the document is not compressed or this can't be
+ *   done for it, in which case it must be uncompressed to a file.
+ *   Otherwise %TRUE, with @result and @error filled in.
+ */
+static gboolean
+load_compressed_from_memory (EvDocument        *document,
+			     const gchar       *uri,
+			     EvCompressionType  compression,
+			     gboolean          *result,
+			     GError           **error)
+{
+	GInputStream  *stream;
+	GInputStream  *buffered;
+	GOutputStream *out;
+	GBytes        *data;
+	GError        *err = NULL;
+	gchar         *content_type;
+	const guchar  *head;
+	gsize          head_size;
+	gsize          available;
+	gssize         n_read;
+
+	if (compression == EV_COMPRESSION_NONE ||
+	    EV_DOCUMENT_GET_CLASS (document)->load_stream == NULL)
+		return FALSE;
+
+	stream = ev_file_uncompress_stream (uri, compression, &err);
+	if (!stream) {
+		if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+			g_error_free (err);
+			return FALSE;
+		}
+
+		*result = FALSE;
+		g_propagate_error (error, err);
+		return TRUE;
+	}
+
+	/* Only uncompress the head of the file to guess its type, the
+	 * rest is only uncompressed when it's a PDF */
+	buffered = g_buffered_input_stream_new_sized (stream, CONTENT_SNIFF_SIZE);
+	g_object_unref (stream);
+
+	do {
+		available = g_buffered_input_stream_get_available (G_BUFFERED_INPUT_STREAM (buffered));
+		n_read = g_buffered_input_stream_fill (G_BUFFERED_INPUT_STREAM (buffered),
+						       CONTENT_SNIFF_SIZE - available,
+						       NULL, &err);
+	} while (n_read > 0 && available + n_read < CONTENT_SNIFF_SIZE);
+
+	if (n_read == -1) {
+		g_object_unref (buffered);
+		*result = FALSE;
+		g_propagate_error (error, err);
+		return TRUE;
+	}
+
+	head = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (buffered), &head_size);
+	content_type = g_content_type_guess (NULL, head, head_size, NULL);
+	if (!g_content_type_equals (content_type, "application/pdf")) {
+		g_free (content_type);
+		g_object_unref (buffered);
+		return FALSE;
+	}
+	g_free (content_type);
+
+	out = g_memory_output_stream_new_resizable ();
+	if (g_output_stream_splice (out, buffered,
+				    G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+				    G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+				    NULL, error) == -1) {
+		g_object_unref (out);
+		g_object_unref (buffered);
+		*result = FALSE;
+		return TRUE;
+	}
+	g_object_unref (buffered);
+
+	data = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (out));
+	g_object_unref (out);
+
+	g_object_set_data_full (G_OBJECT (document),
+				"data-uncompressed",
+				data,
+				(GDestroyNotify) g_bytes_unref);
+	_ev_document_set_uri (document, uri);
+
+	stream = g_memory_input_stream_new_from_bytes (data);
+	*result = ev_document_load_stream (document, stream,
+					   EV_DOCUMENT_LOAD_FLAG_NONE,
+					   NULL, error);
+	g_object_unref (stream);
+
+	return TRUE;
+}
+
 /*
  * _ev_document_factory_init:
  *
@@ -297,20 +414,22 @@ ev_document_factory_get_document (const char *uri, GError **error)
 	g_assert (document != NULL || err != NULL);
 
 	if (document != NULL) {
-		uri_unc = ev_file_uncompress (uri, compression, &err);
-		if (uri_unc) {
-			g_object_set_data_full (G_OBJECT (document),
-						"uri-uncompressed",
-						uri_unc,
-						(GDestroyNotify) free_uncompressed_uri);
-		} else if (err != NULL) {
-			/* Error uncompressing file */
-			g_object_unref (document);
-			g_propagate_error (error, err);
-			return NULL;
-		}
+		if (!load_compressed_from_memory (document, uri, compression, &result, &err)) {
+			uri_unc = ev_file_uncompress (uri, compression, &err);
+			if (uri_unc) {
+				g_object_set_data_full (G_OBJECT (document),
+							"uri-uncompressed",
+							uri_unc,
+							(GDestroyNotify) free_uncompressed_uri);
+			} else if (err != NULL) {
+				/* Error uncompressing file */
+				g_object_unref (document);
+				g_propagate_error (error, err);
+				return NULL;
+			}
 
-		result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+			result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+		}
 
 		if (result == FALSE || err) {
 			if (err &&
@@ -338,21 +457,24 @@ ev_document_factory_get_document (const char *uri, GError **error)
 		return NULL;
 	}
 
-	uri_unc = ev_file_uncompress (uri, compression, &err);
-	if (uri_unc) {
-		g_object_set_data_full (G_OBJECT (document),
-					"uri-uncompressed",
-					uri_unc,
-					(GDestroyNotify) free_uncompressed_uri);
-	} else if (err != NULL) {
-		/* Error uncompressing file */
-		g_propagate_error (error, err);
+	if (!load_compressed_from_memory (document, uri, compression, &result, &err)) {
+		uri_unc = ev_file_uncompress (uri, compression, &err);
+		if (uri_unc) {
+			g_object_set_data_full (G_OBJECT (document),
+						"uri-uncompressed",
+						uri_unc,
+						(GDestroyNotify) free_uncompressed_uri);
+		} else if (err != NULL) {
+			/* Error uncompressing file */
+			g_propagate_error (error, err);
 
-		g_object_unref (document);
-		return NULL;
+			g_object_unref (document);
+			return NULL;
+		}
+
+		result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
 	}
 
-	result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
 	if (result == FALSE) {
 		if (err == NULL) {
 			/* FIXME: this really should not happen; the backend should
@@ -60,6 +60,109 @@ ev_document_links_get_links_model (EvDocumentLinks *document_links)
 	return retval;
 }
 
+/**
+ * ev_document_links_expand_links_node:
+ * @document_links: an #EvDocumentLinks
+ * @model: a #GtkTreeModel returned by ev_document_links_get_links_model()
+ * @iter: a #GtkTreeIter pointing to a row of @model
+ *
+ * Backends with large outlines may return a links model where the
+ * children of collapsed nodes are not built yet. Those nodes have a
+ * single placeholder child with no link, so that they can be expanded.
+ * This function replaces the placeholder with the actual children of
+ * the node pointed to by @iter.
+ *
+ * Returns: %TRUE if new rows were added to @model
+ *
+ * Since: 3.10
+ */
+gboolean
+ev_document_links_expand_links_node (EvDocumentLinks *document_links,
+				     GtkTreeModel    *model,
+				     GtkTreeIter     *iter)
+{
+	EvDocumentLinksInterface *iface = EV_DOCUMENT_LINKS_GET_IFACE (document_links);
+	gboolean retval;
+
+	if (!iface->expand_links_node)
+		return FALSE;
+
+	ev_document_doc_mutex_lock ();
+	retval = iface->expand_links_node (document_links, model, iter);
+	ev_document_doc_mutex_unlock ();
+
+	return retval;
+}
+
+static gboolean
+links_model_foreach_children (EvDocumentLinks        *document_links,
+			      GtkTreeModel           *model,
+			      GtkTreeIter            *parent,
+			      GtkTreePath            *path,
+			      GtkTreeModelForeachFunc func,
+			      gpointer                user_data)
+{
+	GtkTreeIter iter;
+	gboolean    retval = FALSE;
+
+	if (!gtk_tree_model_iter_children (model, &iter, parent))
+		return FALSE;
+
+	gtk_tree_path_down (path);
+	do {
+		if (func (model, path, &iter, user_data)) {
+			retval = TRUE;
+			break;
+		}
+
+		if (gtk_tree_model_iter_has_child (model, &iter)) {
+			ev_document_links_expand_links_node (document_links, model, &iter);
+			if (links_model_foreach_children (document_links, model, &iter,
+							  path, func, user_data)) {
+				retval = TRUE;
+				break;
+			}
+		}
+
+		gtk_tree_path_next (path);
+	} while (gtk_tree_model_iter_next (model, &iter));
+	gtk_tree_path_up (path);
+
+	return retval;
+}
+
+/**
+ * ev_document_links_foreach_link:
+ * @document_links: an #EvDocumentLinks
+ * @model: a #GtkTreeModel returned by ev_document_links_get_links_model()
+ * @func: (scope call): a function to be called on each row
+ * @user_data: user data to pass to @func
+ *
+ * Calls @func on each row of @model in depth-first order, like
+ * gtk_tree_model_foreach() does, but building the children of the nodes
+ * not expanded yet before visiting them, see
+ * ev_document_links_expand_links_node(). If @func returns %TRUE, the
+ * walk stops, leaving the rest of the nodes unbuilt.
+ *
+ * Since: 3.10
+ */
+void
+ev_document_links_foreach_link (EvDocumentLinks        *document_links,
+				GtkTreeModel           *model,
+				GtkTreeModelForeachFunc func,
+				gpointer                user_data)
+{
+	GtkTreePath *path;
+
+	g_return_if_fail (EV_IS_DOCUMENT_LINKS (document_links));
+	g_return_if_fail (GTK_IS_TREE_MODEL (model));
+	g_return_if_fail (func != NULL);
+
+	path = gtk_tree_path_new ();
+	links_model_foreach_children (document_links, model, NULL, path, func, user_data);
+	gtk_tree_path_free (path);
+}
+
 EvMappingList *
 ev_document_links_get_links (EvDocumentLinks *document_links,
 			     EvPage          *page)
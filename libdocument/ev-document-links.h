@@ -69,11 +69,21 @@ struct _EvDocumentLinksInterface
 					       const gchar     *link_name);
 	gint           (* find_link_page)     (EvDocumentLinks *document_links,
 					       const gchar     *link_name);
+	gboolean       (* expand_links_node)  (EvDocumentLinks *document_links,
+					       GtkTreeModel    *model,
+					       GtkTreeIter     *iter);
 };
 
 GType          ev_document_links_get_type            (void) G_GNUC_CONST;
 gboolean       ev_document_links_has_document_links  (EvDocumentLinks *document_links);
 GtkTreeModel  *ev_document_links_get_links_model     (EvDocumentLinks *document_links);
+gboolean       ev_document_links_expand_links_node   (EvDocumentLinks *document_links,
+						      GtkTreeModel    *model,
+						      GtkTreeIter     *iter);
+void           ev_document_links_foreach_link        (EvDocumentLinks *document_links,
+						      GtkTreeModel    *model,
+						      GtkTreeModelForeachFunc func,
+						      gpointer         user_data);
 
 EvMappingList *ev_document_links_get_links           (EvDocumentLinks *document_links,
 						      EvPage          *page);
@@ -25,7 +25,9 @@
 #include <string.h>
 
 #include "ev-document.h"
+#include "ev-document-private.h"
 #include "ev-document-misc.h"
+#include "ev-trace.h"
 #include "synctex_parser.h"
 
 #define EV_DOCUMENT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), EV_TYPE_DOCUMENT, EvDocumentPrivate))
@@ -36,6 +38,12 @@ typedef struct _EvPageSize
 	gdouble height;
 } EvPageSize;
 
+/* Labels sorted by their case folded text, for prefix lookups */
+typedef struct {
+	gchar *folded;
+	gint   page;
+} EvPageLabel;
+
 struct _EvDocumentPrivate
 {
 	gchar          *uri;
@@ -53,13 +61,28 @@ struct _EvDocumentPrivate
 	gint            max_label;
 
 	gchar         **page_labels;
+	GHashTable     *page_labels_exact;
+	GHashTable     *page_labels_folded;
+	EvPageLabel    *sorted_labels;
+	gint            n_sorted_labels;
 	EvPageSize     *page_sizes;
 	EvDocumentInfo *info;
 
 	synctex_scanner_t synctex_scanner;
+	/* Set while the synctex file is parsed */
+	GCancellable     *synctex_cancellable;
+};
+
+enum {
+	SYNCTEX_PARSED,
+	N_SIGNALS
 };
 
+static guint signals[N_SIGNALS];
+
 static gint            _ev_document_get_n_pages     (EvDocument *document);
+static void            ev_document_free_synctex     (EvDocument *document);
+static void            ev_document_free_page_labels_index (EvDocument *document);
 static void            _ev_document_get_page_size   (EvDocument *document,
 						     EvPage     *page,
 						     double     *width,
@@ -122,15 +145,14 @@ ev_document_finalize (GObject *object)
 		document->priv->page_labels = NULL;
 	}
 
+	ev_document_free_page_labels_index (document);
+
 	if (document->priv->info) {
 		ev_document_info_free (document->priv->info);
 		document->priv->info = NULL;
 	}
 
-	if (document->priv->synctex_scanner) {
-		synctex_scanner_free (document->priv->synctex_scanner);
-		document->priv->synctex_scanner = NULL;
-	}
+	ev_document_free_synctex (document);
 
 	G_OBJECT_CLASS (ev_document_parent_class)->finalize (object);
 }
@@ -156,12 +178,44 @@ ev_document_class_init (EvDocumentClass *klass)
 	klass->get_backend_info = NULL;
 
 	g_object_class->finalize = ev_document_finalize;
+
+	/**
+	 * EvDocument::synctex-parsed:
+	 * @document: the object which received the signal
+	 *
+	 * The ::synctex-parsed signal is emitted in the main thread when
+	 * the synctex file of @document has been parsed, whether it
+	 * succeeded or not. SyncTeX searches are answered from then on.
+	 *
+	 * Since: 3.10
+	 */
+	signals[SYNCTEX_PARSED] =
+		g_signal_new ("synctex-parsed",
+			      EV_TYPE_DOCUMENT,
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 }
 
 void
 ev_document_doc_mutex_lock (void)
 {
+	gint64 start;
+
+	if (G_LIKELY (!ev_trace_is_enabled ())) {
+		g_mutex_lock (&ev_doc_mutex);
+		return;
+	}
+
+	/* Only waits are interesting, skip uncontended locks */
+	if (g_mutex_trylock (&ev_doc_mutex))
+		return;
+
+	start = ev_trace_begin ();
 	g_mutex_lock (&ev_doc_mutex);
+	ev_trace_end (start, "doc-mutex-wait", "lock", NULL, -1);
 }
 
 void
@@ -194,6 +248,82 @@ ev_document_fc_mutex_trylock (void)
 	return g_mutex_trylock (&ev_fc_mutex);
 }
 
+static void
+ev_document_free_page_labels_index (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	gint               i;
+
+	if (priv->page_labels_exact) {
+		g_hash_table_destroy (priv->page_labels_exact);
+		priv->page_labels_exact = NULL;
+	}
+
+	if (priv->page_labels_folded) {
+		g_hash_table_destroy (priv->page_labels_folded);
+		priv->page_labels_folded = NULL;
+	}
+
+	for (i = 0; i < priv->n_sorted_labels; i++)
+		g_free (priv->sorted_labels[i].folded);
+	g_free (priv->sorted_labels);
+	priv->sorted_labels = NULL;
+	priv->n_sorted_labels = 0;
+}
+
+static gint
+ev_page_label_compare (gconstpointer a,
+		       gconstpointer b)
+{
+	const EvPageLabel *label_a = a;
+	const EvPageLabel *label_b = b;
+	gint               retval;
+
+	retval = strcmp (label_a->folded, label_b->folded);
+
+	return retval != 0 ? retval : label_a->page - label_b->page;
+}
+
+/* Maps the labels and their case folded versions to the first page
+ * using them, so that looking up a label doesn't need to go through
+ * all the pages of the document.
+ */
+static void
+ev_document_build_page_labels_index (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	gint               i;
+
+	ev_document_free_page_labels_index (document);
+
+	priv->page_labels_exact = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->page_labels_folded = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->sorted_labels = g_new (EvPageLabel, priv->n_pages);
+
+	for (i = 0; i < priv->n_pages; i++) {
+		EvPageLabel *label;
+
+		if (!priv->page_labels[i])
+			continue;
+
+		label = &priv->sorted_labels[priv->n_sorted_labels++];
+		label->folded = g_utf8_casefold (priv->page_labels[i], -1);
+		label->page = i;
+
+		if (!g_hash_table_contains (priv->page_labels_exact, priv->page_labels[i]))
+			g_hash_table_insert (priv->page_labels_exact,
+					     priv->page_labels[i],
+					     GINT_TO_POINTER (i));
+		if (!g_hash_table_contains (priv->page_labels_folded, label->folded))
+			g_hash_table_insert (priv->page_labels_folded,
+					     label->folded,
+					     GINT_TO_POINTER (i));
+	}
+
+	qsort (priv->sorted_labels, priv->n_sorted_labels,
+	       sizeof (EvPageLabel), ev_page_label_compare);
+}
+
 static void
 ev_document_setup_cache (EvDocument *document)
 {
@@ -266,6 +396,47 @@ ev_document_setup_cache (EvDocument *document)
 
                 g_object_unref (page);
         }
+
+        if (priv->page_labels)
+                ev_document_build_page_labels_index (document);
+}
+
+static void
+synctex_parse_thread (GTask        *task,
+		      gpointer      source_object,
+		      gpointer      task_data,
+		      GCancellable *cancellable)
+{
+	synctex_scanner_t scanner;
+
+	/* The parser frees the scanner when it fails */
+	scanner = synctex_scanner_parse ((synctex_scanner_t)task_data);
+
+	/* Freed by the task if nobody is waiting for it anymore */
+	g_task_return_pointer (task, scanner, (GDestroyNotify)synctex_scanner_free);
+}
+
+static void
+synctex_parse_finished_cb (GObject      *source_object,
+			   GAsyncResult *result,
+			   gpointer      user_data)
+{
+	EvDocument       *document;
+	synctex_scanner_t scanner;
+	GError           *error = NULL;
+
+	/* Fails when the document was finalized meanwhile */
+	scanner = g_task_propagate_pointer (G_TASK (result), &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	document = EV_DOCUMENT (user_data);
+	g_clear_object (&document->priv->synctex_cancellable);
+	document->priv->synctex_scanner = scanner;
+
+	g_signal_emit (document, signals[SYNCTEX_PARSED], 0);
 }
 
 static void
@@ -274,18 +445,61 @@ ev_document_initialize_synctex (EvDocument  *document,
 {
 	EvDocumentPrivate *priv = document->priv;
 
+	ev_document_free_synctex (document);
+
 	if (_ev_document_support_synctex (document)) {
 		gchar *filename;
 
 		filename = g_filename_from_uri (uri, NULL, NULL);
 		if (filename != NULL) {
-			priv->synctex_scanner =
-				synctex_scanner_new_with_output_file (filename, NULL, 1);
+			synctex_scanner_t scanner;
+
+			/* Only look for the synctex file here, parsing
+			 * it can take several seconds for big documents so
+			 * it's done in a thread while the document is shown.
+			 * The task doesn't hold a reference on the document,
+			 * it's cancelled when the document is finalized.
+			 */
+			scanner = synctex_scanner_new_with_output_file (filename, NULL, 0);
+			if (scanner) {
+				GTask *task;
+
+				priv->synctex_cancellable = g_cancellable_new ();
+				task = g_task_new (NULL, priv->synctex_cancellable,
+						   synctex_parse_finished_cb, document);
+				g_task_set_task_data (task, scanner, NULL);
+				g_task_run_in_thread (task, synctex_parse_thread);
+				g_object_unref (task);
+			}
 			g_free (filename);
 		}
 	}
 }
 
+static synctex_scanner_t
+ev_document_get_synctex_scanner (EvDocument *document)
+{
+	/* NULL until the synctex file has been parsed */
+	return document->priv->synctex_scanner;
+}
+
+static void
+ev_document_free_synctex (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+
+	/* Don't wait for the parser, the task frees the scanner */
+	if (priv->synctex_cancellable) {
+		g_cancellable_cancel (priv->synctex_cancellable);
+		g_clear_object (&priv->synctex_cancellable);
+	}
+
+	if (priv->synctex_scanner) {
+		synctex_scanner_free (priv->synctex_scanner);
+		priv->synctex_scanner = NULL;
+	}
+}
+
 /**
  * ev_document_load:
  * @document: a #EvDocument
@@ -375,6 +589,8 @@ ev_document_load_stream (EvDocument         *document,
                 return FALSE;
 
         ev_document_setup_cache (document);
+	if (document->priv->uri)
+		ev_document_initialize_synctex (document, document->priv->uri);
 
         return TRUE;
 }
@@ -469,6 +685,13 @@ _ev_document_support_synctex (EvDocument *document)
 	return klass->support_synctex ? klass->support_synctex (document) : FALSE;
 }
 
+/**
+ * ev_document_has_synctex:
+ * @document: a #EvDocument
+ *
+ * Returns: %TRUE if the synctex file of @document has been parsed
+ *   successfully. See ev_document_is_parsing_synctex().
+ */
 gboolean
 ev_document_has_synctex (EvDocument *document)
 {
@@ -477,6 +700,23 @@ ev_document_has_synctex (EvDocument *document)
 	return document->priv->synctex_scanner != NULL;
 }
 
+/**
+ * ev_document_is_parsing_synctex:
+ * @document: a #EvDocument
+ *
+ * Returns: %TRUE while the synctex file of @document is being parsed;
+ *   #EvDocument::synctex-parsed is emitted when it's done
+ *
+ * Since: 3.10
+ */
+gboolean
+ev_document_is_parsing_synctex (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return document->priv->synctex_cancellable != NULL;
+}
+
 /**
  * ev_document_synctex_backward_search:
  * @document: a #EvDocument
@@ -503,7 +743,7 @@ ev_document_synctex_backward_search (EvDocument *document,
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 
-        scanner = document->priv->synctex_scanner;
+        scanner = ev_document_get_synctex_scanner (document);
         if (!scanner)
                 return NULL;
 
@@ -548,7 +788,7 @@ ev_document_synctex_forward_search (EvDocument   *document,
 
         g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 
-        scanner = document->priv->synctex_scanner;
+        scanner = ev_document_get_synctex_scanner (document);
         if (!scanner)
                 return NULL;
 
@@ -684,8 +924,55 @@ ev_document_render (EvDocument      *document,
 		    EvRenderContext *rc)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t *surface;
+	gint64           start;
+
+	start = ev_trace_begin ();
+	surface = klass->render (document, rc);
+	ev_trace_end (start, "render", G_OBJECT_TYPE_NAME (document), document, rc->page->index);
+
+	return surface;
+}
+
+/**
+ * ev_document_render_region:
+ * @document: an #EvDocument
+ * @rc: an #EvRenderContext
+ * @surface: the #cairo_surface_t to draw into
+ * @region: the area to draw, in pixels of the rendered page
+ *
+ * Renders again the parts of the page covered by @region into @surface,
+ * leaving the rest of @surface untouched. The device offset of @surface
+ * can be used to render a part of the page into a smaller surface.
+ * Backends that can't render part of a page return %FALSE without
+ * modifying @surface, and the whole page should be rendered instead.
+ *
+ * Returns: %TRUE if @region was rendered
+ *
+ * Since: 3.10
+ */
+gboolean
+ev_document_render_region (EvDocument           *document,
+			   EvRenderContext      *rc,
+			   cairo_surface_t      *surface,
+			   const cairo_region_t *region)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	gboolean         retval;
+	gint64           start;
 
-	return klass->render (document, rc);
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	g_return_val_if_fail (surface != NULL, FALSE);
+	g_return_val_if_fail (region != NULL, FALSE);
+
+	if (!klass->render_region)
+		return FALSE;
+
+	start = ev_trace_begin ();
+	retval = klass->render_region (document, rc, surface, region);
+	ev_trace_end (start, "render-region", G_OBJECT_TYPE_NAME (document), document, rc->page->index);
+
+	return retval;
 }
 
 static GdkPixbuf *
@@ -714,11 +1001,17 @@ ev_document_get_thumbnail (EvDocument      *document,
 			   EvRenderContext *rc)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	GdkPixbuf       *pixbuf;
+	gint64           start;
 
+	start = ev_trace_begin ();
 	if (klass->get_thumbnail)
-		return klass->get_thumbnail (document, rc);
+		pixbuf = klass->get_thumbnail (document, rc);
+	else
+		pixbuf = _ev_document_get_thumbnail (document, rc);
+	ev_trace_end (start, "thumbnail", G_OBJECT_TYPE_NAME (document), document, rc->page->index);
 
-	return _ev_document_get_thumbnail (document, rc);
+	return pixbuf;
 }
 
 const gchar *
@@ -729,6 +1022,29 @@ ev_document_get_uri (EvDocument *document)
 	return document->priv->uri;
 }
 
+/*
+ * _ev_document_set_uri:
+ * @document: a #EvDocument
+ * @uri: the document's URI
+ *
+ * Sets the URI of a document that is loaded from a stream, so that
+ * ev_document_get_uri() returns the file it was read from. When set
+ * before loading, the SyncTeX data next to that file is also found,
+ * like for ev_document_load().
+ */
+void
+_ev_document_set_uri (EvDocument  *document,
+		      const gchar *uri)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (document->priv->uri == uri)
+		return;
+
+	g_free (document->priv->uri);
+	document->priv->uri = g_strdup (uri);
+}
+
 const gchar *
 ev_document_get_title (EvDocument *document)
 {
@@ -801,8 +1117,9 @@ ev_document_find_page_by_label (EvDocument  *document,
 				const gchar *page_label,
 				gint        *page_index)
 {
-	gint i, page;
+	gint page;
 	glong value;
+	gpointer value_ptr;
 	gchar *endptr = NULL;
 	EvDocumentPrivate *priv = document->priv;
 
@@ -811,19 +1128,24 @@ ev_document_find_page_by_label (EvDocument  *document,
 	g_return_val_if_fail (page_index != NULL, FALSE);
 
         /* First, look for a literal label match */
-	for (i = 0; priv->page_labels && i < priv->n_pages; i ++) {
-		if (priv->page_labels[i] != NULL &&
-		    ! strcmp (page_label, priv->page_labels[i])) {
-			*page_index = i;
-			return TRUE;
-		}
+	if (priv->page_labels_exact &&
+	    g_hash_table_lookup_extended (priv->page_labels_exact, page_label,
+					  NULL, &value_ptr)) {
+		*page_index = GPOINTER_TO_INT (value_ptr);
+		return TRUE;
 	}
 
 	/* Second, look for a match with case insensitively */
-	for (i = 0; priv->page_labels && i < priv->n_pages; i++) {
-		if (priv->page_labels[i] != NULL &&
-		    ! strcasecmp (page_label, priv->page_labels[i])) {
-			*page_index = i;
+	if (priv->page_labels_folded) {
+		gchar   *folded;
+		gboolean found;
+
+		folded = g_utf8_casefold (page_label, -1);
+		found = g_hash_table_lookup_extended (priv->page_labels_folded, folded,
+						      NULL, &value_ptr);
+		g_free (folded);
+		if (found) {
+			*page_index = GPOINTER_TO_INT (value_ptr);
 			return TRUE;
 		}
 	}
@@ -845,6 +1167,80 @@ ev_document_find_page_by_label (EvDocument  *document,
 	return FALSE;
 }
 
+/**
+ * ev_document_complete_page_label:
+ * @document: an #EvDocument
+ * @prefix: the beginning of a page label
+ * @max_labels: the maximum number of labels to return
+ *
+ * Looks up the page labels starting with @prefix, ignoring case, to
+ * complete a page label as the user types it. A label equal to @prefix
+ * comes first, then the others in alphabetical order.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): a %NULL terminated
+ * array of distinct page labels, or %NULL if no label starts with @prefix.
+ * Free it with g_strfreev().
+ *
+ * Since: 3.10
+ */
+gchar **
+ev_document_complete_page_label (EvDocument  *document,
+				 const gchar *prefix,
+				 guint        max_labels)
+{
+	EvDocumentPrivate *priv;
+	GPtrArray         *labels;
+	gchar             *folded;
+	gsize              folded_len;
+	gint               low, hi;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+	g_return_val_if_fail (prefix != NULL, NULL);
+
+	priv = document->priv;
+	if (priv->n_sorted_labels == 0 || max_labels == 0)
+		return NULL;
+
+	folded = g_utf8_casefold (prefix, -1);
+	folded_len = strlen (folded);
+
+	/* First label not sorted before the prefix */
+	low = 0;
+	hi = priv->n_sorted_labels;
+	while (low < hi) {
+		gint mid = (low + hi) / 2;
+
+		if (strcmp (priv->sorted_labels[mid].folded, folded) < 0)
+			low = mid + 1;
+		else
+			hi = mid;
+	}
+
+	labels = g_ptr_array_new ();
+	for (; low < priv->n_sorted_labels && labels->len < max_labels; low++) {
+		EvPageLabel *label = &priv->sorted_labels[low];
+
+		if (strncmp (label->folded, folded, folded_len) != 0)
+			break;
+
+		/* The same label can be used by several pages */
+		if (low > 0 && strcmp (label->folded, priv->sorted_labels[low - 1].folded) == 0)
+			continue;
+
+		g_ptr_array_add (labels, g_strdup (priv->page_labels[label->page]));
+	}
+	g_free (folded);
+
+	if (labels->len == 0) {
+		g_ptr_array_free (labels, TRUE);
+		return NULL;
+	}
+
+	g_ptr_array_add (labels, NULL);
+
+	return (gchar **) g_ptr_array_free (labels, FALSE);
+}
+
 /* EvSourceLink */
 G_DEFINE_BOXED_TYPE (EvSourceLink, ev_source_link, ev_source_link_copy, ev_source_link_free)
 
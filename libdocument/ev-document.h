@@ -128,6 +128,12 @@ struct _EvDocumentClass
                                                EvDocumentLoadFlags  flags,
                                                GCancellable        *cancellable,
                                                GError             **error);
+
+        /* Partial rendering */
+        gboolean          (* render_region)   (EvDocument           *document,
+                                               EvRenderContext      *rc,
+                                               cairo_surface_t      *surface,
+                                               const cairo_region_t *region);
 };
 
 GType            ev_document_get_type             (void) G_GNUC_CONST;
@@ -175,6 +181,10 @@ gchar           *ev_document_get_page_label       (EvDocument      *document,
 						   gint             page_index);
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
+gboolean         ev_document_render_region        (EvDocument           *document,
+						   EvRenderContext      *rc,
+						   cairo_surface_t      *surface,
+						   const cairo_region_t *region);
 GdkPixbuf       *ev_document_get_thumbnail        (EvDocument      *document,
 						   EvRenderContext *rc);
 const gchar     *ev_document_get_uri              (EvDocument      *document);
@@ -192,7 +202,11 @@ gboolean         ev_document_has_text_page_labels (EvDocument      *document);
 gboolean         ev_document_find_page_by_label   (EvDocument      *document,
 						   const gchar     *page_label,
 						   gint            *page_index);
+gchar          **ev_document_complete_page_label  (EvDocument      *document,
+						   const gchar     *prefix,
+						   guint            max_labels);
 gboolean	 ev_document_has_synctex 	  (EvDocument      *document);
+gboolean         ev_document_is_parsing_synctex   (EvDocument      *document);
 
 EvSourceLink    *ev_document_synctex_backward_search
                                                   (EvDocument      *document,
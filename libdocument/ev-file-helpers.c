@@ -21,15 +21,22 @@
 
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
 
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 
 #include "ev-file-helpers.h"
+#include "ev-bzip2-decompressor.h"
 
 static gchar *tmp_dir = NULL;
 
@@ -427,6 +434,376 @@ ev_xfer_uri_simple (const char *from,
 	return result;
 }
 
+#define CLONE_BUFFER_SIZE (256 * 1024)
+
+static gboolean
+clone_fd_streaming (gint     src_fd,
+		    gint     dst_fd,
+		    GError **error)
+{
+	gchar  *buffer;
+	gssize  n_read;
+	gint    errsv = 0;
+
+	buffer = g_malloc (CLONE_BUFFER_SIZE);
+
+	while ((n_read = read (src_fd, buffer, CLONE_BUFFER_SIZE)) != 0) {
+		gchar *p = buffer;
+
+		if (n_read < 0) {
+			if (errno == EINTR)
+				continue;
+			errsv = errno;
+			break;
+		}
+
+		while (n_read > 0) {
+			gssize n_written;
+
+			n_written = write (dst_fd, p, n_read);
+			if (n_written < 0) {
+				if (errno == EINTR)
+					continue;
+				errsv = errno;
+				break;
+			}
+			p += n_written;
+			n_read -= n_written;
+		}
+
+		if (errsv)
+			break;
+	}
+
+	g_free (buffer);
+
+	if (errsv) {
+		g_set_error_literal (error, G_IO_ERROR,
+				     g_io_error_from_errno (errsv),
+				     g_strerror (errsv));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+clone_fd (gint     src_fd,
+	  gint     dst_fd,
+	  GError **error)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+	struct stat st;
+	gssize      n_copied;
+#endif
+
+#ifdef FICLONE
+	/* Shares the data extents on CoW file systems like btrfs or XFS */
+	if (ioctl (dst_fd, FICLONE, src_fd) == 0)
+		return TRUE;
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+	/* Copies in the kernel, avoiding the round trip through user space */
+	if (fstat (src_fd, &st) == 0) {
+		gsize remaining = st.st_size;
+
+		while (remaining > 0) {
+			n_copied = copy_file_range (src_fd, NULL, dst_fd, NULL, remaining, 0);
+			if (n_copied <= 0)
+				break;
+			remaining -= n_copied;
+		}
+
+		if (remaining == 0)
+			return TRUE;
+
+		/* Nothing was copied, the streaming copy below can start from scratch,
+		 * otherwise continue from the current offsets.
+		 */
+		if (remaining == (gsize)st.st_size &&
+		    (lseek (src_fd, 0, SEEK_SET) == -1 ||
+		     lseek (dst_fd, 0, SEEK_SET) == -1 ||
+		     ftruncate (dst_fd, 0) == -1)) {
+			int errsv = errno;
+
+			g_set_error_literal (error, G_IO_ERROR,
+					     g_io_error_from_errno (errsv),
+					     g_strerror (errsv));
+			return FALSE;
+		}
+	}
+#endif
+
+	return clone_fd_streaming (src_fd, dst_fd, error);
+}
+
+/**
+ * ev_file_clone:
+ * @from: the source URI
+ * @to: the target URI
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Copies the contents of @from to @to. When both URIs are local files,
+ * it tries to share the data with a reflink, or to copy it in the kernel
+ * with copy_file_range(), before falling back to a streaming copy. The
+ * data is written to a temporary file replacing @to once complete, and
+ * nothing is done when @to is the same file as @from.
+ * Otherwise it's equivalent to ev_xfer_uri_simple().
+ *
+ * Returns: %TRUE on success, or %FALSE on error with @error filled in
+ *
+ * Since: 3.10
+ */
+gboolean
+ev_file_clone (const char *from,
+	       const char *to,
+	       GError    **error)
+{
+	gchar      *src_filename;
+	gchar      *dst_filename;
+	gchar      *tmp_filename;
+	gchar      *dst_dir;
+	gchar      *dst_basename;
+	gchar      *tmp_basename;
+	gint        src_fd, dst_fd;
+	gint        errsv;
+	gboolean    retval;
+	struct stat src_st, dst_st;
+
+	g_return_val_if_fail (from != NULL, FALSE);
+	g_return_val_if_fail (to != NULL, FALSE);
+
+	src_filename = g_filename_from_uri (from, NULL, NULL);
+	dst_filename = g_filename_from_uri (to, NULL, NULL);
+	if (!src_filename || !dst_filename) {
+		g_free (src_filename);
+		g_free (dst_filename);
+
+		return ev_xfer_uri_simple (from, to, error);
+	}
+
+	src_fd = g_open (src_filename, O_RDONLY, 0);
+	if (src_fd == -1) {
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "Failed to open '%s': %s", src_filename, g_strerror (errsv));
+		g_free (src_filename);
+		g_free (dst_filename);
+
+		return FALSE;
+	}
+
+	/* Saving a document over itself, there's nothing to copy */
+	if (fstat (src_fd, &src_st) == 0 &&
+	    g_stat (dst_filename, &dst_st) == 0 &&
+	    src_st.st_dev == dst_st.st_dev &&
+	    src_st.st_ino == dst_st.st_ino) {
+		close (src_fd);
+		g_free (src_filename);
+		g_free (dst_filename);
+
+		return TRUE;
+	}
+
+	/* The copy is written next to the target and renamed over it
+	 * at the end, so that the target is never left half written
+	 */
+	dst_dir = g_path_get_dirname (dst_filename);
+	dst_basename = g_path_get_basename (dst_filename);
+	tmp_basename = g_strdup_printf (".%s.XXXXXX", dst_basename);
+	tmp_filename = g_build_filename (dst_dir, tmp_basename, NULL);
+	g_free (dst_dir);
+	g_free (dst_basename);
+	g_free (tmp_basename);
+
+	dst_fd = g_mkstemp_full (tmp_filename, O_WRONLY, 0666);
+	if (dst_fd == -1) {
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "Failed to create '%s': %s", dst_filename, g_strerror (errsv));
+		close (src_fd);
+		g_free (src_filename);
+		g_free (dst_filename);
+		g_free (tmp_filename);
+
+		return FALSE;
+	}
+
+	retval = clone_fd (src_fd, dst_fd, error);
+
+	close (src_fd);
+	if (close (dst_fd) == -1 && retval) {
+		errsv = errno;
+		g_set_error_literal (error, G_IO_ERROR,
+				     g_io_error_from_errno (errsv),
+				     g_strerror (errsv));
+		retval = FALSE;
+	}
+
+	if (retval && g_rename (tmp_filename, dst_filename) == -1) {
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "Failed to create '%s': %s", dst_filename, g_strerror (errsv));
+		retval = FALSE;
+	}
+
+	if (!retval)
+		g_unlink (tmp_filename);
+
+	g_free (src_filename);
+	g_free (dst_filename);
+	g_free (tmp_filename);
+
+	return retval;
+}
+
+typedef struct {
+	gchar       *key;
+	GMappedFile *mapped_file;
+	gint         users;
+} EvFileMapping;
+
+static gboolean    file_mapping_enabled = FALSE;
+static GHashTable *file_mappings = NULL;
+G_LOCK_DEFINE_STATIC (file_mappings);
+
+static void
+ev_file_mapping_release (EvFileMapping *mapping)
+{
+	G_LOCK (file_mappings);
+
+	if (--mapping->users > 0) {
+		G_UNLOCK (file_mappings);
+		return;
+	}
+
+	if (g_hash_table_lookup (file_mappings, mapping->key) == mapping)
+		g_hash_table_remove (file_mappings, mapping->key);
+
+	G_UNLOCK (file_mappings);
+
+	g_mapped_file_unref (mapping->mapped_file);
+	g_free (mapping->key);
+	g_free (mapping);
+}
+
+/**
+ * ev_file_set_map_enabled:
+ * @enabled: whether ev_file_map() should map files
+ *
+ * Enables or disables ev_file_map() for the process. It's disabled by
+ * default, because a mapped file that is truncated by another process,
+ * while the document is still open, makes the next access to the lost
+ * pages crash the process with SIGBUS.
+ *
+ * Since: 3.10
+ */
+void
+ev_file_set_map_enabled (gboolean enabled)
+{
+	file_mapping_enabled = enabled;
+}
+
+/**
+ * ev_file_map:
+ * @uri: a file URI
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Maps the contents of the local file at @uri in memory, so that backends
+ * able to load documents from memory read it from the page cache instead
+ * of copying it to their own buffers. Mapping the same unmodified file
+ * again, e.g. to reload it or to open it in another window, returns the
+ * existing mapping.
+ *
+ * If mapping is disabled, @uri is not a local file or the file is empty,
+ * it returns %NULL and fills in @error with %G_IO_ERROR_NOT_SUPPORTED;
+ * the backend should then load the document as usual.
+ *
+ * Returns: (transfer full): a #GBytes with the contents of the file,
+ *   or %NULL on error
+ *
+ * Since: 3.10
+ */
+GBytes *
+ev_file_map (const gchar *uri,
+	     GError     **error)
+{
+	EvFileMapping *mapping;
+	GMappedFile   *mapped_file;
+	GStatBuf       statbuf;
+	gchar         *filename;
+	gchar         *key;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	filename = file_mapping_enabled ? g_filename_from_uri (uri, NULL, NULL) : NULL;
+	if (!filename) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "File mapping is not supported for this document");
+		return NULL;
+	}
+
+	if (g_stat (filename, &statbuf) != 0 || !S_ISREG (statbuf.st_mode) ||
+	    statbuf.st_size == 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "File mapping is not supported for this document");
+		g_free (filename);
+		return NULL;
+	}
+
+	/* A file modified in place doesn't match the old mapping */
+	key = g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+			       (guint64) statbuf.st_dev, (guint64) statbuf.st_ino,
+			       (gint64) statbuf.st_mtime, (gint64) statbuf.st_size);
+
+	G_LOCK (file_mappings);
+
+	if (!file_mappings)
+		file_mappings = g_hash_table_new (g_str_hash, g_str_equal);
+
+	mapping = g_hash_table_lookup (file_mappings, key);
+	if (mapping) {
+		mapping->users++;
+
+		G_UNLOCK (file_mappings);
+
+		g_free (key);
+		g_free (filename);
+
+		return g_bytes_new_with_free_func (g_mapped_file_get_contents (mapping->mapped_file),
+						   g_mapped_file_get_length (mapping->mapped_file),
+						   (GDestroyNotify) ev_file_mapping_release,
+						   mapping);
+	}
+
+	G_UNLOCK (file_mappings);
+
+	mapped_file = g_mapped_file_new (filename, FALSE, error);
+	g_free (filename);
+	if (!mapped_file) {
+		g_free (key);
+
+		return NULL;
+	}
+
+	mapping = g_new (EvFileMapping, 1);
+	mapping->key = key;
+	mapping->mapped_file = mapped_file;
+	mapping->users = 1;
+
+	G_LOCK (file_mappings);
+	/* Another thread could have mapped it meanwhile, keep the first */
+	if (!g_hash_table_contains (file_mappings, key))
+		g_hash_table_insert (file_mappings, key, mapping);
+	G_UNLOCK (file_mappings);
+
+	return g_bytes_new_with_free_func (g_mapped_file_get_contents (mapped_file),
+					   g_mapped_file_get_length (mapped_file),
+					   (GDestroyNotify) ev_file_mapping_release,
+					   mapping);
+}
+
 /**
  * ev_file_copy_metadata:
  * @from: the source URI
@@ -588,6 +965,89 @@ static const char *compressor_cmds[] = {
 #define N_ARGS      4
 #define BUFFER_SIZE 1024
 
+static GConverter *
+compression_get_converter (EvCompressionType type,
+			   gboolean          compress)
+{
+	switch (type) {
+	case EV_COMPRESSION_GZIP:
+		if (compress)
+			return G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+		return G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+#ifdef HAVE_BZLIB
+	case EV_COMPRESSION_BZIP2:
+		if (!compress)
+			return _ev_bzip2_decompressor_new ();
+		return NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+/* Runs the conversion in process through a #GConverter, so that we don't
+ * need to spawn the external command and copy the data through a pipe.
+ */
+static gchar *
+compression_run_converter (const gchar *uri,
+			   GConverter  *converter,
+			   GError     **error)
+{
+	GFile         *file;
+	GFile         *file_dst;
+	GInputStream  *stream;
+	GInputStream  *converter_stream;
+	GOutputStream *out;
+	gchar         *filename_dst = NULL;
+	gchar         *uri_dst = NULL;
+	gint           fd;
+	gssize         n_spliced;
+
+	file = g_file_new_for_uri (uri);
+	stream = G_INPUT_STREAM (g_file_read (file, NULL, error));
+	g_object_unref (file);
+	if (!stream)
+		return NULL;
+
+        fd = ev_mkstemp ("comp.XXXXXX", &filename_dst, error);
+	if (fd == -1) {
+		g_object_unref (stream);
+
+		return NULL;
+	}
+
+	close (fd);
+
+	file_dst = g_file_new_for_path (filename_dst);
+	out = G_OUTPUT_STREAM (g_file_append_to (file_dst, G_FILE_CREATE_NONE, NULL, error));
+	g_object_unref (file_dst);
+	if (!out) {
+		g_object_unref (stream);
+		g_unlink (filename_dst);
+		g_free (filename_dst);
+
+		return NULL;
+	}
+
+	converter_stream = g_converter_input_stream_new (stream, converter);
+	g_object_unref (stream);
+
+	n_spliced = g_output_stream_splice (out, converter_stream,
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+					    NULL, error);
+	g_object_unref (converter_stream);
+	g_object_unref (out);
+
+	if (n_spliced != -1)
+		uri_dst = g_filename_to_uri (filename_dst, NULL, error);
+	if (!uri_dst)
+		g_unlink (filename_dst);
+	g_free (filename_dst);
+
+	return uri_dst;
+}
+
 static gchar *
 compression_run (const gchar       *uri,
 		 EvCompressionType  type,
@@ -600,10 +1060,19 @@ compression_run (const gchar       *uri,
 	gchar *cmd;
 	gint   fd, pout;
 	GError *err = NULL;
+	GConverter *converter;
 
 	if (type == EV_COMPRESSION_NONE)
 		return NULL;
 
+	converter = compression_get_converter (type, compress);
+	if (converter) {
+		uri_dst = compression_run_converter (uri, converter, error);
+		g_object_unref (converter);
+
+		return uri_dst;
+	}
+
 	cmd = g_find_program_in_path (compressor_cmds[type]);
 	if (!cmd) {
 		/* FIXME: better error codes! */
@@ -711,6 +1180,63 @@ ev_file_uncompress (const gchar       *uri,
 	return compression_run (uri, type, FALSE, error);
 }
 
+/**
+ * ev_file_uncompress_stream:
+ * @uri: a file URI
+ * @type: the compression type
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Opens the file at @uri for reading its uncompressed data, without
+ * spawning any external command or writing a temporary file. The data
+ * is uncompressed as it's read from the returned stream, so the type of
+ * a document can be guessed from its first bytes before uncompressing
+ * the whole file. This is meant for backends that can load documents
+ * from a stream.
+ *
+ * If @type can't be uncompressed in process, it returns %NULL and
+ * fills in @error with %G_IO_ERROR_NOT_SUPPORTED, in which case
+ * ev_file_uncompress() should be used instead.
+ *
+ * Returns: (transfer full): a new #GInputStream, or %NULL on error
+ *
+ * Since: 3.10
+ */
+GInputStream *
+ev_file_uncompress_stream (const gchar       *uri,
+			   EvCompressionType  type,
+			   GError           **error)
+{
+	GConverter    *converter;
+	GFile         *file;
+	GInputStream  *stream;
+	GInputStream  *converter_stream;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	converter = compression_get_converter (type, FALSE);
+	if (!converter) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     "In process decompression is not supported for \"%s\" files",
+			     compressor_cmds[type] ? compressor_cmds[type] : "uncompressed");
+		return NULL;
+	}
+
+	file = g_file_new_for_uri (uri);
+	stream = G_INPUT_STREAM (g_file_read (file, NULL, error));
+	g_object_unref (file);
+	if (!stream) {
+		g_object_unref (converter);
+
+		return NULL;
+	}
+
+	converter_stream = g_converter_input_stream_new (stream, converter);
+	g_object_unref (stream);
+	g_object_unref (converter);
+
+	return converter_stream;
+}
+
 /**
  * ev_file_compress:
  * @uri: a file URI
@@ -57,6 +57,12 @@ gboolean     ev_xfer_uri_simple       (const char        *from,
 gboolean     ev_file_copy_metadata    (const char        *from,
                                        const char        *to,
                                        GError           **error);
+gboolean     ev_file_clone            (const char        *from,
+                                       const char        *to,
+                                       GError           **error);
+void         ev_file_set_map_enabled  (gboolean           enabled);
+GBytes      *ev_file_map              (const gchar       *uri,
+                                       GError           **error);
 
 gchar       *ev_file_get_mime_type    (const gchar       *uri,
 				       gboolean           fast,
@@ -65,6 +71,9 @@ gchar       *ev_file_get_mime_type    (const gchar       *uri,
 gchar       *ev_file_uncompress       (const gchar       *uri,
 				       EvCompressionType  type,
 				       GError           **error);
+GInputStream *ev_file_uncompress_stream (const gchar    *uri,
+				       EvCompressionType  type,
+				       GError           **error);
 gchar       *ev_file_compress         (const gchar       *uri,
 				       EvCompressionType  type,
 				       GError           **error);
@@ -28,6 +28,7 @@
 #include "ev-init.h"
 #include "ev-document-factory.h"
 #include "ev-debug.h"
+#include "ev-trace.h"
 #include "ev-file-helpers.h"
 
 static int ev_init_count;
@@ -115,6 +116,7 @@ ev_init (void)
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 
         _ev_debug_init ();
+        _ev_trace_init ();
         _ev_file_helpers_init ();
         have_backends = _ev_document_factory_init ();
 
@@ -141,6 +143,7 @@ ev_shutdown (void)
 
         _ev_document_factory_shutdown ();
         _ev_file_helpers_shutdown ();
+        _ev_trace_shutdown ();
         _ev_debug_shutdown ();
 }
 
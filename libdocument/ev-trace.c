@@ -0,0 +1,254 @@
+/* ev-trace.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "ev-trace.h"
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+/* Enough for a few minutes of scrolling a big document */
+#define TRACE_BUFFER_SIZE 16384
+
+typedef struct {
+	const gchar   *name;
+	const gchar   *category;
+	gconstpointer  id;
+	gint           page;
+	guint          tid;
+	gint64         start;
+	gint64         duration;
+} EvTraceEvent;
+
+static volatile gint trace_enabled = 0;
+static GMutex        trace_mutex;
+static EvTraceEvent *trace_events = NULL;
+static guint         trace_n_events = 0;
+static gchar        *trace_file = NULL;
+
+static GPrivate      trace_tid_key;
+static volatile gint trace_next_tid = 0;
+
+static guint
+ev_trace_get_tid (void)
+{
+	guint tid;
+
+	/* Small sequential ids are easier to read in the viewers
+	 * than thread addresses.
+	 */
+	tid = GPOINTER_TO_UINT (g_private_get (&trace_tid_key));
+	if (tid == 0) {
+		tid = g_atomic_int_add (&trace_next_tid, 1) + 1;
+		g_private_set (&trace_tid_key, GUINT_TO_POINTER (tid));
+	}
+
+	return tid;
+}
+
+void
+_ev_trace_init (void)
+{
+	const gchar *filename;
+
+	filename = g_getenv ("EV_TRACE");
+	if (!filename || *filename == '\0')
+		return;
+
+	trace_file = g_strdup (filename);
+	ev_trace_set_enabled (TRUE);
+}
+
+void
+_ev_trace_shutdown (void)
+{
+	if (trace_file) {
+		GError *error = NULL;
+
+		if (!ev_trace_dump (trace_file, &error)) {
+			g_warning ("Failed to write trace to %s: %s", trace_file, error->message);
+			g_error_free (error);
+		}
+
+		g_free (trace_file);
+		trace_file = NULL;
+	}
+
+	ev_trace_set_enabled (FALSE);
+}
+
+/*
+ * ev_trace_set_enabled:
+ * @enabled: whether spans should be recorded
+ *
+ * Starts or stops recording. Disabling the tracing drops the events
+ * recorded so far.
+ */
+void
+ev_trace_set_enabled (gboolean enabled)
+{
+	g_mutex_lock (&trace_mutex);
+
+	if (enabled && !trace_events) {
+		trace_events = g_new (EvTraceEvent, TRACE_BUFFER_SIZE);
+		trace_n_events = 0;
+	} else if (!enabled && trace_events) {
+		g_free (trace_events);
+		trace_events = NULL;
+		trace_n_events = 0;
+	}
+	g_atomic_int_set (&trace_enabled, enabled != FALSE);
+
+	g_mutex_unlock (&trace_mutex);
+}
+
+gboolean
+ev_trace_is_enabled (void)
+{
+	return g_atomic_int_get (&trace_enabled);
+}
+
+/*
+ * ev_trace_begin:
+ *
+ * Returns: the start time of a span to be passed to ev_trace_end(),
+ * or 0 when tracing is disabled.
+ */
+gint64
+ev_trace_begin (void)
+{
+	if (G_LIKELY (!g_atomic_int_get (&trace_enabled)))
+		return 0;
+
+	return g_get_monotonic_time ();
+}
+
+void
+ev_trace_end (gint64        start,
+	      const gchar  *name,
+	      const gchar  *category,
+	      gconstpointer id,
+	      gint          page)
+{
+	if (G_LIKELY (start == 0))
+		return;
+
+	ev_trace_span (start, g_get_monotonic_time (), name, category, id, page);
+}
+
+/*
+ * ev_trace_span:
+ *
+ * Records a span that was measured by the caller, for intervals that
+ * start and end in different places, like the time a job waits in the
+ * queue. @page is -1 when the span is not about a particular page.
+ */
+void
+ev_trace_span (gint64        start,
+	       gint64        end,
+	       const gchar  *name,
+	       const gchar  *category,
+	       gconstpointer id,
+	       gint          page)
+{
+	EvTraceEvent *event;
+
+	if (G_LIKELY (!g_atomic_int_get (&trace_enabled)) || start == 0)
+		return;
+
+	g_mutex_lock (&trace_mutex);
+
+	if (!trace_events) {
+		g_mutex_unlock (&trace_mutex);
+		return;
+	}
+
+	event = &trace_events[trace_n_events % TRACE_BUFFER_SIZE];
+	event->name = name;
+	event->category = category;
+	event->id = id;
+	event->page = page;
+	event->tid = ev_trace_get_tid ();
+	event->start = start;
+	event->duration = MAX (end - start, 0);
+	trace_n_events++;
+
+	g_mutex_unlock (&trace_mutex);
+}
+
+/*
+ * ev_trace_dump:
+ * @filename: the file to write
+ * @error: a location for a #GError, or %NULL
+ *
+ * Writes the events currently in the ring buffer to @filename as a
+ * Chrome trace JSON document. Recording goes on while the file is
+ * being written.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+ev_trace_dump (const gchar *filename,
+	       GError     **error)
+{
+	EvTraceEvent *events;
+	GString      *json;
+	guint         n_events, first, i;
+	gint          pid = 0;
+	gboolean      retval;
+
+	g_mutex_lock (&trace_mutex);
+
+	n_events = MIN (trace_n_events, TRACE_BUFFER_SIZE);
+	first = trace_n_events > TRACE_BUFFER_SIZE ? trace_n_events % TRACE_BUFFER_SIZE : 0;
+	events = g_new (EvTraceEvent, MAX (n_events, 1));
+	for (i = 0; i < n_events; i++)
+		events[i] = trace_events[(first + i) % TRACE_BUFFER_SIZE];
+
+	g_mutex_unlock (&trace_mutex);
+
+#ifdef G_OS_UNIX
+	pid = getpid ();
+#endif
+
+	json = g_string_new ("{\"traceEvents\":[\n");
+	for (i = 0; i < n_events; i++) {
+		EvTraceEvent *event = &events[i];
+
+		g_string_append_printf (json,
+					"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+					"\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+					"\"pid\":%d,\"tid\":%u,\"args\":{\"id\":\"%p\"",
+					event->name,
+					event->category ? event->category : "evince",
+					event->start, event->duration,
+					pid, event->tid, event->id);
+		if (event->page >= 0)
+			g_string_append_printf (json, ",\"page\":%d", event->page);
+		g_string_append (json, i + 1 < n_events ? "}},\n" : "}}\n");
+	}
+	g_string_append (json, "],\"displayTimeUnit\":\"ms\"}\n");
+	g_free (events);
+
+	retval = g_file_set_contents (filename, json->str, json->len, error);
+	g_string_free (json, TRUE);
+
+	return retval;
+}
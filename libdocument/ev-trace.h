@@ -0,0 +1,64 @@
+/* ev-trace.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef __EV_TRACE_H__
+#define __EV_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Unlike ev-debug, tracing is always compiled in. When it's enabled, spans
+ * are recorded into a fixed size ring buffer that can be written out in
+ * the Chrome trace event format (chrome://tracing, Perfetto). Set EV_TRACE
+ * to a file name to enable it on startup and dump the trace on shutdown.
+ *
+ * Names and categories are not copied, they must be static strings
+ * (interned type names are fine).
+ */
+
+void     _ev_trace_init       (void);
+void     _ev_trace_shutdown   (void);
+
+void     ev_trace_set_enabled (gboolean      enabled);
+gboolean ev_trace_is_enabled  (void);
+
+gint64   ev_trace_begin       (void);
+void     ev_trace_end         (gint64        start,
+			       const gchar  *name,
+			       const gchar  *category,
+			       gconstpointer id,
+			       gint          page);
+void     ev_trace_span        (gint64        start,
+			       gint64        end,
+			       const gchar  *name,
+			       const gchar  *category,
+			       gconstpointer id,
+			       gint          page);
+
+gboolean ev_trace_dump        (const gchar  *filename,
+			       GError      **error);
+
+G_END_DECLS
+
+#endif /* __EV_TRACE_H__ */
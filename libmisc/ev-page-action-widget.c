@@ -31,6 +31,7 @@
 /* Widget we pass back */
 static void  ev_page_action_widget_init       (EvPageActionWidget      *action_widget);
 static void  ev_page_action_widget_class_init (EvPageActionWidgetClass *action_widget);
+static void  ev_page_action_widget_setup_completion (EvPageActionWidget *proxy);
 
 enum
 {
@@ -48,6 +49,7 @@ struct _EvPageActionWidget
 	GtkWidget *entry;
 	GtkWidget *label;
 	guint signal_id;
+	guint complete_label_idle_id;
 	GtkTreeModel *filter_model;
 	GtkTreeModel *model;
 };
@@ -193,6 +195,60 @@ activate_cb (EvPageActionWidget *action_widget)
 		ev_page_action_widget_set_current_page (action_widget, current_page);
 }
 
+static gboolean
+complete_label_idle_cb (EvPageActionWidget *action_widget)
+{
+	GtkEditable *editable = GTK_EDITABLE (action_widget->entry);
+	const gchar *text;
+	gchar      **labels;
+	gint         n_chars;
+
+	action_widget->complete_label_idle_id = 0;
+
+	if (!action_widget->document ||
+	    !ev_document_has_text_page_labels (action_widget->document))
+		return FALSE;
+
+	text = gtk_entry_get_text (GTK_ENTRY (action_widget->entry));
+	n_chars = g_utf8_strlen (text, -1);
+	if (n_chars == 0 || gtk_editable_get_position (editable) != n_chars)
+		return FALSE;
+
+	labels = ev_document_complete_page_label (action_widget->document, text, 1);
+	if (!labels)
+		return FALSE;
+
+	/* Select the added text, so that typing on replaces it */
+	if (g_utf8_strlen (labels[0], -1) > n_chars) {
+		gtk_entry_set_text (GTK_ENTRY (action_widget->entry), labels[0]);
+		gtk_editable_select_region (editable, n_chars, -1);
+	}
+	g_strfreev (labels);
+
+	return FALSE;
+}
+
+static void
+entry_insert_text_cb (EvPageActionWidget *action_widget)
+{
+	/* Complete the page label once the text has been inserted,
+	 * only while typing and not when deleting text.
+	 */
+	if (action_widget->complete_label_idle_id == 0)
+		action_widget->complete_label_idle_id =
+			g_idle_add ((GSourceFunc)complete_label_idle_cb, action_widget);
+}
+
+static gboolean
+focus_in_cb (EvPageActionWidget *action_widget)
+{
+	if (action_widget->model &&
+	    !gtk_entry_get_completion (GTK_ENTRY (action_widget->entry)))
+		ev_page_action_widget_setup_completion (action_widget);
+
+	return FALSE;
+}
+
 static gboolean
 focus_out_cb (EvPageActionWidget *action_widget)
 {
@@ -225,9 +281,15 @@ ev_page_action_widget_init (EvPageActionWidget *action_widget)
 	g_signal_connect_swapped (action_widget->entry, "activate",
 				  G_CALLBACK (activate_cb),
 				  action_widget);
+        g_signal_connect_swapped (action_widget->entry, "focus-in-event",
+                                  G_CALLBACK (focus_in_cb),
+                                  action_widget);
         g_signal_connect_swapped (action_widget->entry, "focus-out-event",
                                   G_CALLBACK (focus_out_cb),
                                   action_widget);
+	g_signal_connect_swapped (action_widget->entry, "insert-text",
+				  G_CALLBACK (entry_insert_text_cb),
+				  action_widget);
 
 	obj = gtk_widget_get_accessible (action_widget->entry);
 	atk_object_set_name (obj, "page-label-entry");
@@ -299,6 +361,11 @@ ev_page_action_widget_finalize (GObject *object)
 {
 	EvPageActionWidget *action_widget = EV_PAGE_ACTION_WIDGET (object);
 
+	if (action_widget->complete_label_idle_id > 0) {
+		g_source_remove (action_widget->complete_label_idle_id);
+		action_widget->complete_label_idle_id = 0;
+	}
+
 	if (action_widget->doc_model != NULL) {
 		if (action_widget->signal_id > 0) {
 			g_signal_handler_disconnect (action_widget->doc_model,
@@ -485,7 +552,8 @@ build_new_tree_cb (GtkTreeModel *model,
 }
 
 static GtkTreeModel *
-get_filter_model_from_model (GtkTreeModel *model)
+get_filter_model_from_model (EvDocument   *document,
+			     GtkTreeModel *model)
 {
 	GtkTreeModel *filter_model;
 
@@ -494,9 +562,16 @@ get_filter_model_from_model (GtkTreeModel *model)
 	if (filter_model == NULL) {
 		filter_model = (GtkTreeModel *) gtk_list_store_new (1, GTK_TYPE_TREE_ITER);
 
-		gtk_tree_model_foreach (model,
-					build_new_tree_cb,
-					filter_model);
+		/* Outline nodes not expanded yet are built on the way */
+		if (EV_IS_DOCUMENT_LINKS (document))
+			ev_document_links_foreach_link (EV_DOCUMENT_LINKS (document),
+							model,
+							build_new_tree_cb,
+							filter_model);
+		else
+			gtk_tree_model_foreach (model,
+						build_new_tree_cb,
+						filter_model);
 		g_object_set_data_full (G_OBJECT (model), EPA_FILTER_MODEL_DATA, filter_model, g_object_unref);
 	}
 
@@ -507,16 +582,29 @@ get_filter_model_from_model (GtkTreeModel *model)
 void
 ev_page_action_widget_update_links_model (EvPageActionWidget *proxy, GtkTreeModel *model)
 {
-	GtkTreeModel *filter_model;
-	GtkEntryCompletion *completion;
-	GtkCellRenderer *renderer;
-
 	if (!model)
 		return;
 
 	/* Magik */
 	proxy->model = model;
-	filter_model = get_filter_model_from_model (model);
+
+	/* The completion needs the whole outline, so unless it's
+	 * already built, wait until the entry is used.
+	 */
+	if (g_object_get_data (G_OBJECT (model), EPA_FILTER_MODEL_DATA))
+		ev_page_action_widget_setup_completion (proxy);
+	else
+		gtk_entry_set_completion (GTK_ENTRY (proxy->entry), NULL);
+}
+
+static void
+ev_page_action_widget_setup_completion (EvPageActionWidget *proxy)
+{
+	GtkTreeModel *filter_model;
+	GtkEntryCompletion *completion;
+	GtkCellRenderer *renderer;
+
+	filter_model = get_filter_model_from_model (proxy->document, proxy->model);
 
 	completion = gtk_entry_completion_new ();
 	g_object_set (G_OBJECT (completion),
@@ -19,22 +19,32 @@
  */
 
 #include "ev-debug.h"
+#include "ev-trace.h"
 #include "ev-job-scheduler.h"
 
 typedef struct _EvSchedulerJob {
 	EvJob         *job;
 	EvJobPriority  priority;
-	GSList        *job_link;
+	gint64         queued_time;
+
+	/* Node of the job in job_queue[priority], so that
+	 * it's moved or removed without looking it up */
+	GList          queue_link;
+	gboolean       queued;
+
+	/* Identifies the jobs producing the same result,
+	 * NULL when the result can't be shared */
+	gchar         *key;
+	/* The equivalent job this one is waiting for */
+	EvJob         *primary;
 } EvSchedulerJob;
 
-G_LOCK_DEFINE_STATIC(job_list);
-static GSList *job_list = NULL;
-
 static volatile EvJob *running_job = NULL;
 
 static gpointer ev_job_thread_proxy               (gpointer        data);
 static void     ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 						   GCancellable   *cancellable);
+static void     ev_scheduler_job_destroy          (EvSchedulerJob *job);
 
 /* EvJobQueue */
 static GQueue queue_urgent = G_QUEUE_INIT;
@@ -51,6 +61,21 @@ static GQueue *job_queue[EV_JOB_N_PRIORITIES] = {
 	&queue_none
 };
 
+/* Jobs queued or running by key, and the jobs waiting for
+ * the result of each of them. Protected by job_queue_mutex.
+ */
+static GHashTable *pending_jobs = NULL;
+static GHashTable *job_followers = NULL;
+
+static void
+ev_job_queue_push_unlocked (EvSchedulerJob *job)
+{
+	job->queue_link.data = job;
+	g_queue_push_tail_link (job_queue[job->priority], &job->queue_link);
+	job->queued = TRUE;
+	g_cond_broadcast (&job_queue_cond);
+}
+
 static void
 ev_job_queue_push (EvSchedulerJob *job,
 		   EvJobPriority   priority)
@@ -59,12 +84,37 @@ ev_job_queue_push (EvSchedulerJob *job,
 	
 	g_mutex_lock (&job_queue_mutex);
 
-	g_queue_push_tail (job_queue[priority], job);
-	g_cond_broadcast (&job_queue_cond);
+	job->priority = priority;
+	ev_job_queue_push_unlocked (job);
 	
 	g_mutex_unlock (&job_queue_mutex);
 }
 
+static void
+ev_job_queue_remove_unlocked (EvSchedulerJob *job)
+{
+	g_queue_unlink (job_queue[job->priority], &job->queue_link);
+	job->queued = FALSE;
+}
+
+static void
+ev_job_queue_move_unlocked (EvSchedulerJob *job,
+			    EvJobPriority   priority)
+{
+	if (job->priority == priority)
+		return;
+
+	if (job->queued) {
+		ev_debug_message (DEBUG_JOBS, "Moving job %s from pirority %d to %d",
+				  EV_GET_TYPE_NAME (job->job), job->priority, priority);
+		ev_job_queue_remove_unlocked (job);
+		job->priority = priority;
+		ev_job_queue_push_unlocked (job);
+	} else {
+		job->priority = priority;
+	}
+}
+
 static EvSchedulerJob *
 ev_job_queue_get_next_unlocked (void)
 {
@@ -72,9 +122,13 @@ ev_job_queue_get_next_unlocked (void)
 	EvSchedulerJob *job = NULL;
 	
 	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES; i++) {
-		job = (EvSchedulerJob *) g_queue_pop_head (job_queue[i]);
-		if (job)
+		GList *link = g_queue_pop_head_link (job_queue[i]);
+
+		if (link) {
+			job = (EvSchedulerJob *) link->data;
+			job->queued = FALSE;
 			break;
+		}
 	}
 
 	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs in queue");
@@ -82,37 +136,334 @@ ev_job_queue_get_next_unlocked (void)
 	return job;
 }
 
+static gchar *
+ev_scheduler_job_get_key (EvJob *job)
+{
+	/* The size of the target is not part of the key,
+	 * it's only used to check the rendered surface
+	 */
+	if (EV_IS_JOB_RENDER (job)) {
+		EvJobRender *job_render = EV_JOB_RENDER (job);
+
+		/* Selections and damaged areas belong to a view */
+		if (job_render->include_selection || job_render->damage)
+			return NULL;
+
+		return g_strdup_printf ("render %p %d %d %.17g",
+					job->document,
+					job_render->page,
+					job_render->rotation,
+					job_render->scale);
+	} else if (EV_IS_JOB_THUMBNAIL (job)) {
+		EvJobThumbnail *job_thumb = EV_JOB_THUMBNAIL (job);
+
+		return g_strdup_printf ("thumbnail %p %d %d %.17g %d",
+					job->document,
+					job_thumb->page,
+					job_thumb->rotation,
+					job_thumb->scale,
+					job_thumb->has_frame);
+	} else if (EV_IS_JOB_PAGE_DATA (job)) {
+		EvJobPageData *job_pd = EV_JOB_PAGE_DATA (job);
+
+		return g_strdup_printf ("page-data %p %d %d",
+					job->document,
+					job_pd->page,
+					job_pd->flags);
+	}
+
+	return NULL;
+}
+
+static cairo_surface_t *
+ev_scheduler_copy_surface (cairo_surface_t *surface)
+{
+	cairo_surface_t *copy;
+	cairo_t         *cr;
+
+	copy = cairo_image_surface_create (cairo_image_surface_get_format (surface),
+					   cairo_image_surface_get_width (surface),
+					   cairo_image_surface_get_height (surface));
+	cr = cairo_create (copy);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface (cr, surface, 0, 0);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	return copy;
+}
+
+/* Called before the handlers of @source are run, which take
+ * the results of the job for themselves or modify them.
+ */
+static void
+ev_scheduler_job_copy_result (EvJob *job,
+			      EvJob *source)
+{
+	if (EV_IS_JOB_RENDER (job)) {
+		EvJobRender *job_render = EV_JOB_RENDER (job);
+		EvJobRender *source_render = EV_JOB_RENDER (source);
+
+		/* Views invert the colors of the surface in place */
+		if (source_render->surface)
+			job_render->surface = ev_scheduler_copy_surface (source_render->surface);
+		job_render->render_time = source_render->render_time;
+	} else if (EV_IS_JOB_THUMBNAIL (job)) {
+		EvJobThumbnail *job_thumb = EV_JOB_THUMBNAIL (job);
+		EvJobThumbnail *source_thumb = EV_JOB_THUMBNAIL (source);
+
+		if (source_thumb->thumbnail)
+			job_thumb->thumbnail = gdk_pixbuf_copy (source_thumb->thumbnail);
+	} else if (EV_IS_JOB_PAGE_DATA (job)) {
+		EvJobPageData *job_pd = EV_JOB_PAGE_DATA (job);
+		EvJobPageData *source_pd = EV_JOB_PAGE_DATA (source);
+
+		if (source_pd->link_mapping)
+			job_pd->link_mapping = ev_mapping_list_ref (source_pd->link_mapping);
+		if (source_pd->image_mapping)
+			job_pd->image_mapping = ev_mapping_list_ref (source_pd->image_mapping);
+		if (source_pd->form_field_mapping)
+			job_pd->form_field_mapping = ev_mapping_list_ref (source_pd->form_field_mapping);
+		if (source_pd->annot_mapping)
+			job_pd->annot_mapping = ev_mapping_list_ref (source_pd->annot_mapping);
+		if (source_pd->text_mapping)
+			job_pd->text_mapping = cairo_region_copy (source_pd->text_mapping);
+		job_pd->text = g_strdup (source_pd->text);
+		if (source_pd->text_layout) {
+			job_pd->text_layout = g_memdup (source_pd->text_layout,
+							sizeof (EvRectangle) * source_pd->text_layout_length);
+			job_pd->text_layout_length = source_pd->text_layout_length;
+		}
+		if (source_pd->text_attrs)
+			job_pd->text_attrs = pango_attr_list_copy (source_pd->text_attrs);
+		if (source_pd->text_log_attrs) {
+			job_pd->text_log_attrs = g_memdup (source_pd->text_log_attrs,
+							   sizeof (PangoLogAttr) * (source_pd->text_log_attrs_length + 1));
+			job_pd->text_log_attrs_length = source_pd->text_log_attrs_length;
+		}
+	}
+}
+
+static GSList *
+ev_scheduler_job_steal_followers_unlocked (EvJob *job)
+{
+	GSList *followers;
+
+	followers = g_hash_table_lookup (job_followers, job);
+	if (followers)
+		g_hash_table_remove (job_followers, job);
+
+	return followers;
+}
+
+static void
+ev_scheduler_job_add_followers_unlocked (EvSchedulerJob *primary,
+					 GSList         *followers)
+{
+	EvJobPriority priority = primary->priority;
+	GSList       *l;
+
+	for (l = followers; l; l = g_slist_next (l)) {
+		EvSchedulerJob *job = (EvSchedulerJob *)l->data;
+
+		if (job->primary)
+			g_object_unref (job->primary);
+		job->primary = g_object_ref (primary->job);
+		priority = MIN (priority, job->priority);
+	}
+
+	followers = g_slist_concat (followers, g_hash_table_lookup (job_followers, primary->job));
+	g_hash_table_insert (job_followers, primary->job, followers);
+
+	/* The job runs as soon as any of the jobs waiting for it would */
+	ev_job_queue_move_unlocked (primary, priority);
+}
+
+static void
+ev_scheduler_job_remove_follower_unlocked (EvSchedulerJob *job)
+{
+	GSList *followers;
+
+	followers = g_hash_table_lookup (job_followers, job->primary);
+	followers = g_slist_remove (followers, job);
+	if (followers)
+		g_hash_table_insert (job_followers, job->primary, followers);
+	else
+		g_hash_table_remove (job_followers, job->primary);
+
+	g_object_unref (job->primary);
+	job->primary = NULL;
+}
+
+static void
+ev_scheduler_job_remove_pending_unlocked (EvSchedulerJob *job)
+{
+	if (job->key && g_hash_table_lookup (pending_jobs, job->key) == job)
+		g_hash_table_remove (pending_jobs, job->key);
+}
+
+static gboolean
+ev_scheduler_job_is_pending (EvSchedulerJob *job)
+{
+	/* Jobs finished or cancelled don't take followers anymore,
+	 * they would never be notified
+	 */
+	return !job->job->finished && !g_cancellable_is_cancelled (job->job->cancellable);
+}
+
+/* Makes @job wait for the result of an equivalent job queued or
+ * running, returns FALSE when @job has to run itself.
+ */
+static gboolean
+ev_scheduler_job_follow (EvSchedulerJob *job)
+{
+	EvSchedulerJob *primary;
+
+	if (!job->key)
+		return FALSE;
+
+	g_mutex_lock (&job_queue_mutex);
+
+	primary = g_hash_table_lookup (pending_jobs, job->key);
+	if (!primary || !ev_scheduler_job_is_pending (primary)) {
+		g_hash_table_replace (pending_jobs, job->key, job);
+		g_mutex_unlock (&job_queue_mutex);
+
+		return FALSE;
+	}
+
+	ev_debug_message (DEBUG_JOBS, "%s (%p) waits for %p",
+			  EV_GET_TYPE_NAME (job->job), job->job, primary->job);
+	ev_scheduler_job_add_followers_unlocked (primary, g_slist_prepend (NULL, job));
+
+	g_mutex_unlock (&job_queue_mutex);
+
+	return TRUE;
+}
+
+static gboolean
+ev_scheduler_job_finished_hook (GSignalInvocationHint *ihint,
+				guint                  n_param_values,
+				const GValue          *param_values,
+				gpointer               data)
+{
+	EvJob  *job = g_value_get_object (&param_values[0]);
+	GSList *followers, *l;
+
+	g_mutex_lock (&job_queue_mutex);
+	followers = ev_scheduler_job_steal_followers_unlocked (job);
+	g_mutex_unlock (&job_queue_mutex);
+
+	for (l = followers; l; l = g_slist_next (l)) {
+		EvSchedulerJob *follower = (EvSchedulerJob *)l->data;
+
+		if (!g_cancellable_is_cancelled (follower->job->cancellable)) {
+			if (job->failed) {
+				ev_job_failed_from_error (follower->job, job->error);
+			} else {
+				ev_scheduler_job_copy_result (follower->job, job);
+				ev_job_succeeded (follower->job);
+			}
+		}
+		ev_scheduler_job_destroy (follower);
+	}
+	g_slist_free (followers);
+
+	return TRUE;
+}
+
+static gboolean
+ev_scheduler_job_cancelled_hook (GSignalInvocationHint *ihint,
+				 guint                  n_param_values,
+				 const GValue          *param_values,
+				 gpointer               data)
+{
+	EvJob          *job = g_value_get_object (&param_values[0]);
+	EvSchedulerJob *primary;
+	GSList         *followers;
+
+	g_mutex_lock (&job_queue_mutex);
+
+	followers = ev_scheduler_job_steal_followers_unlocked (job);
+	if (!followers) {
+		g_mutex_unlock (&job_queue_mutex);
+
+		return TRUE;
+	}
+
+	/* The jobs waiting for the cancelled one still need the result,
+	 * they wait for another equivalent job or the first of them runs
+	 */
+	primary = g_hash_table_lookup (pending_jobs,
+				       ((EvSchedulerJob *)followers->data)->key);
+	if (!primary || primary->job == job || !ev_scheduler_job_is_pending (primary)) {
+		primary = (EvSchedulerJob *)followers->data;
+		followers = g_slist_delete_link (followers, followers);
+
+		g_object_unref (primary->primary);
+		primary->primary = NULL;
+		g_hash_table_replace (pending_jobs, primary->key, primary);
+		ev_job_queue_push_unlocked (primary);
+	}
+
+	if (followers)
+		ev_scheduler_job_add_followers_unlocked (primary, followers);
+
+	g_mutex_unlock (&job_queue_mutex);
+
+	return TRUE;
+}
+
 static gpointer
 ev_job_scheduler_init (gpointer data)
 {
+	pending_jobs = g_hash_table_new (g_str_hash, g_str_equal);
+	job_followers = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	g_signal_add_emission_hook (g_signal_lookup ("finished", EV_TYPE_JOB), 0,
+				    ev_scheduler_job_finished_hook, NULL, NULL);
+	g_signal_add_emission_hook (g_signal_lookup ("cancelled", EV_TYPE_JOB), 0,
+				    ev_scheduler_job_cancelled_hook, NULL, NULL);
+
 	g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL);
 
 	return NULL;
 }
 
-static void
-ev_scheduler_job_list_add (EvSchedulerJob *job)
+static GQuark
+ev_scheduler_job_quark (void)
 {
-	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
-	
-	G_LOCK (job_list);
+	static GQuark q = 0;
 
-	job_list = g_slist_prepend (job_list, job);
-	job->job_link = job_list;
-	
-	G_UNLOCK (job_list);
+	if (G_UNLIKELY (q == 0))
+		q = g_quark_from_static_string ("ev-scheduler-job");
+
+	return q;
 }
 
+/* The scheduler job of an EvJob is found through its qdata,
+ * set and cleared with job_queue_mutex held so that it's not
+ * destroyed while it's being updated
+ */
 static void
-ev_scheduler_job_list_remove (EvSchedulerJob *job)
+ev_scheduler_job_register (EvSchedulerJob *job)
 {
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 	
-	G_LOCK (job_list);
+	g_mutex_lock (&job_queue_mutex);
+	g_object_set_qdata (G_OBJECT (job->job), ev_scheduler_job_quark (), job);
+	g_mutex_unlock (&job_queue_mutex);
+}
 
-	job_list = g_slist_delete_link (job_list, job->job_link);
+static void
+ev_scheduler_job_unregister (EvSchedulerJob *job)
+{
+	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 	
-	G_UNLOCK (job_list);
+	g_mutex_lock (&job_queue_mutex);
+	if (g_object_get_qdata (G_OBJECT (job->job), ev_scheduler_job_quark ()) == job)
+		g_object_set_qdata (G_OBJECT (job->job), ev_scheduler_job_quark (), NULL);
+	g_mutex_unlock (&job_queue_mutex);
 }
 
 static void
@@ -122,6 +473,9 @@ ev_scheduler_job_free (EvSchedulerJob *job)
 		return;
 
 	g_object_unref (job->job);
+	if (job->primary)
+		g_object_unref (job->primary);
+	g_free (job->key);
 	g_free (job);
 }
 
@@ -140,7 +494,7 @@ ev_scheduler_job_destroy (EvSchedulerJob *job)
 						      job);
 	}
 	
-	ev_scheduler_job_list_remove (job);
+	ev_scheduler_job_unregister (job);
 	ev_scheduler_job_free (job);
 }
 
@@ -148,20 +502,27 @@ static void
 ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 				   GCancellable   *cancellable)
 {
-	GList   *list;
-	
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 
 	g_mutex_lock (&job_queue_mutex);
 
+	/* A job waiting for an equivalent one just stops waiting */
+	if (job->primary) {
+		ev_scheduler_job_remove_follower_unlocked (job);
+		g_mutex_unlock (&job_queue_mutex);
+		ev_scheduler_job_destroy (job);
+
+		return;
+	}
+
 	/* If the job is not still running,
 	 * remove it from the job queue and job list.
 	 * If the job is currently running, it will be
 	 * destroyed as soon as it finishes. 
 	 */
-	list = g_queue_find (job_queue[job->priority], job);
-	if (list) {
-		g_queue_delete_link (job_queue[job->priority], list);
+	if (job->queued) {
+		ev_job_queue_remove_unlocked (job);
+		ev_scheduler_job_remove_pending_unlocked (job);
 		g_mutex_unlock (&job_queue_mutex);
 		ev_scheduler_job_destroy (job);
 	} else {
@@ -169,6 +530,19 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	}
 }
 
+static gboolean
+ev_job_run_traced (EvJob *job)
+{
+	gboolean result;
+	gint64   start;
+
+	start = ev_trace_begin ();
+	result = ev_job_run (job);
+	ev_trace_end (start, "run", EV_GET_TYPE_NAME (job), job, -1);
+
+	return result;
+}
+
 static void
 ev_job_thread (EvJob *job)
 {
@@ -181,7 +555,7 @@ ev_job_thread (EvJob *job)
 			result = FALSE;
 		else {
                         g_atomic_pointer_set (&running_job, job);
-			result = ev_job_run (job);
+			result = ev_job_run_traced (job);
                 }
 	} while (result);
 
@@ -196,7 +570,7 @@ ev_job_idle (EvJob *job)
 	if (g_cancellable_is_cancelled (job->cancellable))
 		return FALSE;
 
-	return ev_job_run (job);
+	return ev_job_run_traced (job);
 }
 
 static gpointer
@@ -213,8 +587,14 @@ ev_job_thread_proxy (gpointer data)
 			continue;
 		}
 		g_mutex_unlock (&job_queue_mutex);
-		
+
+		ev_trace_end (job->queued_time, "queued", EV_GET_TYPE_NAME (job->job), job->job, -1);
 		ev_job_thread (job->job);
+
+		g_mutex_lock (&job_queue_mutex);
+		ev_scheduler_job_remove_pending_unlocked (job);
+		g_mutex_unlock (&job_queue_mutex);
+
 		ev_scheduler_job_destroy (job);
 	}
 
@@ -235,15 +615,18 @@ ev_job_scheduler_push_job (EvJob         *job,
 	s_job = g_new0 (EvSchedulerJob, 1);
 	s_job->job = g_object_ref (job);
 	s_job->priority = priority;
+	s_job->queued_time = ev_trace_begin ();
 
-	ev_scheduler_job_list_add (s_job);
+	ev_scheduler_job_register (s_job);
 	
 	switch (ev_job_get_run_mode (job)) {
 	case EV_JOB_RUN_THREAD:
+		s_job->key = ev_scheduler_job_get_key (job);
 		g_signal_connect_swapped (job->cancellable, "cancelled",
 					  G_CALLBACK (ev_scheduler_thread_job_cancelled),
 					  s_job);
-		ev_job_queue_push (s_job, priority);
+		if (!ev_scheduler_job_follow (s_job))
+			ev_job_queue_push (s_job, priority);
 		break;
 	case EV_JOB_RUN_MAIN_LOOP:
 		g_signal_connect_swapped (job, "finished",
@@ -267,8 +650,7 @@ ev_job_scheduler_update_job (EvJob         *job,
 			     EvJobPriority  priority)
 {
 	GSList         *l;
-	EvSchedulerJob *s_job = NULL;
-	gboolean        need_resort = FALSE;
+	EvSchedulerJob *s_job;
 
 	/* Main loop jobs are scheduled inmediately */
 	if (ev_job_get_run_mode (job) == EV_JOB_RUN_MAIN_LOOP)
@@ -276,35 +658,31 @@ ev_job_scheduler_update_job (EvJob         *job,
 
 	ev_debug_message (DEBUG_JOBS, "%s pirority %d", EV_GET_TYPE_NAME (job), priority);
 	
-	G_LOCK (job_list);
-
-	for (l = job_list; l; l = l->next) {
-		s_job = (EvSchedulerJob *)l->data;
+	g_mutex_lock (&job_queue_mutex);
 
-		if (s_job->job == job) {
-			need_resort = (s_job->priority != priority);
-			break;
-		}
+	s_job = g_object_get_qdata (G_OBJECT (job), ev_scheduler_job_quark ());
+	if (!s_job) {
+		g_mutex_unlock (&job_queue_mutex);
+		return;
 	}
-	
-	G_UNLOCK (job_list);
 
-	if (need_resort) {
-		GList *list;
-	
-		g_mutex_lock (&job_queue_mutex);
-		
-		list = g_queue_find (job_queue[s_job->priority], s_job);
-		if (list) {
-			ev_debug_message (DEBUG_JOBS, "Moving job %s from pirority %d to %d",
-					  EV_GET_TYPE_NAME (job), s_job->priority, priority);
-			g_queue_delete_link (job_queue[s_job->priority], list);
-			g_queue_push_tail (job_queue[priority], s_job);
-			g_cond_broadcast (&job_queue_cond);
-		}
-		
-		g_mutex_unlock (&job_queue_mutex);
+	if (s_job->primary) {
+		EvSchedulerJob *primary;
+
+		/* The equivalent job runs with the highest
+		 * priority of the jobs waiting for it
+		 */
+		s_job->priority = priority;
+		primary = g_hash_table_lookup (pending_jobs, s_job->key);
+		if (primary && primary->job == s_job->primary && priority < primary->priority)
+			ev_job_queue_move_unlocked (primary, priority);
+	} else {
+		for (l = g_hash_table_lookup (job_followers, job); l; l = g_slist_next (l))
+			priority = MIN (priority, ((EvSchedulerJob *)l->data)->priority);
+		ev_job_queue_move_unlocked (s_job, priority);
 	}
+
+	g_mutex_unlock (&job_queue_mutex);
 }
 
 /**
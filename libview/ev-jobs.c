@@ -37,6 +37,8 @@
 #include "ev-document-attachments.h"
 #include "ev-document-text.h"
 #include "ev-debug.h"
+#include "ev-render-cost.h"
+#include "ev-trace.h"
 
 #include <errno.h>
 #include <glib/gstdio.h>
@@ -47,6 +49,8 @@ static void ev_job_init                   (EvJob                 *job);
 static void ev_job_class_init             (EvJobClass            *class);
 static void ev_job_links_init             (EvJobLinks            *job);
 static void ev_job_links_class_init       (EvJobLinksClass       *class);
+static void ev_job_link_labels_init       (EvJobLinkLabels       *job);
+static void ev_job_link_labels_class_init (EvJobLinkLabelsClass  *class);
 static void ev_job_attachments_init       (EvJobAttachments      *job);
 static void ev_job_attachments_class_init (EvJobAttachmentsClass *class);
 static void ev_job_annots_init            (EvJobAnnots           *job);
@@ -86,12 +90,22 @@ enum {
 	FIND_LAST_SIGNAL
 };
 
+enum {
+	ANNOTS_UPDATED,
+	ANNOTS_LAST_SIGNAL
+};
+
 static guint job_signals[LAST_SIGNAL] = { 0 };
 static guint job_fonts_signals[FONTS_LAST_SIGNAL] = { 0 };
 static guint job_find_signals[FIND_LAST_SIGNAL] = { 0 };
+static guint job_annots_signals[ANNOTS_LAST_SIGNAL] = { 0 };
+
+/* Time in microseconds EvJobAnnots holds the document on every run */
+#define ANNOTS_SCAN_TIME_SLICE 10000
 
 G_DEFINE_ABSTRACT_TYPE (EvJob, ev_job, G_TYPE_OBJECT)
 G_DEFINE_TYPE (EvJobLinks, ev_job_links, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobLinkLabels, ev_job_link_labels, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobAttachments, ev_job_attachments, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobAnnots, ev_job_annots, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobRender, ev_job_render, EV_TYPE_JOB)
@@ -166,18 +180,48 @@ ev_job_class_init (EvJobClass *class)
 			      G_TYPE_NONE, 0);
 }
 
+static GQuark
+ev_job_trace_quark (void)
+{
+	static GQuark q = 0;
+
+	if (G_UNLIKELY (q == 0))
+		q = g_quark_from_static_string ("ev-job-trace-finished-time");
+
+	return q;
+}
+
+static void
+emit_finished_signal (EvJob *job)
+{
+	gint64 start;
+
+	start = ev_trace_begin ();
+	g_signal_emit (job, job_signals[FINISHED], 0);
+	ev_trace_end (start, "finished", EV_GET_TYPE_NAME (job), job, -1);
+}
+
 static gboolean
 emit_finished (EvJob *job)
 {
+	gint64 *finished_time;
+
 	ev_debug_message (DEBUG_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
 	job->idle_finished_id = 0;
-	
+
+	/* Time spent waiting for the main loop to pick up the result */
+	finished_time = g_object_get_qdata (G_OBJECT (job), ev_job_trace_quark ());
+	if (finished_time) {
+		ev_trace_end (*finished_time, "dispatch", EV_GET_TYPE_NAME (job), job, -1);
+		g_object_set_qdata (G_OBJECT (job), ev_job_trace_quark (), NULL);
+	}
+
 	if (job->cancelled) {
 		ev_debug_message (DEBUG_JOBS, "%s (%p) job was cancelled, do not emit finished", EV_GET_TYPE_NAME (job), job);
 	} else {
 		ev_profiler_stop (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
-		g_signal_emit (job, job_signals[FINISHED], 0);
+		emit_finished_signal (job);
 	}
 	
 	return FALSE;
@@ -196,6 +240,13 @@ ev_job_emit_finished (EvJob *job)
 	job->finished = TRUE;
 	
 	if (job->run_mode == EV_JOB_RUN_THREAD) {
+		if (ev_trace_is_enabled ()) {
+			gint64 *finished_time = g_new (gint64, 1);
+
+			*finished_time = ev_trace_begin ();
+			g_object_set_qdata_full (G_OBJECT (job), ev_job_trace_quark (),
+						 finished_time, g_free);
+		}
 		job->idle_finished_id =
 			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
 					 (GSourceFunc)emit_finished,
@@ -203,7 +254,7 @@ ev_job_emit_finished (EvJob *job)
 					 (GDestroyNotify)g_object_unref);
 	} else {
 		ev_profiler_stop (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
-		g_signal_emit (job, job_signals[FINISHED], 0);
+		emit_finished_signal (job);
 	}
 }
 
@@ -344,38 +395,6 @@ ev_job_links_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_links_parent_class)->dispose) (object);
 }
 
-static gboolean
-fill_page_labels (GtkTreeModel   *tree_model,
-		  GtkTreePath    *path,
-		  GtkTreeIter    *iter,
-		  EvJob          *job)
-{
-	EvDocumentLinks *document_links;
-	EvLink          *link;
-	gchar           *page_label;
-
-	gtk_tree_model_get (tree_model, iter,
-			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
-			    -1);
-
-	if (!link)
-		return FALSE;
-
-	document_links = EV_DOCUMENT_LINKS (job->document);
-	page_label = ev_document_links_get_link_page_label (document_links, link);
-	if (!page_label)
-		return FALSE;
-
-	gtk_tree_store_set (GTK_TREE_STORE (tree_model), iter,
-			    EV_DOCUMENT_LINKS_COLUMN_PAGE_LABEL, page_label,
-			    -1);
-
-	g_free (page_label);
-	g_object_unref (link);
-
-	return FALSE;
-}
-
 static gboolean
 ev_job_links_run (EvJob *job)
 {
@@ -384,12 +403,11 @@ ev_job_links_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
+	/* Page labels are resolved by the consumers on demand */
 	ev_document_doc_mutex_lock ();
 	job_links->model = ev_document_links_get_links_model (EV_DOCUMENT_LINKS (job->document));
 	ev_document_doc_mutex_unlock ();
 
-	gtk_tree_model_foreach (job_links->model, (GtkTreeModelForeachFunc)fill_page_labels, job);
-
 	ev_job_succeeded (job);
 	
 	return FALSE;
@@ -434,6 +452,105 @@ ev_job_links_get_model (EvJobLinks *job)
 	return job->model;
 }
 
+/* EvJobLinkLabels */
+static void
+ev_job_link_labels_init (EvJobLinkLabels *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+static void
+ev_job_link_labels_dispose (GObject *object)
+{
+	EvJobLinkLabels *job;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	job = EV_JOB_LINK_LABELS (object);
+
+	if (job->page_labels) {
+		guint i;
+
+		for (i = 0; i < job->links->len; i++)
+			g_free (job->page_labels[i]);
+		g_free (job->page_labels);
+		job->page_labels = NULL;
+	}
+
+	if (job->links) {
+		g_ptr_array_unref (job->links);
+		job->links = NULL;
+	}
+
+	(* G_OBJECT_CLASS (ev_job_link_labels_parent_class)->dispose) (object);
+}
+
+static gboolean
+ev_job_link_labels_run (EvJob *job)
+{
+	EvJobLinkLabels *job_labels = EV_JOB_LINK_LABELS (job);
+	guint            i;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	/* Labels that can't be resolved are left NULL */
+	job_labels->page_labels = g_new0 (gchar *, job_labels->links->len);
+	for (i = 0; i < job_labels->links->len; i++) {
+		EvLink *link = g_ptr_array_index (job_labels->links, i);
+
+		if (g_cancellable_is_cancelled (job->cancellable))
+			break;
+
+		job_labels->page_labels[i] =
+			ev_document_links_get_link_page_label (EV_DOCUMENT_LINKS (job->document),
+							       link);
+	}
+
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_link_labels_class_init (EvJobLinkLabelsClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_link_labels_dispose;
+	job_class->run = ev_job_link_labels_run;
+}
+
+/**
+ * ev_job_link_labels_new:
+ * @document: an #EvDocument implementing #EvDocumentLinks
+ * @links: (element-type EvLink): the links to resolve the page labels of
+ *
+ * Creates a job resolving the page labels of @links, so that outline
+ * consumers don't need to block the main loop on it. The labels are
+ * stored in the page_labels field of the job, in the same order as
+ * @links; labels that can't be resolved are %NULL.
+ *
+ * Return value: (transfer full): a new #EvJob
+ *
+ * Since: 3.10
+ */
+EvJob *
+ev_job_link_labels_new (EvDocument *document,
+			GPtrArray  *links)
+{
+	EvJob *job;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	job = g_object_new (EV_TYPE_JOB_LINK_LABELS, NULL);
+	job->document = g_object_ref (document);
+	EV_JOB_LINK_LABELS (job)->links = g_ptr_array_ref (links);
+
+	return job;
+}
+
 /* EvJobAttachments */
 static void
 ev_job_attachments_init (EvJobAttachments *job)
@@ -504,7 +621,7 @@ ev_job_attachments_new (EvDocument *document)
 static void
 ev_job_annots_init (EvJobAnnots *job)
 {
-	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+	EV_JOB (job)->run_mode = EV_JOB_RUN_MAIN_LOOP;
 }
 
 static void
@@ -529,31 +646,58 @@ static gboolean
 ev_job_annots_run (EvJob *job)
 {
 	EvJobAnnots *job_annots = EV_JOB_ANNOTS (job);
-	gint         i;
+	GList       *annots = NULL;
+	gint64       start_time;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
-	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
-	for (i = 0; i < ev_document_get_n_pages (job->document); i++) {
+	if (job_annots->current_page >= job_annots->n_pages) {
+		ev_job_succeeded (job);
+
+		return FALSE;
+	}
+
+	/* Do not block the main loop */
+	if (!ev_document_doc_mutex_trylock ())
+		return TRUE;
+
+#ifdef EV_ENABLE_DEBUG
+	/* We use the #ifdef in this case because of the if */
+	if (job_annots->current_page == 0)
+		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+#endif
+
+	/* Scan as many pages as possible in a time slice and release the
+	 * document, so that rendering is not blocked by big documents.
+	 */
+	start_time = g_get_monotonic_time ();
+	do {
 		EvMappingList *mapping_list;
 		EvPage        *page;
 
-		page = ev_document_get_page (job->document, i);
+		page = ev_document_get_page (job->document, job_annots->current_page);
 		mapping_list = ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (job->document),
 									page);
 		g_object_unref (page);
 
 		if (mapping_list)
-			job_annots->annots = g_list_prepend (job_annots->annots, mapping_list);
-	}
+			annots = g_list_prepend (annots, mapping_list);
+		job_annots->current_page++;
+	} while (job_annots->current_page < job_annots->n_pages &&
+		 g_get_monotonic_time () - start_time < ANNOTS_SCAN_TIME_SLICE);
 	ev_document_doc_mutex_unlock ();
 
-	job_annots->annots = g_list_reverse (job_annots->annots);
+	job_annots->annots = g_list_concat (job_annots->annots, g_list_reverse (annots));
+	g_signal_emit (job_annots, job_annots_signals[ANNOTS_UPDATED], 0,
+		       job_annots->current_page - 1);
 
-	ev_job_succeeded (job);
+	if (job_annots->current_page == job_annots->n_pages) {
+		ev_job_succeeded (job);
 
-	return FALSE;
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
 static void
@@ -564,19 +708,30 @@ ev_job_annots_class_init (EvJobAnnotsClass *class)
 
 	oclass->dispose = ev_job_annots_dispose;
 	job_class->run = ev_job_annots_run;
+
+	job_annots_signals[ANNOTS_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_ANNOTS,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobAnnotsClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE,
+			      1, G_TYPE_INT);
 }
 
 EvJob *
 ev_job_annots_new (EvDocument *document)
 {
-	EvJob *job;
+	EvJobAnnots *job;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 
 	job = g_object_new (EV_TYPE_JOB_ANNOTS, NULL);
-	job->document = g_object_ref (document);
+	EV_JOB (job)->document = g_object_ref (document);
+	job->n_pages = ev_document_get_n_pages (document);
 
-	return job;
+	return EV_JOB (job);
 }
 
 /* EvJobRender */
@@ -610,6 +765,11 @@ ev_job_render_dispose (GObject *object)
 		job->selection_region = NULL;
 	}
 
+	if (job->damage) {
+		cairo_region_destroy (job->damage);
+		job->damage = NULL;
+	}
+
 	(* G_OBJECT_CLASS (ev_job_render_parent_class)->dispose) (object);
 }
 
@@ -619,6 +779,7 @@ ev_job_render_run (EvJob *job)
 	EvJobRender     *job_render = EV_JOB_RENDER (job);
 	EvPage          *ev_page;
 	EvRenderContext *rc;
+	gint64           start;
 
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
@@ -633,7 +794,43 @@ ev_job_render_run (EvJob *job)
 	rc = ev_render_context_new (ev_page, job_render->rotation, job_render->scale);
 	g_object_unref (ev_page);
 
-	job_render->surface = ev_document_render (job->document, rc);
+	start = g_get_monotonic_time ();
+	job_render->start_time = start;
+
+	if (job_render->damage) {
+		cairo_rectangle_int_t extents;
+
+		/* Render only the damaged area into a surface of its size,
+		 * the device offset moves it to page coordinates
+		 */
+		cairo_region_get_extents (job_render->damage, &extents);
+		job_render->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+								  extents.width,
+								  extents.height);
+		cairo_surface_set_device_offset (job_render->surface, -extents.x, -extents.y);
+
+		if (!ev_document_render_region (job->document, rc,
+						job_render->surface,
+						job_render->damage)) {
+			cairo_surface_destroy (job_render->surface);
+			job_render->surface = NULL;
+			cairo_region_destroy (job_render->damage);
+			job_render->damage = NULL;
+		}
+	}
+
+	if (!job_render->surface)
+		job_render->surface = ev_document_render (job->document, rc);
+	job_render->render_time = g_get_monotonic_time () - start;
+	/* Previews and damaged areas aren't representative
+	 * of the cost of rendering the whole page */
+	if (!job_render->damage && !job_render->preview && job_render->surface) {
+		ev_render_cost_record (ev_render_cost_get_for_document (job->document),
+				       job_render->page,
+				       job_render->target_width,
+				       job_render->target_height,
+				       job_render->render_time);
+	}
 	/* If job was cancelled during the page rendering,
 	 * we return now, so that the thread is finished ASAP
 	 */
@@ -719,6 +916,49 @@ ev_job_render_set_selection_info (EvJobRender     *job,
 	job->base = *base;
 }
 
+/**
+ * ev_job_render_set_preview:
+ * @job: an #EvJobRender
+ * @preview: whether @job renders a preview of the page
+ *
+ * Marks @job as rendering a low resolution preview of a page, shown
+ * scaled up until the page is rendered at its actual scale. The time
+ * spent on previews isn't used to estimate the cost of the page.
+ *
+ * Since: 3.10
+ */
+void
+ev_job_render_set_preview (EvJobRender *job,
+			   gboolean     preview)
+{
+	g_return_if_fail (EV_IS_JOB_RENDER (job));
+
+	job->preview = preview;
+}
+
+/**
+ * ev_job_render_set_damage:
+ * @job: an #EvJobRender
+ * @damage: the area of the page to render, in pixels
+ *
+ * Makes @job render only @damage instead of the whole page. The resulting
+ * surface covers the extents of @damage, with a device offset so that it
+ * can be painted at the origin of the page. If the backend can't render
+ * part of a page, the whole page is rendered and the damage is cleared.
+ *
+ * Since: 3.10
+ */
+void
+ev_job_render_set_damage (EvJobRender    *job,
+			  cairo_region_t *damage)
+{
+	g_return_if_fail (EV_IS_JOB_RENDER (job));
+
+	if (job->damage)
+		cairo_region_destroy (job->damage);
+	job->damage = damage ? cairo_region_reference (damage) : NULL;
+}
+
 /* EvJobPageData */
 static void
 ev_job_page_data_init (EvJobPageData *job)
@@ -1026,6 +1266,7 @@ ev_job_load_run (EvJob *job)
 	   creating a new instance */
 	if (job->document) {
 		const gchar *uncompressed_uri;
+		GBytes      *uncompressed_data;
 
 		if (job_load->password) {
 			ev_document_security_set_password (EV_DOCUMENT_SECURITY (job->document),
@@ -1036,11 +1277,23 @@ ev_job_load_run (EvJob *job)
 		job->finished = FALSE;
 		g_clear_error (&job->error);
 
-		uncompressed_uri = g_object_get_data (G_OBJECT (job->document),
-						      "uri-uncompressed");
-		ev_document_load (job->document,
-				  uncompressed_uri ? uncompressed_uri : job_load->uri,
-				  &error);
+		uncompressed_data = g_object_get_data (G_OBJECT (job->document),
+						       "data-uncompressed");
+		if (uncompressed_data) {
+			GInputStream *stream;
+
+			stream = g_memory_input_stream_new_from_bytes (uncompressed_data);
+			ev_document_load_stream (job->document, stream,
+						 EV_DOCUMENT_LOAD_FLAG_NONE,
+						 NULL, &error);
+			g_object_unref (stream);
+		} else {
+			uncompressed_uri = g_object_get_data (G_OBJECT (job->document),
+							      "uri-uncompressed");
+			ev_document_load (job->document,
+					  uncompressed_uri ? uncompressed_uri : job_load->uri,
+					  &error);
+		}
 	} else {
 		job->document = ev_document_factory_get_document (job_load->uri,
 								  &error);
@@ -1414,6 +1667,20 @@ ev_job_save_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_save_parent_class)->dispose) (object);
 }
 
+static gboolean
+ev_job_save_document_is_modified (EvDocument *document)
+{
+	if (EV_IS_DOCUMENT_FORMS (document) &&
+	    ev_document_forms_document_is_modified (EV_DOCUMENT_FORMS (document)))
+		return TRUE;
+
+	if (EV_IS_DOCUMENT_ANNOTATIONS (document) &&
+	    ev_document_annotations_document_is_modified (EV_DOCUMENT_ANNOTATIONS (document)))
+		return TRUE;
+
+	return FALSE;
+}
+
 static gboolean
 ev_job_save_run (EvJob *job)
 {
@@ -1421,11 +1688,33 @@ ev_job_save_run (EvJob *job)
 	gint       fd;
 	gchar     *tmp_filename = NULL;
 	gchar     *local_uri;
+	gboolean   modified;
 	GError    *error = NULL;
 	
 	ev_debug_message (DEBUG_JOBS, "uri: %s, document_uri: %s", job_save->uri, job_save->document_uri);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
+	ev_document_doc_mutex_lock ();
+	modified = ev_job_save_document_is_modified (job->document);
+	ev_document_doc_mutex_unlock ();
+
+	/* The document has no changes in memory, so the original file
+	 * (already compressed if it was) is exactly what we would write.
+	 */
+	if (!modified) {
+		if (ev_file_clone (job_save->document_uri, job_save->uri, &error))
+			ev_file_copy_metadata (job_save->document_uri, job_save->uri, &error);
+
+		if (error) {
+			ev_job_failed_from_error (job, error);
+			g_error_free (error);
+		} else {
+			ev_job_succeeded (job);
+		}
+
+		return FALSE;
+	}
+
         fd = ev_mkstemp ("saveacopy.XXXXXX", &tmp_filename, &error);
         if (fd == -1) {
                 ev_job_failed_from_error (job, error);
@@ -1456,7 +1745,8 @@ ev_job_save_run (EvJob *job)
 	/* If original document was compressed,
 	 * compress it again before saving
 	 */
-	if (g_object_get_data (G_OBJECT (job->document), "uri-uncompressed")) {
+	if (g_object_get_data (G_OBJECT (job->document), "uri-uncompressed") ||
+	    g_object_get_data (G_OBJECT (job->document), "data-uncompressed")) {
 		EvCompressionType ctype = EV_COMPRESSION_NONE;
 		const gchar      *ext;
 		gchar            *uri_comp;
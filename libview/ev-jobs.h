@@ -48,6 +48,9 @@ typedef struct _EvJobThumbnailClass EvJobThumbnailClass;
 typedef struct _EvJobLinks EvJobLinks;
 typedef struct _EvJobLinksClass EvJobLinksClass;
 
+typedef struct _EvJobLinkLabels EvJobLinkLabels;
+typedef struct _EvJobLinkLabelsClass EvJobLinkLabelsClass;
+
 typedef struct _EvJobAttachments EvJobAttachments;
 typedef struct _EvJobAttachmentsClass EvJobAttachmentsClass;
 
@@ -95,6 +98,13 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_IS_JOB_LINKS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_LINKS))
 #define EV_JOB_LINKS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_LINKS, EvJobLinksClass))
 
+#define EV_TYPE_JOB_LINK_LABELS            (ev_job_link_labels_get_type())
+#define EV_JOB_LINK_LABELS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_LINK_LABELS, EvJobLinkLabels))
+#define EV_IS_JOB_LINK_LABELS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_LINK_LABELS))
+#define EV_JOB_LINK_LABELS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), EV_TYPE_JOB_LINK_LABELS, EvJobLinkLabelsClass))
+#define EV_IS_JOB_LINK_LABELS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), EV_TYPE_JOB_LINK_LABELS))
+#define EV_JOB_LINK_LABELS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), EV_TYPE_JOB_LINK_LABELS, EvJobLinkLabelsClass))
+
 #define EV_TYPE_JOB_ATTACHMENTS           (ev_job_attachments_get_type())
 #define EV_JOB_ATTACHMENTS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), EV_TYPE_JOB_ATTACHMENTS, EvJobAttachments))
 #define EV_IS_JOB_ATTACHMENTS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EV_TYPE_JOB_ATTACHMENTS))
@@ -241,6 +251,19 @@ struct _EvJobLinksClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobLinkLabels
+{
+	EvJob parent;
+
+	GPtrArray *links;
+	gchar    **page_labels;
+};
+
+struct _EvJobLinkLabelsClass
+{
+	EvJobClass parent_class;
+};
+
 struct _EvJobAttachments
 {
 	EvJob parent;
@@ -258,11 +281,17 @@ struct _EvJobAnnots
 	EvJob parent;
 
 	GList *annots;
+	gint current_page;
+	gint n_pages;
 };
 
 struct _EvJobAnnotsClass
 {
 	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated)  (EvJobAnnots *job,
+			   gint         page);
 };
 
 struct _EvJobRender
@@ -285,6 +314,18 @@ struct _EvJobRender
 	EvSelectionStyle selection_style;
 	GdkColor base;
 	GdkColor text;
+
+	/* When set, only this part of the page is rendered into
+	 * a surface covering its extents */
+	cairo_region_t *damage;
+
+	/* The page is rendered at a lower scale than it's shown */
+	gboolean preview;
+
+	/* Monotonic time the rendering started at, 0 while queued */
+	gint64 start_time;
+	/* Time spent rendering the page, in microseconds */
+	gint64 render_time;
 };
 
 struct _EvJobRenderClass
@@ -501,6 +542,11 @@ GType           ev_job_links_get_type     (void) G_GNUC_CONST;
 EvJob          *ev_job_links_new          (EvDocument     *document);
 GtkTreeModel   *ev_job_links_get_model    (EvJobLinks     *job);
 
+/* EvJobLinkLabels */
+GType           ev_job_link_labels_get_type (void) G_GNUC_CONST;
+EvJob          *ev_job_link_labels_new      (EvDocument     *document,
+					     GPtrArray      *links);
+
 /* EvJobAttachments */
 GType           ev_job_attachments_get_type (void) G_GNUC_CONST;
 EvJob          *ev_job_attachments_new      (EvDocument     *document);
@@ -522,6 +568,10 @@ void     ev_job_render_set_selection_info (EvJobRender     *job,
 					   EvSelectionStyle selection_style,
 					   GdkColor        *text,
 					   GdkColor        *base);
+void     ev_job_render_set_preview        (EvJobRender     *job,
+					   gboolean         preview);
+void     ev_job_render_set_damage         (EvJobRender     *job,
+					   cairo_region_t  *damage);
 /* EvJobPageData */
 GType           ev_job_page_data_get_type (void) G_GNUC_CONST;
 EvJob          *ev_job_page_data_new      (EvDocument      *document,
@@ -0,0 +1,273 @@
+/* ev-memory-governor.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-debug.h"
+#include "ev-memory-governor.h"
+
+/* All the surfaces rendered by the views of the process, at most,
+ * unless set from the memory-budget setting */
+#define DEFAULT_BUDGET (512 * 1024 * 1024)
+
+/* The system memory is checked when the usage grows, at most this
+ * often, in microseconds */
+#define MEMORY_PRESSURE_INTERVAL (10 * G_USEC_PER_SEC)
+/* Percentage of the system memory still available under pressure */
+#define MEMORY_PRESSURE_THRESHOLD 5
+
+struct _EvMemoryConsumer {
+	gchar              *name;
+	EvMemoryPriority    priority;
+	EvMemoryReclaimFunc reclaim;
+	gpointer            data;
+
+	gsize               usage;
+	gint64              last_used;
+};
+
+/* Consumers are caches of the UI, so this is only used from the main thread */
+static GList   *consumers = NULL;
+static gsize    budget = DEFAULT_BUDGET;
+static gsize    total_usage = 0;
+static guint    enforce_id = 0;
+static gint64   pressure_check_time = 0;
+static gboolean meminfo_available = TRUE;
+static gboolean under_pressure = FALSE;
+
+static gsize
+ev_memory_governor_get_limit (void)
+{
+	/* Keep half of the budget while the system is short of memory */
+	return under_pressure ? budget / 2 : budget;
+}
+
+static gint
+compare_consumers (EvMemoryConsumer *a,
+		   EvMemoryConsumer *b)
+{
+	if (a->priority != b->priority)
+		return a->priority < b->priority ? -1 : 1;
+
+	if (a->last_used != b->last_used)
+		return a->last_used < b->last_used ? -1 : 1;
+
+	return 0;
+}
+
+static void
+ev_memory_governor_reclaim (gsize limit)
+{
+	GList *sorted, *l;
+
+	if (total_usage <= limit)
+		return;
+
+	ev_debug_message (DEBUG_JOBS, "usage %" G_GSIZE_FORMAT " limit %" G_GSIZE_FORMAT,
+			  total_usage, limit);
+
+	/* Least important and least recently used consumers first */
+	sorted = g_list_sort (g_list_copy (consumers), (GCompareFunc)compare_consumers);
+
+	/* Only what isn't shown is dropped: preloaded pages, hidden
+	 * views. The pages shown by any mapped view are kept, even
+	 * over the budget */
+	for (l = sorted; l && total_usage > limit; l = g_list_next (l)) {
+		EvMemoryConsumer *consumer = (EvMemoryConsumer *)l->data;
+
+		if (consumer->reclaim && consumer->usage > 0)
+			consumer->reclaim (consumer->data, total_usage - limit);
+	}
+
+	g_list_free (sorted);
+}
+
+static gboolean
+ev_memory_governor_enforce (gpointer data)
+{
+	enforce_id = 0;
+
+	ev_memory_governor_reclaim (ev_memory_governor_get_limit ());
+
+	return FALSE;
+}
+
+static void
+ev_memory_governor_schedule_enforce (void)
+{
+	if (enforce_id > 0 || total_usage <= ev_memory_governor_get_limit ())
+		return;
+
+	/* Reclaiming from an idle, consumers usually report their usage
+	 * while updating their caches.
+	 */
+	enforce_id = g_idle_add (ev_memory_governor_enforce, NULL);
+}
+
+static gboolean
+read_meminfo (guint64 *total,
+	      guint64 *available)
+{
+	gchar  *contents;
+	gchar **lines;
+	gint    i;
+
+	*total = *available = 0;
+
+	if (!g_file_get_contents ("/proc/meminfo", &contents, NULL, NULL))
+		return FALSE;
+
+	lines = g_strsplit (contents, "\n", -1);
+	for (i = 0; lines[i]; i++) {
+		if (g_str_has_prefix (lines[i], "MemTotal:"))
+			*total = g_ascii_strtoull (lines[i] + strlen ("MemTotal:"), NULL, 10);
+		else if (g_str_has_prefix (lines[i], "MemAvailable:"))
+			*available = g_ascii_strtoull (lines[i] + strlen ("MemAvailable:"), NULL, 10);
+	}
+	g_strfreev (lines);
+	g_free (contents);
+
+	return *total > 0 && *available > 0;
+}
+
+static void
+check_memory_pressure (void)
+{
+	guint64  total, available;
+	gboolean was_under_pressure = under_pressure;
+	gint64   now;
+
+	if (!meminfo_available)
+		return;
+
+	now = g_get_monotonic_time ();
+	if (pressure_check_time > 0 && now - pressure_check_time < MEMORY_PRESSURE_INTERVAL)
+		return;
+	pressure_check_time = now;
+
+	if (!read_meminfo (&total, &available)) {
+		/* Not available on this system */
+		meminfo_available = FALSE;
+		under_pressure = FALSE;
+
+		return;
+	}
+
+	under_pressure = available * 100 < total * MEMORY_PRESSURE_THRESHOLD;
+	if (under_pressure && !was_under_pressure) {
+		ev_debug_message (DEBUG_JOBS, "memory pressure, %" G_GUINT64_FORMAT " kB available",
+				  available);
+		ev_memory_governor_trim ();
+	}
+}
+
+EvMemoryConsumer *
+ev_memory_governor_register (const gchar        *name,
+			     EvMemoryPriority    priority,
+			     EvMemoryReclaimFunc reclaim,
+			     gpointer            data)
+{
+	EvMemoryConsumer *consumer;
+
+	consumer = g_slice_new0 (EvMemoryConsumer);
+	consumer->name = g_strdup (name);
+	consumer->priority = priority;
+	consumer->reclaim = reclaim;
+	consumer->data = data;
+	consumer->last_used = g_get_monotonic_time ();
+
+	consumers = g_list_prepend (consumers, consumer);
+
+	return consumer;
+}
+
+void
+ev_memory_governor_unregister (EvMemoryConsumer *consumer)
+{
+	g_return_if_fail (consumer != NULL);
+
+	total_usage -= consumer->usage;
+	consumers = g_list_remove (consumers, consumer);
+
+	g_free (consumer->name);
+	g_slice_free (EvMemoryConsumer, consumer);
+
+	if (consumers)
+		return;
+
+	if (enforce_id > 0) {
+		g_source_remove (enforce_id);
+		enforce_id = 0;
+	}
+	pressure_check_time = 0;
+	under_pressure = FALSE;
+}
+
+void
+ev_memory_governor_set_usage (EvMemoryConsumer *consumer,
+			      gsize             bytes)
+{
+	g_return_if_fail (consumer != NULL);
+
+	/* Instead of polling, the system memory is checked while
+	 * the caches grow, which is when it matters */
+	if (bytes > consumer->usage)
+		check_memory_pressure ();
+
+	total_usage = total_usage - consumer->usage + bytes;
+	consumer->usage = bytes;
+
+	ev_memory_governor_schedule_enforce ();
+}
+
+void
+ev_memory_governor_touch (EvMemoryConsumer *consumer)
+{
+	g_return_if_fail (consumer != NULL);
+
+	consumer->last_used = g_get_monotonic_time ();
+}
+
+/* Sets the memory all the consumers can use, in bytes */
+void
+ev_memory_governor_set_budget (gsize bytes)
+{
+	if (budget == bytes)
+		return;
+
+	budget = bytes;
+	ev_memory_governor_schedule_enforce ();
+}
+
+/* Frees everything that isn't shown right now */
+void
+ev_memory_governor_trim (void)
+{
+	GList *l;
+
+	for (l = consumers; l; l = g_list_next (l)) {
+		EvMemoryConsumer *consumer = (EvMemoryConsumer *)l->data;
+
+		if (consumer->reclaim && consumer->usage > 0)
+			consumer->reclaim (consumer->data, consumer->usage);
+	}
+
+	ev_memory_governor_reclaim (ev_memory_governor_get_limit ());
+}
@@ -0,0 +1,57 @@
+/* ev-memory-governor.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_MEMORY_GOVERNOR_H
+#define EV_MEMORY_GOVERNOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvMemoryConsumer EvMemoryConsumer;
+
+typedef enum {
+	EV_MEMORY_PRIORITY_LOW,    /* Thumbnails, presentation, ... */
+	EV_MEMORY_PRIORITY_NORMAL  /* Page caches of the views */
+} EvMemoryPriority;
+
+/* Frees at least @bytes if possible and returns the number of bytes freed.
+ * Only what isn't currently shown must be freed.
+ */
+typedef gsize (* EvMemoryReclaimFunc) (gpointer data,
+				       gsize    bytes);
+
+EvMemoryConsumer *ev_memory_governor_register   (const gchar        *name,
+						 EvMemoryPriority    priority,
+						 EvMemoryReclaimFunc reclaim,
+						 gpointer            data);
+void              ev_memory_governor_unregister (EvMemoryConsumer   *consumer);
+void              ev_memory_governor_set_usage  (EvMemoryConsumer   *consumer,
+						 gsize               bytes);
+void              ev_memory_governor_touch      (EvMemoryConsumer   *consumer);
+
+void              ev_memory_governor_set_budget (gsize               bytes);
+void              ev_memory_governor_trim       (void);
+
+G_END_DECLS
+
+#endif /* EV_MEMORY_GOVERNOR_H */
@@ -1,7 +1,31 @@
 #include <config.h>
+#include <math.h>
+#include <string.h>
 #include "ev-pixbuf-cache.h"
 #include "ev-job-scheduler.h"
+#include "ev-memory-governor.h"
+#include "ev-render-cost.h"
 #include "ev-view-private.h"
+#include "ev-document-layers.h"
+
+/* Pixels added around a damaged area rendered again */
+#define DAMAGE_MARGIN 2
+
+/* Number of layer visibility states whose pages are kept around */
+#define MAX_LAYERS_STATES 4
+
+/* Scrolling is considered over when the page range hasn't changed
+ * for this long, in microseconds */
+#define SCROLL_SETTLE_TIME (250 * 1000)
+/* Seconds of scrolling covered by the pages preloaded ahead */
+#define PREFETCH_TIME 1.0
+#define MAX_PREFETCH_PAGES 12
+/* Scale of the previews rendered for the pages that would be
+ * scrolled past before being rendered */
+#define PREVIEW_SCALE 0.25
+/* Pages taking longer than this to render, in seconds, are
+ * shown as a preview first */
+#define PLACEHOLDER_TIME 0.3
 
 typedef enum {
         SCROLL_DIRECTION_DOWN,
@@ -12,6 +36,10 @@ typedef struct _CacheJobInfo
 {
 	EvJob *job;
 	gboolean page_ready;
+	/* The job renders a low resolution preview of the page */
+	gboolean preview;
+	/* Monotonic time the job was queued at */
+	gint64 queued_time;
 
 	/* Region of the page that needs to be drawn */
 	cairo_region_t  *region;
@@ -35,6 +63,22 @@ typedef struct _CacheJobInfo
 	EvRectangle     selection_region_points;
 } CacheJobInfo;
 
+typedef struct _PageCost
+{
+	gint    page;
+	gdouble cost;
+} PageCost;
+
+/* The pages rendered with a given visibility of the layers */
+typedef struct _LayersState
+{
+	gchar      *key;
+	gint        rotation;
+	gdouble     scale;
+	gboolean    inverted_colors;
+	GHashTable *surfaces;
+} LayersState;
+
 struct _EvPixbufCache
 {
 	GObject parent;
@@ -60,6 +104,29 @@ struct _EvPixbufCache
 	CacheJobInfo *prev_job;
 	CacheJobInfo *job_list;
 	CacheJobInfo *next_job;
+
+	/* Pending redraw of selections that couldn't be updated
+	 * because the document was busy.
+	 */
+	guint selection_retry_id;
+
+	/* Accounting of the rendered surfaces for the whole process */
+	EvMemoryConsumer *memory_consumer;
+	/* Visible pages were released and must be rendered again */
+	gboolean reclaimed;
+
+	/* Visibility of the layers the cached pages were rendered with,
+	 * and the pages of the previous states, most recent first */
+	gchar *layers_key;
+	GList *layers_states;
+
+	/* Scroll speed in pages per second, positive when scrolling
+	 * down, measured when the page range changes */
+	gdouble velocity;
+	gint64  range_change_time;
+	guint   settle_id;
+
+	EvRenderCost *render_cost;
 };
 
 struct _EvPixbufCacheClass
@@ -90,6 +157,9 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 						  CacheJobInfo       *job_info,
 						  gint                page,
 						  gfloat              scale);
+static void          ev_pixbuf_cache_add_jobs_if_needed (EvPixbufCache *pixbuf_cache,
+							 gint           rotation,
+							 gfloat         scale);
 
 
 /* These are used for iterating through the prev and next arrays */
@@ -101,6 +171,7 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 	((pixbuf_cache->end_page - pixbuf_cache->start_page) + 1)
 
 #define MAX_PRELOADED_PAGES 3
+#define SELECTION_RETRY_INTERVAL 30
 
 G_DEFINE_TYPE (EvPixbufCache, ev_pixbuf_cache, G_TYPE_OBJECT)
 
@@ -155,6 +226,7 @@ ev_pixbuf_cache_finalize (GObject *object)
 		pixbuf_cache->next_job = NULL;
 	}
 
+	g_free (pixbuf_cache->layers_key);
 	g_object_unref (pixbuf_cache->model);
 
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->finalize (object);
@@ -195,6 +267,21 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 	job_info->points_set = FALSE;
 }
 
+static void
+layers_state_free (LayersState *state)
+{
+	g_free (state->key);
+	g_hash_table_destroy (state->surfaces);
+	g_slice_free (LayersState, state);
+}
+
+static void
+ev_pixbuf_cache_drop_layers_states (EvPixbufCache *pixbuf_cache)
+{
+	g_list_free_full (pixbuf_cache->layers_states, (GDestroyNotify)layers_state_free);
+	pixbuf_cache->layers_states = NULL;
+}
+
 static void
 ev_pixbuf_cache_dispose (GObject *object)
 {
@@ -203,6 +290,21 @@ ev_pixbuf_cache_dispose (GObject *object)
 
 	pixbuf_cache = EV_PIXBUF_CACHE (object);
 
+	if (pixbuf_cache->memory_consumer) {
+		ev_memory_governor_unregister (pixbuf_cache->memory_consumer);
+		pixbuf_cache->memory_consumer = NULL;
+	}
+
+	if (pixbuf_cache->selection_retry_id > 0) {
+		g_source_remove (pixbuf_cache->selection_retry_id);
+		pixbuf_cache->selection_retry_id = 0;
+	}
+
+	if (pixbuf_cache->settle_id > 0) {
+		g_source_remove (pixbuf_cache->settle_id);
+		pixbuf_cache->settle_id = 0;
+	}
+
 	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
 		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
 		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
@@ -212,10 +314,194 @@ ev_pixbuf_cache_dispose (GObject *object)
 		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
 	}
 
+	ev_pixbuf_cache_drop_layers_states (pixbuf_cache);
+
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->dispose (object);
 }
 
 
+static gsize
+surface_get_size (cairo_surface_t *surface)
+{
+	if (!surface || cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return 0;
+
+	return cairo_image_surface_get_stride (surface) * cairo_image_surface_get_height (surface);
+}
+
+static gsize
+cache_job_info_get_size (CacheJobInfo *job_info)
+{
+	return surface_get_size (job_info->surface) + surface_get_size (job_info->selection);
+}
+
+static gsize
+layers_state_get_size (LayersState *state)
+{
+	GHashTableIter iter;
+	gpointer       surface;
+	gsize          size = 0;
+
+	g_hash_table_iter_init (&iter, state->surfaces);
+	while (g_hash_table_iter_next (&iter, NULL, &surface))
+		size += surface_get_size (surface);
+
+	return size;
+}
+
+static void
+ev_pixbuf_cache_update_memory_usage (EvPixbufCache *pixbuf_cache)
+{
+	gsize  usage = 0;
+	GList *l;
+	gint   i;
+
+	if (!pixbuf_cache->memory_consumer)
+		return;
+
+	for (l = pixbuf_cache->layers_states; l; l = g_list_next (l))
+		usage += layers_state_get_size (l->data);
+
+	if (pixbuf_cache->job_list) {
+		for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+			usage += cache_job_info_get_size (pixbuf_cache->prev_job + i);
+			usage += cache_job_info_get_size (pixbuf_cache->next_job + i);
+		}
+
+		for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++)
+			usage += cache_job_info_get_size (pixbuf_cache->job_list + i);
+	}
+
+	ev_memory_governor_set_usage (pixbuf_cache->memory_consumer, usage);
+}
+
+static gsize
+ev_pixbuf_cache_reclaim (EvPixbufCache *pixbuf_cache,
+			 gsize          bytes)
+{
+	gsize  freed = 0;
+	GList *l;
+	gint   i;
+
+	/* Pages of other layer states go first, they aren't shown */
+	for (l = pixbuf_cache->layers_states; l; l = g_list_next (l))
+		freed += layers_state_get_size (l->data);
+	ev_pixbuf_cache_drop_layers_states (pixbuf_cache);
+
+	if (!pixbuf_cache->job_list) {
+		ev_pixbuf_cache_update_memory_usage (pixbuf_cache);
+		return freed;
+	}
+
+	/* Preloaded pages go first */
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		freed += cache_job_info_get_size (pixbuf_cache->prev_job + i);
+		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
+		freed += cache_job_info_get_size (pixbuf_cache->next_job + i);
+		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
+	}
+
+	/* Visible pages too, when the view can't be seen */
+	if (!gtk_widget_get_mapped (pixbuf_cache->view)) {
+		for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+			freed += cache_job_info_get_size (pixbuf_cache->job_list + i);
+			dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
+		}
+		pixbuf_cache->reclaimed = TRUE;
+	}
+
+	ev_pixbuf_cache_update_memory_usage (pixbuf_cache);
+
+	return freed;
+}
+
+/* The EvLayers of the document with a toggle, shared by its views */
+#define EV_PIXBUF_CACHE_LAYERS_KEY "ev-pixbuf-cache-layers"
+
+static gboolean
+collect_toggle_layers (GtkTreeModel *model,
+		       GtkTreePath  *path,
+		       GtkTreeIter  *iter,
+		       GPtrArray    *layers)
+{
+	EvLayer *layer;
+	gboolean show_toggle;
+
+	gtk_tree_model_get (model, iter,
+			    EV_DOCUMENT_LAYERS_COLUMN_LAYER, &layer,
+			    EV_DOCUMENT_LAYERS_COLUMN_SHOWTOGGLE, &show_toggle,
+			    -1);
+	if (layer && show_toggle)
+		g_ptr_array_add (layers, layer);
+	else if (layer)
+		g_object_unref (layer);
+
+	return FALSE;
+}
+
+/* The layers model is only built the first time, the document keeps
+ * the layers and their visibility is asked to the backend directly.
+ */
+static GPtrArray *
+get_document_layers (EvDocument *document)
+{
+	EvDocumentLayers *document_layers;
+	GtkTreeModel     *model;
+	GPtrArray        *layers;
+
+	layers = g_object_get_data (G_OBJECT (document), EV_PIXBUF_CACHE_LAYERS_KEY);
+	if (layers)
+		return layers;
+
+	document_layers = EV_DOCUMENT_LAYERS (document);
+
+	ev_document_doc_mutex_lock ();
+	model = ev_document_layers_has_layers (document_layers) ?
+		ev_document_layers_get_layers (document_layers) : NULL;
+	ev_document_doc_mutex_unlock ();
+
+	layers = g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+	if (model) {
+		gtk_tree_model_foreach (model,
+					(GtkTreeModelForeachFunc)collect_toggle_layers,
+					layers);
+		g_object_unref (model);
+	}
+	g_object_set_data_full (G_OBJECT (document), EV_PIXBUF_CACHE_LAYERS_KEY,
+				layers, (GDestroyNotify)g_ptr_array_unref);
+
+	return layers;
+}
+
+/* Returns a string identifying the visibility of all the layers of the
+ * document, or %NULL if it doesn't have layers.
+ */
+static gchar *
+get_layers_key (EvDocument *document)
+{
+	GPtrArray *layers;
+	GString   *key;
+	guint      i;
+
+	if (!EV_IS_DOCUMENT_LAYERS (document))
+		return NULL;
+
+	layers = get_document_layers (document);
+	if (layers->len == 0)
+		return NULL;
+
+	key = g_string_sized_new (layers->len);
+	for (i = 0; i < layers->len; i++) {
+		gboolean visible;
+
+		visible = ev_document_layers_layer_is_visible (EV_DOCUMENT_LAYERS (document),
+							       g_ptr_array_index (layers, i));
+		g_string_append_c (key, visible ? '1' : '0');
+	}
+
+	return g_string_free (key, FALSE);
+}
+
 EvPixbufCache *
 ev_pixbuf_cache_new (GtkWidget       *view,
 		     EvDocumentModel *model,
@@ -229,6 +515,13 @@ ev_pixbuf_cache_new (GtkWidget       *view,
 	pixbuf_cache->model = g_object_ref (model);
 	pixbuf_cache->document = ev_document_model_get_document (model);
 	pixbuf_cache->max_size = max_size;
+	pixbuf_cache->layers_key = get_layers_key (pixbuf_cache->document);
+	pixbuf_cache->render_cost = ev_render_cost_get_for_document (pixbuf_cache->document);
+	pixbuf_cache->memory_consumer =
+		ev_memory_governor_register ("EvPixbufCache",
+					     EV_MEMORY_PRIORITY_NORMAL,
+					     (EvMemoryReclaimFunc)ev_pixbuf_cache_reclaim,
+					     pixbuf_cache);
 
 	return pixbuf_cache;
 }
@@ -245,17 +538,54 @@ ev_pixbuf_cache_set_max_size (EvPixbufCache *pixbuf_cache,
 	pixbuf_cache->max_size = max_size;
 }
 
+/* Estimated time to render a page, in seconds */
+static gdouble
+ev_pixbuf_cache_get_page_cost (EvPixbufCache *pixbuf_cache,
+			       gint           page,
+			       gint           width,
+			       gint           height)
+{
+	return (gdouble)ev_render_cost_estimate (pixbuf_cache->render_cost,
+						 page, width, height) / G_USEC_PER_SEC;
+}
+
 static void
 copy_job_to_job_info (EvJobRender   *job_render,
 		      CacheJobInfo  *job_info,
 		      EvPixbufCache *pixbuf_cache)
 {
-	if (job_info->surface) {
-		cairo_surface_destroy (job_info->surface);
-	}
-	job_info->surface = cairo_surface_reference (job_render->surface);
-	if (pixbuf_cache->inverted_colors) {
-		ev_document_misc_invert_surface (job_info->surface);
+	if (job_render->damage) {
+		/* The job rendered only the damaged area, paint it over
+		 * the page we already have. If the page was dropped in
+		 * the meantime there's nothing to update, it will be
+		 * rendered again when needed.
+		 */
+		if (job_info->surface &&
+		    cairo_image_surface_get_width (job_info->surface) == job_render->target_width &&
+		    cairo_image_surface_get_height (job_info->surface) == job_render->target_height) {
+			cairo_t *cr;
+
+			if (pixbuf_cache->inverted_colors)
+				ev_document_misc_invert_surface (job_render->surface);
+
+			cr = cairo_create (job_info->surface);
+			gdk_cairo_region (cr, job_render->damage);
+			cairo_clip (cr);
+			cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+			cairo_set_source_surface (cr, job_render->surface, 0, 0);
+			cairo_paint (cr);
+			cairo_destroy (cr);
+
+			cairo_surface_mark_dirty (job_info->surface);
+		}
+	} else {
+		if (job_info->surface) {
+			cairo_surface_destroy (job_info->surface);
+		}
+		job_info->surface = cairo_surface_reference (job_render->surface);
+		if (pixbuf_cache->inverted_colors) {
+			ev_document_misc_invert_surface (job_info->surface);
+		}
 	}
 
 	job_info->points_set = FALSE;
@@ -291,6 +621,22 @@ copy_job_to_job_info (EvJobRender   *job_render,
 	}
 
 	job_info->page_ready = TRUE;
+
+	ev_pixbuf_cache_update_memory_usage (pixbuf_cache);
+}
+
+/* Render the whole pages once their previews are shown, unless the
+ * view is still scrolling, then it's done when scrolling stops.
+ */
+static void
+preview_finished (EvPixbufCache *pixbuf_cache)
+{
+	if (pixbuf_cache->settle_id > 0)
+		return;
+
+	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache,
+					    ev_document_model_get_rotation (pixbuf_cache->model),
+					    ev_document_model_get_scale (pixbuf_cache->model));
 }
 
 static void
@@ -311,6 +657,9 @@ job_finished_cb (EvJob         *job,
 
 	copy_job_to_job_info (job_render, job_info, pixbuf_cache);
 	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+
+	if (job_info->preview)
+		preview_finished (pixbuf_cache);
 }
 
 /* This checks a job to see if the job would generate the right sized pixbuf
@@ -330,7 +679,7 @@ check_job_size_and_unref (EvPixbufCache *pixbuf_cache,
 
 	_get_page_size_for_scale_and_rotation (job_info->job->document,
 					       EV_JOB_RENDER (job_info->job)->page,
-					       scale,
+					       job_info->preview ? scale * PREVIEW_SCALE : scale,
 					       EV_JOB_RENDER (job_info->job)->rotation,
 					       &width, &height);
 	if (width == EV_JOB_RENDER (job_info->job)->target_width &&
@@ -417,12 +766,63 @@ ev_pixbuf_cache_get_page_size (EvPixbufCache *pixbuf_cache,
 	return height * cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
 }
 
+static gdouble
+ev_pixbuf_cache_get_velocity (EvPixbufCache *pixbuf_cache)
+{
+	if (g_get_monotonic_time () - pixbuf_cache->range_change_time >= SCROLL_SETTLE_TIME)
+		return 0;
+
+	return pixbuf_cache->velocity;
+}
+
+static void
+ev_pixbuf_cache_update_velocity (EvPixbufCache *pixbuf_cache,
+				 gint           start_page)
+{
+	gint64 now;
+	gint64 elapsed;
+	gint   delta;
+
+	if (pixbuf_cache->start_page < 0 || start_page == pixbuf_cache->start_page)
+		return;
+
+	now = g_get_monotonic_time ();
+	elapsed = now - pixbuf_cache->range_change_time;
+	delta = start_page - pixbuf_cache->start_page;
+	pixbuf_cache->range_change_time = now;
+
+	/* Going to another page is a jump, not scrolling */
+	if (elapsed >= SCROLL_SETTLE_TIME || ABS (delta) > MAX_PREFETCH_PAGES) {
+		pixbuf_cache->velocity = 0;
+		return;
+	}
+
+	/* Average with the previous value to smooth the steps of the wheel */
+	pixbuf_cache->velocity = (pixbuf_cache->velocity +
+				  (gdouble)delta * G_USEC_PER_SEC / MAX (elapsed, 1)) / 2;
+}
+
+/* The number of pages preloaded ahead covers the pages reached
+ * in PREFETCH_TIME at the current scroll speed.
+ */
+static gint
+ev_pixbuf_cache_get_prefetch_pages (EvPixbufCache *pixbuf_cache)
+{
+	gdouble speed;
+
+	speed = ABS (ev_pixbuf_cache_get_velocity (pixbuf_cache));
+
+	return MIN (MAX_PRELOADED_PAGES + (gint)ceil (speed * PREFETCH_TIME),
+		    MAX_PREFETCH_PAGES);
+}
+
 static gint
 ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 				  gint           start_page,
 				  gint           end_page,
 				  gdouble        scale,
-				  gint           rotation)
+				  gint           rotation,
+				  gint           max_pages)
 {
 	gsize range_size = 0;
 	gint  new_preload_cache_size = 0;
@@ -439,7 +839,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 
 	i = 1;
 	while (((start_page - i > 0) || (end_page + i < n_pages)) &&
-	       new_preload_cache_size < MAX_PRELOADED_PAGES) {
+	       new_preload_cache_size < max_pages) {
 		gsize    page_size;
 		gboolean updated = FALSE;
 
@@ -490,7 +890,8 @@ ev_pixbuf_cache_update_range (EvPixbufCache *pixbuf_cache,
 								   start_page,
 								   end_page,
 								   scale,
-								   rotation);
+								   rotation,
+								   ev_pixbuf_cache_get_prefetch_pages (pixbuf_cache));
 	if (pixbuf_cache->start_page == start_page &&
 	    pixbuf_cache->end_page == end_page &&
 	    pixbuf_cache->preload_cache_size == new_preload_cache_size)
@@ -566,6 +967,8 @@ ev_pixbuf_cache_update_range (EvPixbufCache *pixbuf_cache,
 
 	pixbuf_cache->start_page = start_page;
 	pixbuf_cache->end_page = end_page;
+
+	ev_pixbuf_cache_update_memory_usage (pixbuf_cache);
 }
 
 static CacheJobInfo *
@@ -638,24 +1041,32 @@ static void
 add_job (EvPixbufCache  *pixbuf_cache,
 	 CacheJobInfo   *job_info,
 	 cairo_region_t *region,
+	 cairo_region_t *damage,
 	 gint            width,
 	 gint            height,
 	 gint            page,
 	 gint            rotation,
 	 gfloat          scale,
-	 EvJobPriority   priority)
+	 EvJobPriority   priority,
+	 gboolean        preview)
 {
 	job_info->page_ready = FALSE;
+	job_info->preview = preview;
+	job_info->queued_time = g_get_monotonic_time ();
 
 	if (job_info->region)
 		cairo_region_destroy (job_info->region);
 	job_info->region = region ? cairo_region_reference (region) : NULL;
 
 	job_info->job = ev_job_render_new (pixbuf_cache->document,
-					   page, rotation, scale,
+					   page, rotation,
+					   preview ? scale * PREVIEW_SCALE : scale,
 					   width, height);
+	ev_job_render_set_preview (EV_JOB_RENDER (job_info->job), preview);
+	if (damage)
+		ev_job_render_set_damage (EV_JOB_RENDER (job_info->job), damage);
 
-	if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
+	if (!preview && new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
 		GdkColor text, base;
 
 		get_selection_colors (EV_VIEW (pixbuf_cache->view), &text, &base);
@@ -671,17 +1082,63 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	ev_job_scheduler_push_job (job_info->job, priority);
 }
 
+/* Whether the page would be scrolled past before being rendered at
+ * full resolution, or is slow enough to render to show a preview of
+ * it first. @render_time is the time needed to render the pages queued
+ * before it, in seconds.
+ */
+static gboolean
+page_needs_preview (EvPixbufCache *pixbuf_cache,
+		    CacheJobInfo  *job_info,
+		    gint           page,
+		    gint           width,
+		    gint           height,
+		    gdouble        velocity,
+		    gdouble       *render_time)
+{
+	gdouble cost;
+	gint    distance;
+
+	cost = ev_pixbuf_cache_get_page_cost (pixbuf_cache, page, width, height);
+	if (velocity == 0 && !job_info->surface && cost >= PLACEHOLDER_TIME) {
+		*render_time += cost * PREVIEW_SCALE * PREVIEW_SCALE;
+		return TRUE;
+	}
+
+	if (velocity == 0 || cost == 0) {
+		*render_time += cost;
+		return FALSE;
+	}
+
+	/* Number of pages before this one leaves the view */
+	distance = velocity > 0 ?
+		page - pixbuf_cache->start_page :
+		pixbuf_cache->end_page - page;
+
+	if (*render_time + cost <= (distance + 1) / ABS (velocity)) {
+		*render_time += cost;
+		return FALSE;
+	}
+
+	*render_time += cost * PREVIEW_SCALE * PREVIEW_SCALE;
+
+	return TRUE;
+}
+
 static void
 add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		   CacheJobInfo  *job_info,
 		   gint           page,
 		   gint           rotation,
 		   gfloat         scale,
-		   EvJobPriority  priority)
+		   EvJobPriority  priority,
+		   gdouble        velocity,
+		   gdouble       *render_time)
 {
-	gint width, height;
+	gint     width, height;
+	gboolean preview;
 
-	if (job_info->job)
+	if (job_info->job && !job_info->preview)
 		return;
 
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
@@ -693,6 +1150,31 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 	    cairo_image_surface_get_height (job_info->surface) == height)
 		return;
 
+	preview = page_needs_preview (pixbuf_cache, job_info, page, width, height,
+				      velocity, render_time);
+	if (job_info->job) {
+		if (preview)
+			return;
+
+		/* Scrolling has slowed down, render the whole page instead */
+		g_signal_handlers_disconnect_by_func (job_info->job,
+						      G_CALLBACK (job_finished_cb),
+						      pixbuf_cache);
+		ev_job_cancel (job_info->job);
+		g_object_unref (job_info->job);
+		job_info->job = NULL;
+	}
+
+	if (preview) {
+		/* Keep the page rendered at the previous scale, if any */
+		if (job_info->surface)
+			return;
+
+		_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+						       page, scale * PREVIEW_SCALE, rotation,
+						       &width, &height);
+	}
+
 	/* Free old surfaces for non visible pages */
 	if (priority == EV_JOB_PRIORITY_LOW) {
 		if (job_info->surface) {
@@ -706,74 +1188,170 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		}
 	}
 
-	add_job (pixbuf_cache, job_info, NULL,
+	add_job (pixbuf_cache, job_info, NULL, NULL,
 		 width, height, page, rotation, scale,
-		 priority);
+		 priority, preview);
 }
 
 static void
 add_prev_jobs_if_needed (EvPixbufCache *pixbuf_cache,
                          gint           rotation,
-                         gfloat         scale)
+                         gfloat         scale,
+                         gint           n_pages,
+                         gdouble        velocity,
+                         gdouble       *render_time)
 {
         CacheJobInfo *job_info;
         int page;
         int i;
 
-        for (i = pixbuf_cache->preload_cache_size - 1; i >= FIRST_VISIBLE_PREV(pixbuf_cache); i--) {
+        for (i = pixbuf_cache->preload_cache_size - 1;
+             i >= MAX (FIRST_VISIBLE_PREV (pixbuf_cache), pixbuf_cache->preload_cache_size - n_pages);
+             i--) {
                 job_info = (pixbuf_cache->prev_job + i);
                 page = pixbuf_cache->start_page - pixbuf_cache->preload_cache_size + i;
 
                 add_job_if_needed (pixbuf_cache, job_info,
                                    page, rotation, scale,
-                                   EV_JOB_PRIORITY_LOW);
+                                   EV_JOB_PRIORITY_LOW,
+                                   velocity, render_time);
         }
 }
 
 static void
 add_next_jobs_if_needed (EvPixbufCache *pixbuf_cache,
                          gint           rotation,
-                         gfloat         scale)
+                         gfloat         scale,
+                         gint           n_pages,
+                         gdouble        velocity,
+                         gdouble       *render_time)
 {
         CacheJobInfo *job_info;
         int page;
         int i;
 
-        for (i = 0; i < VISIBLE_NEXT_LEN(pixbuf_cache); i++) {
+        for (i = 0; i < MIN (VISIBLE_NEXT_LEN (pixbuf_cache), n_pages); i++) {
                 job_info = (pixbuf_cache->next_job + i);
                 page = pixbuf_cache->end_page + 1 + i;
 
                 add_job_if_needed (pixbuf_cache, job_info,
                                    page, rotation, scale,
-                                   EV_JOB_PRIORITY_LOW);
+                                   EV_JOB_PRIORITY_LOW,
+                                   velocity, render_time);
         }
 }
 
+static gint
+compare_page_costs (const PageCost *a,
+		    const PageCost *b)
+{
+	if (a->cost != b->cost)
+		return a->cost < b->cost ? -1 : 1;
+
+	return 0;
+}
+
+static gboolean
+settle_cb (EvPixbufCache *pixbuf_cache)
+{
+	pixbuf_cache->settle_id = 0;
+
+	/* Scrolling stopped, replace the previews and preload the pages
+	 * behind the visible ones.
+	 */
+	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache,
+					    ev_document_model_get_rotation (pixbuf_cache->model),
+					    ev_document_model_get_scale (pixbuf_cache->model));
+
+	return FALSE;
+}
+
 static void
 ev_pixbuf_cache_add_jobs_if_needed (EvPixbufCache *pixbuf_cache,
 				    gint           rotation,
 				    gfloat         scale)
 {
-	CacheJobInfo *job_info;
-	int page;
+	PageCost *visible;
+	gint      n_visible;
+	gdouble   velocity;
+	gdouble   render_time = 0;
 	int i;
 
-	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
-		job_info = (pixbuf_cache->job_list + i);
-		page = pixbuf_cache->start_page + i;
+	velocity = ev_pixbuf_cache_get_velocity (pixbuf_cache);
 
-		add_job_if_needed (pixbuf_cache, job_info,
-				   page, rotation, scale,
-				   EV_JOB_PRIORITY_URGENT);
+	n_visible = PAGE_CACHE_LEN (pixbuf_cache);
+	visible = g_new0 (PageCost, n_visible);
+	for (i = 0; i < n_visible; i++) {
+		/* Start with the page that will stay visible the longest */
+		if (velocity > 0)
+			visible[i].page = pixbuf_cache->end_page - i;
+		else
+			visible[i].page = pixbuf_cache->start_page + i;
+
+		if (velocity == 0) {
+			gint width, height;
+
+			_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+							       visible[i].page, scale, rotation,
+							       &width, &height);
+			visible[i].cost = ev_pixbuf_cache_get_page_cost (pixbuf_cache,
+									 visible[i].page,
+									 width, height);
+		}
 	}
 
-        if (pixbuf_cache->scroll_direction == SCROLL_DIRECTION_UP) {
-                add_prev_jobs_if_needed (pixbuf_cache, rotation, scale);
-                add_next_jobs_if_needed (pixbuf_cache, rotation, scale);
-        } else {
-                add_next_jobs_if_needed (pixbuf_cache, rotation, scale);
-                add_prev_jobs_if_needed (pixbuf_cache, rotation, scale);
-        }
+	/* When not scrolling, render the cheap pages first so that most
+	 * of the view is drawn as soon as possible.
+	 */
+	if (velocity == 0)
+		g_qsort_with_data (visible, n_visible, sizeof (PageCost),
+				   (GCompareDataFunc)compare_page_costs, NULL);
+
+	for (i = 0; i < n_visible; i++) {
+		add_job_if_needed (pixbuf_cache,
+				   find_job_cache (pixbuf_cache, visible[i].page),
+				   visible[i].page, rotation, scale,
+				   EV_JOB_PRIORITY_URGENT,
+				   velocity, &render_time);
+	}
+	g_free (visible);
+
+	if (pixbuf_cache->settle_id > 0) {
+		g_source_remove (pixbuf_cache->settle_id);
+		pixbuf_cache->settle_id = 0;
+	}
+
+	if (velocity == 0) {
+		if (pixbuf_cache->scroll_direction == SCROLL_DIRECTION_UP) {
+			add_prev_jobs_if_needed (pixbuf_cache, rotation, scale,
+						 MAX_PRELOADED_PAGES, 0, &render_time);
+			add_next_jobs_if_needed (pixbuf_cache, rotation, scale,
+						 MAX_PRELOADED_PAGES, 0, &render_time);
+		} else {
+			add_next_jobs_if_needed (pixbuf_cache, rotation, scale,
+						 MAX_PRELOADED_PAGES, 0, &render_time);
+			add_prev_jobs_if_needed (pixbuf_cache, rotation, scale,
+						 MAX_PRELOADED_PAGES, 0, &render_time);
+		}
+
+		return;
+	}
+
+	/* While scrolling, only preload the pages ahead */
+	if (velocity < 0) {
+		add_prev_jobs_if_needed (pixbuf_cache, rotation, scale,
+					 pixbuf_cache->preload_cache_size,
+					 velocity, &render_time);
+	} else {
+		add_next_jobs_if_needed (pixbuf_cache, rotation, scale,
+					 pixbuf_cache->preload_cache_size,
+					 velocity, &render_time);
+	}
+
+	pixbuf_cache->settle_id =
+		g_timeout_add (SCROLL_SETTLE_TIME / 1000 + 1,
+			       (GSourceFunc)settle_cb,
+			       pixbuf_cache);
 }
 
 static ScrollDirection
@@ -812,6 +1390,9 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	g_return_if_fail (end_page >= start_page);
 
         pixbuf_cache->scroll_direction = ev_pixbuf_cache_get_scroll_direction (pixbuf_cache, start_page, end_page);
+	ev_pixbuf_cache_update_velocity (pixbuf_cache, start_page);
+	pixbuf_cache->reclaimed = FALSE;
+	ev_memory_governor_touch (pixbuf_cache->memory_consumer);
 
 	/* First, resize the page_range as needed.  We cull old pages
 	 * mercilessly. */
@@ -867,6 +1448,17 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 {
 	CacheJobInfo *job_info;
 
+	/* Render again the pages released to save memory
+	 * now that the view is drawn.
+	 */
+	if (pixbuf_cache->reclaimed) {
+		pixbuf_cache->reclaimed = FALSE;
+		ev_memory_governor_touch (pixbuf_cache->memory_consumer);
+		ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache,
+						    ev_document_model_get_rotation (pixbuf_cache->model),
+						    ev_document_model_get_scale (pixbuf_cache->model));
+	}
+
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return NULL;
@@ -879,11 +1471,113 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	    EV_JOB_RENDER (job_info->job)->page_ready) {
 		copy_job_to_job_info (EV_JOB_RENDER (job_info->job), job_info, pixbuf_cache);
 		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+
+		if (job_info->preview)
+			preview_finished (pixbuf_cache);
 	}
 
 	return job_info->surface;
 }
 
+/* Estimated time left to render the job of @job_info, in seconds */
+static gdouble
+job_info_get_time_remaining (EvPixbufCache *pixbuf_cache,
+			     CacheJobInfo  *job_info,
+			     gint64         now)
+{
+	EvJobRender *job_render = EV_JOB_RENDER (job_info->job);
+	gint         width = job_render->target_width;
+	gint         height = job_render->target_height;
+	gdouble      cost;
+
+	if (job_render->page_ready)
+		return 0;
+
+	if (job_info->preview) {
+		width = MAX (width * PREVIEW_SCALE, 1);
+		height = MAX (height * PREVIEW_SCALE, 1);
+	}
+	cost = ev_pixbuf_cache_get_page_cost (pixbuf_cache, job_render->page, width, height);
+
+	if (job_render->start_time > 0)
+		cost -= (gdouble)(now - job_render->start_time) / G_USEC_PER_SEC;
+
+	return MAX (cost, 0);
+}
+
+/* Time @job_info has to wait for @info, if it's running or was queued before */
+static gdouble
+job_info_get_wait_time (EvPixbufCache *pixbuf_cache,
+			CacheJobInfo  *job_info,
+			CacheJobInfo  *info,
+			gint64         now)
+{
+	if (info == job_info || !info->job)
+		return 0;
+
+	if (EV_JOB_RENDER (info->job)->start_time == 0 &&
+	    info->queued_time > job_info->queued_time)
+		return 0;
+
+	return job_info_get_time_remaining (pixbuf_cache, info, now);
+}
+
+/* Estimated time the jobs running or queued before @job_info still need */
+static gdouble
+ev_pixbuf_cache_get_queue_time (EvPixbufCache *pixbuf_cache,
+				CacheJobInfo  *job_info,
+				gint64         now)
+{
+	gdouble time = 0;
+	gint    i;
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		time += job_info_get_wait_time (pixbuf_cache, job_info, pixbuf_cache->prev_job + i, now);
+		time += job_info_get_wait_time (pixbuf_cache, job_info, pixbuf_cache->next_job + i, now);
+	}
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+		time += job_info_get_wait_time (pixbuf_cache, job_info, pixbuf_cache->job_list + i, now);
+	}
+
+	return time;
+}
+
+/* Estimated time until the page being rendered is ready, in seconds,
+ * 0 when it's unknown or the page isn't being rendered. It's the time
+ * left to render the page, the time it has to wait for the jobs queued
+ * before it, and when a preview is being rendered, the time to render
+ * the page at full scale after it.
+ */
+gdouble
+ev_pixbuf_cache_get_time_remaining (EvPixbufCache *pixbuf_cache,
+				    gint           page)
+{
+	CacheJobInfo *job_info;
+	EvJobRender  *job_render;
+	gint64        now;
+	gdouble       time;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (!job_info || !job_info->job)
+		return 0;
+
+	job_render = EV_JOB_RENDER (job_info->job);
+	if (job_render->page_ready)
+		return 0;
+
+	now = g_get_monotonic_time ();
+	time = job_info_get_time_remaining (pixbuf_cache, job_info, now);
+	if (job_render->start_time == 0)
+		time += ev_pixbuf_cache_get_queue_time (pixbuf_cache, job_info, now);
+	if (job_info->preview)
+		time += ev_pixbuf_cache_get_page_cost (pixbuf_cache, page,
+						       job_render->target_width,
+						       job_render->target_height);
+
+	return time;
+}
+
 static gboolean
 new_selection_surface_needed (EvPixbufCache *pixbuf_cache,
 			      CacheJobInfo  *job_info,
@@ -952,6 +1646,158 @@ ev_pixbuf_cache_clear (EvPixbufCache *pixbuf_cache)
 	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
 		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
 	}
+
+	ev_pixbuf_cache_update_memory_usage (pixbuf_cache);
+}
+
+/* Moves the rendered pages out of the cache into a new state */
+static void
+ev_pixbuf_cache_retain_layers_state (EvPixbufCache *pixbuf_cache)
+{
+	LayersState *state;
+	GList       *l, *last;
+	gint         page;
+
+	for (l = pixbuf_cache->layers_states; l; l = g_list_next (l)) {
+		state = l->data;
+		if (strcmp (state->key, pixbuf_cache->layers_key) == 0) {
+			layers_state_free (state);
+			pixbuf_cache->layers_states = g_list_delete_link (pixbuf_cache->layers_states, l);
+			break;
+		}
+	}
+
+	state = g_slice_new (LayersState);
+	state->key = g_strdup (pixbuf_cache->layers_key);
+	state->rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+	state->scale = ev_document_model_get_scale (pixbuf_cache->model);
+	state->inverted_colors = pixbuf_cache->inverted_colors;
+	state->surfaces = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+						 (GDestroyNotify)cairo_surface_destroy);
+
+	for (page = MAX (0, pixbuf_cache->start_page - pixbuf_cache->preload_cache_size);
+	     page <= pixbuf_cache->end_page + pixbuf_cache->preload_cache_size;
+	     page++) {
+		CacheJobInfo *job_info;
+
+		job_info = find_job_cache (pixbuf_cache, page);
+		if (!job_info || !job_info->page_ready || !job_info->surface)
+			continue;
+
+		g_hash_table_insert (state->surfaces, GINT_TO_POINTER (page), job_info->surface);
+		job_info->surface = NULL;
+	}
+
+	if (g_hash_table_size (state->surfaces) == 0) {
+		layers_state_free (state);
+		return;
+	}
+
+	pixbuf_cache->layers_states = g_list_prepend (pixbuf_cache->layers_states, state);
+	if (g_list_length (pixbuf_cache->layers_states) > MAX_LAYERS_STATES) {
+		last = g_list_last (pixbuf_cache->layers_states);
+		layers_state_free (last->data);
+		pixbuf_cache->layers_states = g_list_delete_link (pixbuf_cache->layers_states, last);
+	}
+}
+
+/* Forgets @page in the kept states, it changed and their surfaces of it
+ * are stale whatever the visibility of the layers */
+static void
+ev_pixbuf_cache_drop_layers_page (EvPixbufCache *pixbuf_cache,
+				  gint           page)
+{
+	GList *l, *next;
+
+	for (l = pixbuf_cache->layers_states; l; l = next) {
+		LayersState *state = l->data;
+
+		next = g_list_next (l);
+		g_hash_table_remove (state->surfaces, GINT_TO_POINTER (page));
+		if (g_hash_table_size (state->surfaces) == 0) {
+			layers_state_free (state);
+			pixbuf_cache->layers_states = g_list_delete_link (pixbuf_cache->layers_states, l);
+		}
+	}
+}
+
+/* Puts back the pages of the current state, if we kept them */
+static void
+ev_pixbuf_cache_restore_layers_state (EvPixbufCache *pixbuf_cache)
+{
+	LayersState   *state = NULL;
+	GHashTableIter iter;
+	gpointer       key, value;
+	GList         *l;
+
+	for (l = pixbuf_cache->layers_states; l; l = g_list_next (l)) {
+		state = l->data;
+		if (strcmp (state->key, pixbuf_cache->layers_key) == 0)
+			break;
+	}
+	if (!l)
+		return;
+
+	pixbuf_cache->layers_states = g_list_delete_link (pixbuf_cache->layers_states, l);
+
+	if (state->rotation != ev_document_model_get_rotation (pixbuf_cache->model) ||
+	    state->scale != ev_document_model_get_scale (pixbuf_cache->model)) {
+		layers_state_free (state);
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, state->surfaces);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		CacheJobInfo    *job_info;
+		cairo_surface_t *surface = value;
+
+		job_info = find_job_cache (pixbuf_cache, GPOINTER_TO_INT (key));
+		if (!job_info)
+			continue;
+
+		if (state->inverted_colors != pixbuf_cache->inverted_colors)
+			ev_document_misc_invert_surface (surface);
+
+		job_info->surface = cairo_surface_reference (surface);
+		job_info->page_ready = TRUE;
+		job_info->points_set = FALSE;
+	}
+
+	layers_state_free (state);
+}
+
+/* Drops the rendered pages after the document changed. When what changed
+ * is the visibility of the layers, the pages are kept in case the layers
+ * are set back, and the pages of the new state are reused if we have them.
+ */
+void
+ev_pixbuf_cache_reload (EvPixbufCache *pixbuf_cache)
+{
+	gchar *layers_key;
+
+	layers_key = get_layers_key (pixbuf_cache->document);
+	if (!layers_key || !pixbuf_cache->layers_key ||
+	    strcmp (layers_key, pixbuf_cache->layers_key) == 0) {
+		/* Something else changed, none of the pages is valid anymore */
+		g_free (pixbuf_cache->layers_key);
+		pixbuf_cache->layers_key = layers_key;
+		ev_pixbuf_cache_drop_layers_states (pixbuf_cache);
+		ev_pixbuf_cache_clear (pixbuf_cache);
+
+		return;
+	}
+
+	if (pixbuf_cache->job_list)
+		ev_pixbuf_cache_retain_layers_state (pixbuf_cache);
+	ev_pixbuf_cache_clear (pixbuf_cache);
+
+	g_free (pixbuf_cache->layers_key);
+	pixbuf_cache->layers_key = layers_key;
+
+	if (pixbuf_cache->job_list)
+		ev_pixbuf_cache_restore_layers_state (pixbuf_cache);
+
+	ev_pixbuf_cache_update_memory_usage (pixbuf_cache);
 }
 
 
@@ -994,6 +1840,29 @@ ev_pixbuf_cache_style_changed (EvPixbufCache *pixbuf_cache)
 	}
 }
 
+static gboolean
+selection_retry_cb (EvPixbufCache *pixbuf_cache)
+{
+	pixbuf_cache->selection_retry_id = 0;
+
+	/* Redraw, the selection will be updated if the document is idle now */
+	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, NULL);
+
+	return FALSE;
+}
+
+static void
+schedule_selection_retry (EvPixbufCache *pixbuf_cache)
+{
+	if (pixbuf_cache->selection_retry_id > 0)
+		return;
+
+	pixbuf_cache->selection_retry_id =
+		g_timeout_add (SELECTION_RETRY_INTERVAL,
+			       (GSourceFunc)selection_retry_cb,
+			       pixbuf_cache);
+}
+
 cairo_surface_t *
 ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 				       gint             page,
@@ -1024,9 +1893,10 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 	clear_selection_surface_if_needed (pixbuf_cache, job_info, page, scale);
 
 	/* Finally, we see if the two scales are the same, and get a new pixbuf
-	 * if needed.  We do this synchronously for now.  At some point, we
-	 * _should_ be able to get rid of the doc_mutex, so the synchronicity
-	 * doesn't kill us.  Rendering a few glyphs should really be fast.
+	 * if needed.  We do this synchronously, rendering a few glyphs should
+	 * really be fast, but never wait for the doc_mutex: if a job is using
+	 * the document we keep showing the previous selection and try again
+	 * a bit later.
 	 */
 	if (ev_rect_cmp (&(job_info->target_points), &(job_info->selection_points))) {
 		EvRectangle *old_points;
@@ -1034,8 +1904,12 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 		EvRenderContext *rc;
 		EvPage *ev_page;
 
+		if (!ev_document_doc_mutex_trylock ()) {
+			schedule_selection_retry (pixbuf_cache);
+			return job_info->selection;
+		}
+
 		/* we need to get a new selection pixbuf */
-		ev_document_doc_mutex_lock ();
 		if (job_info->selection_points.x1 < 0) {
 			g_assert (job_info->selection == NULL);
 			old_points = NULL;
@@ -1099,7 +1973,12 @@ ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 		EvRenderContext *rc;
 		EvPage *ev_page;
 
-		ev_document_doc_mutex_lock ();
+		if (!ev_document_doc_mutex_trylock ()) {
+			schedule_selection_retry (pixbuf_cache);
+			return job_info->selection_region && !cairo_region_is_empty (job_info->selection_region) ?
+				job_info->selection_region : NULL;
+		}
+
 		ev_page = ev_document_get_page (pixbuf_cache->document, page);
 		rc = ev_render_context_new (ev_page, 0, scale);
 		g_object_unref (ev_page);
@@ -1301,6 +2180,48 @@ ev_pixbuf_cache_get_selection_list (EvPixbufCache *pixbuf_cache)
 	return g_list_reverse (retval);
 }
 
+/* Converts @region from window coordinates to pixels of the rendered page.
+ * It's grown a bit to cover the antialiasing around the edited area.
+ */
+static cairo_region_t *
+get_page_damage (EvPixbufCache  *pixbuf_cache,
+		 cairo_region_t *region,
+		 gint            page,
+		 gint            width,
+		 gint            height)
+{
+	EvView               *view = EV_VIEW (pixbuf_cache->view);
+	GdkRectangle          page_area;
+	GtkBorder             border;
+	cairo_rectangle_int_t page_rect = { 0, 0, width, height };
+	cairo_region_t       *damage;
+	gint                  n_rects, i;
+
+	if (!ev_view_get_page_extents (view, page, &page_area, &border))
+		return NULL;
+
+	damage = cairo_region_create ();
+	n_rects = cairo_region_num_rectangles (region);
+	for (i = 0; i < n_rects; i++) {
+		cairo_rectangle_int_t rect;
+
+		cairo_region_get_rectangle (region, i, &rect);
+		rect.x += view->scroll_x - page_area.x - border.left - DAMAGE_MARGIN;
+		rect.y += view->scroll_y - page_area.y - border.top - DAMAGE_MARGIN;
+		rect.width += 2 * DAMAGE_MARGIN;
+		rect.height += 2 * DAMAGE_MARGIN;
+		cairo_region_union_rectangle (damage, &rect);
+	}
+	cairo_region_intersect_rectangle (damage, &page_rect);
+
+	if (cairo_region_is_empty (damage)) {
+		cairo_region_destroy (damage);
+		return NULL;
+	}
+
+	return damage;
+}
+
 void
 ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 			     cairo_region_t *region,
@@ -1308,9 +2229,12 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 			     gint            rotation,
 			     gdouble         scale)
 {
-	CacheJobInfo *job_info;
+	CacheJobInfo   *job_info;
+	cairo_region_t *damage = NULL;
         gint width, height;
 
+	ev_pixbuf_cache_drop_layers_page (pixbuf_cache, page);
+
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return;
@@ -1318,9 +2242,21 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
-        add_job (pixbuf_cache, job_info, region,
+
+	/* When the page is already rendered at this size, only the
+	 * damaged area is rendered again and painted over it
+	 */
+	if (region && !job_info->job && job_info->surface &&
+	    cairo_image_surface_get_width (job_info->surface) == width &&
+	    cairo_image_surface_get_height (job_info->surface) == height)
+		damage = get_page_damage (pixbuf_cache, region, page, width, height);
+
+        add_job (pixbuf_cache, job_info, region, damage,
 		 width, height, page, rotation, scale,
-		 EV_JOB_PRIORITY_URGENT);
+		 EV_JOB_PRIORITY_URGENT, FALSE);
+
+	if (damage)
+		cairo_region_destroy (damage);
 }
 
 
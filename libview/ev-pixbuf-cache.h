@@ -68,7 +68,10 @@ void           ev_pixbuf_cache_set_page_range       (EvPixbufCache *pixbuf_cache
 						     GList          *selection_list);
 cairo_surface_t *ev_pixbuf_cache_get_surface        (EvPixbufCache *pixbuf_cache,
 						     gint           page);
+gdouble        ev_pixbuf_cache_get_time_remaining   (EvPixbufCache *pixbuf_cache,
+						     gint           page);
 void           ev_pixbuf_cache_clear                (EvPixbufCache *pixbuf_cache);
+void           ev_pixbuf_cache_reload               (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_style_changed        (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_reload_page 	    (EvPixbufCache  *pixbuf_cache,
 						     cairo_region_t *region,
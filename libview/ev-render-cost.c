@@ -0,0 +1,134 @@
+/* ev-render-cost.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "ev-render-cost.h"
+
+#define EV_RENDER_COST_KEY "ev-render-cost"
+
+/* Pages are rendered from the job threads and the costs are used
+ * from the main thread, so the model is protected by a mutex.
+ */
+struct _EvRenderCost {
+	GMutex  mutex;
+	gint    n_pages;
+	gfloat *page_costs; /* Microseconds per pixel, 0 if unknown */
+	gdouble mean_cost;
+};
+
+static GMutex render_cost_mutex;
+
+static void
+ev_render_cost_free (EvRenderCost *cost)
+{
+	g_mutex_clear (&cost->mutex);
+	g_free (cost->page_costs);
+	g_slice_free (EvRenderCost, cost);
+}
+
+/*
+ * ev_render_cost_get_for_document:
+ * @document: an #EvDocument
+ *
+ * Returns: (transfer none): the cost model of @document, created the
+ * first time it's needed and freed with the document.
+ */
+EvRenderCost *
+ev_render_cost_get_for_document (EvDocument *document)
+{
+	EvRenderCost *cost;
+
+	g_mutex_lock (&render_cost_mutex);
+
+	cost = g_object_get_data (G_OBJECT (document), EV_RENDER_COST_KEY);
+	if (!cost) {
+		cost = g_slice_new0 (EvRenderCost);
+		g_mutex_init (&cost->mutex);
+		cost->n_pages = ev_document_get_n_pages (document);
+		cost->page_costs = g_new0 (gfloat, MAX (cost->n_pages, 1));
+		g_object_set_data_full (G_OBJECT (document), EV_RENDER_COST_KEY,
+					cost, (GDestroyNotify)ev_render_cost_free);
+	}
+
+	g_mutex_unlock (&render_cost_mutex);
+
+	return cost;
+}
+
+/*
+ * ev_render_cost_record:
+ * @cost: an #EvRenderCost
+ * @page: the index of the page
+ * @width: the width of the rendered page, in pixels
+ * @height: the height of the rendered page, in pixels
+ * @render_time: the time it took to render the page, in microseconds
+ */
+void
+ev_render_cost_record (EvRenderCost *cost,
+		       gint          page,
+		       gint          width,
+		       gint          height,
+		       gint64        render_time)
+{
+	gdouble page_cost;
+
+	if (page < 0 || page >= cost->n_pages || width <= 0 || height <= 0)
+		return;
+
+	page_cost = (gdouble)render_time / ((gdouble)width * height);
+
+	g_mutex_lock (&cost->mutex);
+	cost->page_costs[page] = page_cost;
+	/* Follow the recent pages, the cost of the document changes
+	 * from one part to another.
+	 */
+	cost->mean_cost = cost->mean_cost > 0 ?
+		(3 * cost->mean_cost + page_cost) / 4 : page_cost;
+	g_mutex_unlock (&cost->mutex);
+}
+
+/*
+ * ev_render_cost_estimate:
+ * @cost: an #EvRenderCost
+ * @page: the index of the page
+ * @width: the width of the page to render, in pixels
+ * @height: the height of the page to render, in pixels
+ *
+ * Pages not rendered yet are estimated from the pages rendered recently.
+ *
+ * Returns: the estimated time to render the page in microseconds, or 0
+ * if no page has been rendered yet.
+ */
+gint64
+ev_render_cost_estimate (EvRenderCost *cost,
+			 gint          page,
+			 gint          width,
+			 gint          height)
+{
+	gdouble page_cost = 0;
+
+	g_mutex_lock (&cost->mutex);
+	if (page >= 0 && page < cost->n_pages)
+		page_cost = cost->page_costs[page];
+	if (page_cost == 0)
+		page_cost = cost->mean_cost;
+	g_mutex_unlock (&cost->mutex);
+
+	return (gint64)(page_cost * width * height);
+}
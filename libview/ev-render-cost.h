@@ -0,0 +1,52 @@
+/* ev-render-cost.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_RENDER_COST_H
+#define EV_RENDER_COST_H
+
+#include <glib.h>
+
+#include "ev-document.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The time the pages of a document took to render, shared by all the
+ * views of the document. The time is stored per pixel, so that it can
+ * be used to estimate the cost of rendering the page at another scale.
+ */
+typedef struct _EvRenderCost EvRenderCost;
+
+EvRenderCost *ev_render_cost_get_for_document (EvDocument   *document);
+void          ev_render_cost_record           (EvRenderCost *cost,
+					       gint          page,
+					       gint          width,
+					       gint          height,
+					       gint64        render_time);
+gint64        ev_render_cost_estimate         (EvRenderCost *cost,
+					       gint          page,
+					       gint          width,
+					       gint          height);
+
+G_END_DECLS
+
+#endif /* EV_RENDER_COST_H */
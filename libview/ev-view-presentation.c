@@ -27,6 +27,7 @@
 #include "ev-view-presentation.h"
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
+#include "ev-memory-governor.h"
 #include "ev-transition-animation.h"
 #include "ev-view-cursor.h"
 #include "ev-page-cache.h"
@@ -90,6 +91,8 @@ struct _EvViewPresentation
 	EvJob *prev_job;
 	EvJob *curr_job;
 	EvJob *next_job;
+
+	EvMemoryConsumer *memory_consumer;
 };
 
 struct _EvViewPresentationClass
@@ -326,6 +329,67 @@ ev_view_presentation_animation_start (EvViewPresentation *pview,
 				  pview);
 }
 
+/* Memory */
+static gsize
+job_get_surface_size (EvJob *job)
+{
+	cairo_surface_t *surface;
+
+	if (!job || !ev_job_is_finished (job))
+		return 0;
+
+	surface = EV_JOB_RENDER (job)->surface;
+	if (!surface || cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return 0;
+
+	return cairo_image_surface_get_stride (surface) * cairo_image_surface_get_height (surface);
+}
+
+static void
+ev_view_presentation_update_memory_usage (EvViewPresentation *pview)
+{
+	gsize usage;
+
+	if (!pview->memory_consumer)
+		return;
+
+	usage = job_get_surface_size (pview->prev_job) +
+		job_get_surface_size (pview->curr_job) +
+		job_get_surface_size (pview->next_job);
+	if (pview->current_surface &&
+	    (!pview->curr_job || pview->current_surface != EV_JOB_RENDER (pview->curr_job)->surface) &&
+	    cairo_surface_get_type (pview->current_surface) == CAIRO_SURFACE_TYPE_IMAGE) {
+		usage += cairo_image_surface_get_stride (pview->current_surface) *
+			cairo_image_surface_get_height (pview->current_surface);
+	}
+
+	ev_memory_governor_set_usage (pview->memory_consumer, usage);
+}
+
+static void ev_view_presentation_delete_job (EvViewPresentation *pview,
+					     EvJob              *job);
+
+static gsize
+ev_view_presentation_reclaim (EvViewPresentation *pview,
+			      gsize               bytes)
+{
+	gsize freed;
+
+	/* The current page is always shown, only the prerendered pages
+	 * can be released, they are rendered again when moving.
+	 */
+	freed = job_get_surface_size (pview->prev_job) + job_get_surface_size (pview->next_job);
+
+	ev_view_presentation_delete_job (pview, pview->prev_job);
+	pview->prev_job = NULL;
+	ev_view_presentation_delete_job (pview, pview->next_job);
+	pview->next_job = NULL;
+
+	ev_view_presentation_update_memory_usage (pview);
+
+	return freed;
+}
+
 /* Page Navigation */
 static void
 job_finished_cb (EvJob              *job,
@@ -336,6 +400,8 @@ job_finished_cb (EvJob              *job,
 	if (pview->inverted_colors)
 		ev_document_misc_invert_surface (job_render->surface);
 
+	ev_view_presentation_update_memory_usage (pview);
+
 	if (job != pview->curr_job)
 		return;
 
@@ -398,6 +464,8 @@ ev_view_presentation_reset_jobs (EvViewPresentation *pview)
                 ev_view_presentation_delete_job (pview, pview->next_job);
                 pview->next_job = NULL;
         }
+
+        ev_view_presentation_update_memory_usage (pview);
 }
 
 static void
@@ -488,6 +556,8 @@ ev_view_presentation_update_current_page (EvViewPresentation *pview,
 		}
 	}
 
+	ev_view_presentation_update_memory_usage (pview);
+
 	if (pview->current_page != page) {
 		pview->current_page = page;
 		g_object_notify (G_OBJECT (pview), "current-page");
@@ -952,6 +1022,8 @@ ev_view_presentation_update_current_surface (EvViewPresentation *pview,
 	if (pview->current_surface)
 		cairo_surface_destroy (pview->current_surface);
 	pview->current_surface = surface;
+
+	ev_view_presentation_update_memory_usage (pview);
 }
 
 static void
@@ -964,6 +1036,11 @@ ev_view_presentation_dispose (GObject *object)
 		pview->document = NULL;
 	}
 
+	if (pview->memory_consumer) {
+		ev_memory_governor_unregister (pview->memory_consumer);
+		pview->memory_consumer = NULL;
+	}
+
 	ev_view_presentation_animation_cancel (pview);
 	ev_view_presentation_transition_stop (pview);
 	ev_view_presentation_hide_cursor_timeout_stop (pview);
@@ -1556,6 +1633,12 @@ ev_view_presentation_init (EvViewPresentation *pview)
 {
 	gtk_widget_set_can_focus (GTK_WIDGET (pview), TRUE);
         pview->is_constructing = TRUE;
+
+	pview->memory_consumer =
+		ev_memory_governor_register ("EvViewPresentation",
+					     EV_MEMORY_PRIORITY_LOW,
+					     (EvMemoryReclaimFunc)ev_view_presentation_reclaim,
+					     pview);
 }
 
 GtkWidget *
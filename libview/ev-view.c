@@ -6648,6 +6648,29 @@ ev_view_is_loading (EvView *view)
 	return view->loading;
 }
 
+/**
+ * ev_view_get_loading_time_remaining:
+ * @view: a #EvView
+ *
+ * Estimates how long it will take to render the current page, from the
+ * time the pages of the document took to render so far.
+ *
+ * Returns: the estimated time in seconds, or 0 if the view isn't loading
+ * or the time is unknown
+ *
+ * Since: 3.10
+ */
+gdouble
+ev_view_get_loading_time_remaining (EvView *view)
+{
+	g_return_val_if_fail (EV_IS_VIEW (view), 0);
+
+	if (!view->loading || !view->pixbuf_cache)
+		return 0;
+
+	return ev_pixbuf_cache_get_time_remaining (view->pixbuf_cache, view->current_page);
+}
+
 static gboolean
 ev_view_autoscroll_cb (EvView *view)
 {
@@ -7006,7 +7029,7 @@ ev_view_reload_page (EvView         *view,
 void
 ev_view_reload (EvView *view)
 {
-	ev_pixbuf_cache_clear (view->pixbuf_cache);
+	ev_pixbuf_cache_reload (view->pixbuf_cache);
 	view_update_range_and_current_page (view);
 }
 
@@ -52,6 +52,7 @@ EV_DEPRECATED
 void 		ev_view_set_loading         (EvView 	     *view,
 					     gboolean         loading);
 gboolean        ev_view_is_loading          (EvView          *view);
+gdouble         ev_view_get_loading_time_remaining (EvView          *view);
 void            ev_view_reload              (EvView          *view);
 void            ev_view_set_page_cache_size (EvView          *view,
 					     gsize            cache_size);
@@ -41,6 +41,8 @@
 
 #include "ev-application.h"
 #include "ev-file-helpers.h"
+#include "ev-display-list.h"
+#include "ev-memory-governor.h"
 #include "ev-stock-icons.h"
 
 #ifdef ENABLE_DBUS
@@ -55,10 +57,15 @@ struct _EvApplication {
 
 	gchar *dot_dir;
 
+	/* Whether this process opens all the documents */
+	gboolean single_process;
+
 #ifdef ENABLE_DBUS
         EvEvinceApplication *skeleton;
 	EvMediaPlayerKeys *keys;
-	gboolean doc_registered;
+	GHashTable *registered_uris;
+	/* Documents waiting for the daemon before being opened */
+	guint n_pending_registrations;
 #endif
 
 #ifdef WITH_SMCLIENT
@@ -79,8 +86,18 @@ G_DEFINE_TYPE (EvApplication, ev_application, GTK_TYPE_APPLICATION)
 #define EVINCE_DAEMON_SERVICE        "org.gnome.evince.Daemon"
 #define EVINCE_DAEMON_OBJECT_PATH    "/org/gnome/evince/Daemon"
 #define EVINCE_DAEMON_INTERFACE      "org.gnome.evince.Daemon"
+
+#define EVINCE_HOST_APPLICATION_ID   "org.gnome.evince.Host"
+/* Name of a document opened by the host, from its pid and a counter */
+#define EVINCE_DOCUMENT_NAME_FORMAT  "org.gnome.evince.Document.p%d_%u"
 #endif
 
+#define GS_SCHEMA_NAME               "org.gnome.Evince"
+#define GS_SINGLE_PROCESS            "single-process"
+#define GS_MAP_DOCUMENTS             "map-documents"
+#define GS_DISPLAY_LIST_PAGES        "display-list-pages"
+#define GS_MEMORY_BUDGET             "memory-budget"
+
 static void _ev_application_open_uri_at_dest (EvApplication  *application,
 					      const gchar    *uri,
 					      GdkScreen      *screen,
@@ -107,12 +124,35 @@ static void ev_application_open_uri_in_window (EvApplication  *application,
 EvApplication *
 ev_application_new (void)
 {
-  const GApplicationFlags flags = G_APPLICATION_NON_UNIQUE;
+  GApplicationFlags flags = G_APPLICATION_NON_UNIQUE;
+  const gchar *application_id = NULL;
+  EvApplication *application;
+  GSettings *settings;
+
+  settings = g_settings_new (GS_SCHEMA_NAME);
+
+  ev_file_set_map_enabled (g_settings_get_boolean (settings, GS_MAP_DOCUMENTS));
+  ev_display_list_set_max_pages (g_settings_get_uint (settings, GS_DISPLAY_LIST_PAGES));
+  ev_memory_governor_set_budget ((gsize)g_settings_get_uint (settings, GS_MEMORY_BUDGET) * 1024 * 1024);
+
+#ifdef ENABLE_DBUS
+  /* In single process mode the first instance owns a well known name
+   * and every other instance forwards its documents to it.
+   */
+  if (g_settings_get_boolean (settings, GS_SINGLE_PROCESS)) {
+          flags = G_APPLICATION_HANDLES_OPEN;
+          application_id = EVINCE_HOST_APPLICATION_ID;
+  }
+#endif
+  g_object_unref (settings);
+
+  application = g_object_new (EV_TYPE_APPLICATION,
+                              "application-id", application_id,
+                              "flags", flags,
+                              NULL);
+  application->single_process = application_id != NULL;
 
-  return g_object_new (EV_TYPE_APPLICATION,
-                       "application-id", NULL,
-                       "flags", flags,
-                       NULL);
+  return application;
 }
 
 /* Session */
@@ -344,6 +384,72 @@ ev_application_get_empty_window (EvApplication *application,
 
 
 #ifdef ENABLE_DBUS
+/* A document registered with the evince daemon. In single process mode
+ * every document is registered with a well-known name of its own, owned
+ * on the connection of the application, so that the daemon reports a
+ * different owner for each of them: D-Bus clients like SyncTeX editors
+ * ask the owner of a document for its windows, and expect to get the
+ * windows showing that document only.
+ */
+typedef struct {
+	gchar *uri;
+	gchar *name;
+	guint  owner_id;
+	gboolean name_acquired;
+
+	/* The EvRegisterDocData of the registration in progress */
+	gpointer pending;
+} EvRegisteredDoc;
+
+static EvRegisteredDoc *
+ev_registered_doc_new (const gchar *uri)
+{
+	EvRegisteredDoc *doc;
+
+	doc = g_new0 (EvRegisteredDoc, 1);
+	doc->uri = g_strdup (uri);
+
+	return doc;
+}
+
+static void
+ev_registered_doc_free (EvRegisteredDoc *doc)
+{
+	if (!doc)
+		return;
+
+	if (doc->owner_id > 0)
+		g_bus_unown_name (doc->owner_id);
+	g_free (doc->name);
+	g_free (doc->uri);
+	g_free (doc);
+}
+
+/* Returns the document whose name @invocation was sent to, if any */
+static EvRegisteredDoc *
+ev_application_lookup_document_for_invocation (EvApplication         *application,
+					       GDBusMethodInvocation *invocation)
+{
+	GHashTableIter   iter;
+	EvRegisteredDoc *doc;
+	const gchar     *destination;
+
+	if (!application->registered_uris)
+		return NULL;
+
+	destination = g_dbus_message_get_destination (g_dbus_method_invocation_get_message (invocation));
+	if (!destination)
+		return NULL;
+
+	g_hash_table_iter_init (&iter, application->registered_uris);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&doc)) {
+		if (g_strcmp0 (doc->name, destination) == 0)
+			return doc;
+	}
+
+	return NULL;
+}
+
 typedef struct {
 	gchar          *uri;
 	GdkScreen      *screen;
@@ -351,6 +457,7 @@ typedef struct {
 	EvWindowRunMode mode;
 	gchar          *search_string;
 	guint           timestamp;
+	EvRegisteredDoc *doc;
 } EvRegisterDocData;
 
 static void
@@ -359,6 +466,7 @@ ev_register_doc_data_free (EvRegisterDocData *data)
 	if (!data)
 		return;
 
+	ev_registered_doc_free (data->doc);
 	g_free (data->uri);
 	if (data->search_string)
 		g_free (data->search_string);
@@ -366,6 +474,143 @@ ev_register_doc_data_free (EvRegisterDocData *data)
 		g_object_unref (data->dest);
 
 	g_free (data);
+
+	EV_APP->n_pending_registrations--;
+}
+
+static void
+ev_application_add_open_args (GVariantBuilder *builder,
+			      const gchar     *uri,
+			      GdkScreen       *screen,
+			      EvLinkDest      *dest,
+			      EvWindowRunMode  mode,
+			      const gchar     *search_string)
+{
+        g_variant_builder_add (builder, "{sv}",
+                               "uri",
+                               g_variant_new_string (uri));
+        g_variant_builder_add (builder, "{sv}",
+                               "display",
+                               g_variant_new_string (gdk_display_get_name (gdk_screen_get_display (screen))));
+        g_variant_builder_add (builder, "{sv}",
+                               "screen",
+                               g_variant_new_int32 (gdk_screen_get_number (screen)));
+	if (dest) {
+                switch (ev_link_dest_get_dest_type (dest)) {
+                case EV_LINK_DEST_TYPE_PAGE_LABEL:
+                        g_variant_builder_add (builder, "{sv}", "page-label",
+                                               g_variant_new_string (ev_link_dest_get_page_label (dest)));
+                        break;
+                case EV_LINK_DEST_TYPE_PAGE:
+                        g_variant_builder_add (builder, "{sv}", "page-index",
+                                               g_variant_new_uint32 (ev_link_dest_get_page (dest)));
+                        break;
+                case EV_LINK_DEST_TYPE_NAMED:
+                        g_variant_builder_add (builder, "{sv}", "named-dest",
+                                               g_variant_new_string (ev_link_dest_get_named_dest (dest)));
+                        break;
+                default:
+                        break;
+                }
+	}
+	if (search_string) {
+                g_variant_builder_add (builder, "{sv}",
+                                       "find-string",
+                                       g_variant_new_string (search_string));
+	}
+	if (mode != EV_WINDOW_MODE_NORMAL) {
+                g_variant_builder_add (builder, "{sv}",
+                                       "mode",
+                                       g_variant_new_uint32 (mode));
+	}
+}
+
+/* Returned strings point to @args */
+static void
+ev_application_parse_open_args (GVariant         *args,
+				const gchar     **uri,
+				GdkScreen       **screen,
+				EvLinkDest      **dest,
+				EvWindowRunMode  *mode,
+				const gchar     **search_string)
+{
+        GVariantIter     iter;
+        const gchar     *key;
+        GVariant        *value;
+        GdkDisplay      *display = NULL;
+        int              screen_number = 0;
+
+        *uri = NULL;
+        *dest = NULL;
+        *mode = EV_WINDOW_MODE_NORMAL;
+        *search_string = NULL;
+
+        g_variant_iter_init (&iter, args);
+
+        while (g_variant_iter_loop (&iter, "{&sv}", &key, &value)) {
+                if (strcmp (key, "uri") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
+                        *uri = g_variant_get_string (value, NULL);
+                } else if (strcmp (key, "display") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
+                        display = ev_display_open_if_needed (g_variant_get_string (value, NULL));
+                } else if (strcmp (key, "screen") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_INT32) {
+                        screen_number = g_variant_get_int32 (value);
+                } else if (strcmp (key, "mode") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_UINT32) {
+                        *mode = g_variant_get_uint32 (value);
+                } else if (strcmp (key, "page-label") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
+                        *dest = ev_link_dest_new_page_label (g_variant_get_string (value, NULL));
+                } else if (strcmp (key, "named-dest") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
+                        *dest = ev_link_dest_new_named (g_variant_get_string (value, NULL));
+                } else if (strcmp (key, "page-index") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_UINT32) {
+                        *dest = ev_link_dest_new_page (g_variant_get_uint32 (value));
+                } else if (strcmp (key, "find-string") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
+                        *search_string = g_variant_get_string (value, NULL);
+                }
+        }
+
+        if (display != NULL &&
+                        screen_number >= 0 &&
+            screen_number < gdk_display_get_n_screens (display))
+                *screen = gdk_display_get_screen (display, screen_number);
+        else
+                *screen = gdk_screen_get_default ();
+}
+
+/* Shows @uri again in the windows that already display it, or in all
+ * the windows when every window shows the same document.
+ */
+static gboolean
+ev_application_reload_uri (EvApplication  *application,
+			   const gchar    *uri,
+			   GdkScreen      *screen,
+			   EvLinkDest     *dest,
+			   EvWindowRunMode mode,
+			   const gchar    *search_string,
+			   guint           timestamp)
+{
+	GList   *windows, *l;
+	gboolean reloaded = FALSE;
+
+	windows = gtk_application_get_windows (GTK_APPLICATION (application));
+	for (l = windows; l != NULL; l = g_list_next (l)) {
+		const gchar *window_uri;
+
+		if (!EV_IS_WINDOW (l->data))
+			continue;
+
+		window_uri = ev_window_get_uri (EV_WINDOW (l->data));
+		if (application->single_process &&
+		    (!window_uri || g_strcmp0 (window_uri, uri) != 0))
+			continue;
+
+		ev_application_open_uri_in_window (application, uri,
+						   EV_WINDOW (l->data),
+						   screen, dest, mode,
+						   search_string,
+						   timestamp);
+		reloaded = TRUE;
+	}
+
+	return reloaded;
 }
 
 static void
@@ -400,6 +645,7 @@ on_register_uri_cb (GObject      *source_object,
 	GDBusConnection   *connection = G_DBUS_CONNECTION (source_object);
 	EvRegisterDocData *data = (EvRegisterDocData *)user_data;
 	EvApplication     *application = EV_APP;
+	EvRegisteredDoc   *doc;
 	GVariant          *value;
 	const gchar       *owner;
 	GVariantBuilder    builder;
@@ -432,7 +678,10 @@ on_register_uri_cb (GObject      *source_object,
 	if (owner[0] == '\0') {
                 g_variant_unref (value);
 
-		application->doc_registered = TRUE;
+		doc = data->doc;
+		data->doc = NULL;
+		doc->pending = NULL;
+		g_hash_table_insert (application->registered_uris, doc->uri, doc);
 
 		_ev_application_open_uri_at_dest (application,
 						  data->uri,
@@ -449,40 +698,9 @@ on_register_uri_cb (GObject      *source_object,
 	/* Already registered */
 	g_variant_builder_init (&builder, G_VARIANT_TYPE ("(a{sv}u)"));
         g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
-        g_variant_builder_add (&builder, "{sv}",
-                               "display",
-                               g_variant_new_string (gdk_display_get_name (gdk_screen_get_display (data->screen))));
-        g_variant_builder_add (&builder, "{sv}",
-                               "screen",
-                               g_variant_new_int32 (gdk_screen_get_number (data->screen)));
-	if (data->dest) {
-                switch (ev_link_dest_get_dest_type (data->dest)) {
-                case EV_LINK_DEST_TYPE_PAGE_LABEL:
-                        g_variant_builder_add (&builder, "{sv}", "page-label",
-                                               g_variant_new_string (ev_link_dest_get_page_label (data->dest)));
-                        break;
-                case EV_LINK_DEST_TYPE_PAGE:
-                        g_variant_builder_add (&builder, "{sv}", "page-index",
-                                               g_variant_new_uint32 (ev_link_dest_get_page (data->dest)));
-                        break;
-                case EV_LINK_DEST_TYPE_NAMED:
-                        g_variant_builder_add (&builder, "{sv}", "named-dest",
-                                               g_variant_new_string (ev_link_dest_get_named_dest (data->dest)));
-                        break;
-                default:
-                        break;
-                }
-	}
-	if (data->search_string) {
-                g_variant_builder_add (&builder, "{sv}",
-                                       "find-string",
-                                       g_variant_new_string (data->search_string));
-	}
-	if (data->mode != EV_WINDOW_MODE_NORMAL) {
-                g_variant_builder_add (&builder, "{sv}",
-                                       "mode",
-                                       g_variant_new_uint32 (data->mode));
-	}
+	ev_application_add_open_args (&builder, data->uri, data->screen,
+				      data->dest, data->mode,
+				      data->search_string);
         g_variant_builder_close (&builder);
 
         g_variant_builder_add (&builder, "u", data->timestamp);
@@ -504,6 +722,83 @@ on_register_uri_cb (GObject      *source_object,
 	ev_register_doc_data_free (data);
 }
 
+static void
+on_document_name_acquired_cb (GDBusConnection *connection,
+			      const gchar     *name,
+			      gpointer         user_data)
+{
+	EvRegisteredDoc   *doc = (EvRegisteredDoc *)user_data;
+	EvRegisterDocData *data = (EvRegisterDocData *)doc->pending;
+
+	if (!data)
+		return;
+
+	doc->name_acquired = TRUE;
+
+	/* The daemon checks that we own the name */
+        g_dbus_connection_call (connection,
+				EVINCE_DAEMON_SERVICE,
+				EVINCE_DAEMON_OBJECT_PATH,
+				EVINCE_DAEMON_INTERFACE,
+				"RegisterDocumentWithOwner",
+				g_variant_new ("(ss)", data->uri, name),
+				G_VARIANT_TYPE ("(s)"),
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				on_register_uri_cb,
+				data);
+}
+
+static void
+on_document_name_lost_cb (GDBusConnection *connection,
+			  const gchar     *name,
+			  gpointer         user_data)
+{
+	EvRegisteredDoc   *doc = (EvRegisteredDoc *)user_data;
+	EvRegisterDocData *data = (EvRegisterDocData *)doc->pending;
+
+	/* Once acquired the name is only lost when
+	 * the connection is closed on exit */
+	if (!data || doc->name_acquired)
+		return;
+
+	g_printerr ("Failed to own name %s for document %s\n", name, data->uri);
+
+	g_bus_unown_name (doc->owner_id);
+	doc->owner_id = 0;
+	g_free (doc->name);
+	doc->name = NULL;
+
+	if (!connection) {
+		_ev_application_open_uri_at_dest (EV_APP,
+						  data->uri,
+						  data->screen,
+						  data->dest,
+						  data->mode,
+						  data->search_string,
+						  data->timestamp);
+		ev_register_doc_data_free (data);
+		g_application_release (g_application_get_default ());
+
+		return;
+	}
+
+	/* Fall back to the unique name of the process as owner */
+        g_dbus_connection_call (connection,
+				EVINCE_DAEMON_SERVICE,
+				EVINCE_DAEMON_OBJECT_PATH,
+				EVINCE_DAEMON_INTERFACE,
+				"RegisterDocument",
+				g_variant_new ("(s)", data->uri),
+				G_VARIANT_TYPE ("(s)"),
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				on_register_uri_cb,
+				data);
+}
+
 /*
  * ev_application_register_uri:
  * @application: The instance of the application.
@@ -534,21 +829,12 @@ ev_application_register_uri (EvApplication  *application,
 		return;
 	}
 
-	if (application->doc_registered) {
+	if (g_hash_table_contains (application->registered_uris, uri)) {
 		/* Already registered, reload */
-		GList *windows, *l;
-
-		windows = gtk_application_get_windows (GTK_APPLICATION (application));
-		for (l = windows; l != NULL; l = g_list_next (l)) {
-                        if (!EV_IS_WINDOW (l->data))
-                                continue;
-
-			ev_application_open_uri_in_window (application, uri,
-                                                           EV_WINDOW (l->data),
-							   screen, dest, mode,
-							   search_string,
-							   timestamp);
-		}
+		if (!ev_application_reload_uri (application, uri, screen, dest, mode,
+						search_string, timestamp))
+			_ev_application_open_uri_at_dest (application, uri, screen, dest, mode,
+							  search_string, timestamp);
 
 		return;
 	}
@@ -560,7 +846,28 @@ ev_application_register_uri (EvApplication  *application,
 	data->mode = mode;
 	data->search_string = search_string ? g_strdup (search_string) : NULL;
 	data->timestamp = timestamp;
+	data->doc = ev_registered_doc_new (uri);
+	data->doc->pending = data;
+
+	application->n_pending_registrations++;
+        g_application_hold (G_APPLICATION (application));
 
+	if (application->single_process) {
+		static guint doc_id = 0;
+
+		data->doc->name = g_strdup_printf (EVINCE_DOCUMENT_NAME_FORMAT,
+						   getpid (), doc_id++);
+		data->doc->owner_id =
+			g_bus_own_name_on_connection (g_application_get_dbus_connection (G_APPLICATION (application)),
+						      data->doc->name,
+						      G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
+						      on_document_name_acquired_cb,
+						      on_document_name_lost_cb,
+						      data->doc, NULL);
+		return;
+	}
+
+	/* The daemon records the sender as the owner of the document */
         g_dbus_connection_call (g_application_get_dbus_connection (G_APPLICATION (application)),
 				EVINCE_DAEMON_SERVICE,
 				EVINCE_DAEMON_OBJECT_PATH,
@@ -573,20 +880,15 @@ ev_application_register_uri (EvApplication  *application,
 				NULL,
 				on_register_uri_cb,
 				data);
-
-        g_application_hold (G_APPLICATION (application));
 }
 
 static void
-ev_application_unregister_uri (EvApplication *application,
-			       const gchar   *uri)
+ev_application_unregister_uri (EvApplication   *application,
+			       EvRegisteredDoc *doc)
 {
         GVariant *value;
 	GError   *error = NULL;
 
-	if (!application->doc_registered)
-		return;
-
 	/* This is called from ev_application_shutdown(),
 	 * so it's safe to use the sync api
 	 */
@@ -596,7 +898,7 @@ ev_application_unregister_uri (EvApplication *application,
 		EVINCE_DAEMON_OBJECT_PATH,
 		EVINCE_DAEMON_INTERFACE,
 		"UnregisterDocument",
-		g_variant_new ("(s)", uri),
+		g_variant_new ("(s)", doc->uri),
 		NULL,
 		G_DBUS_CALL_FLAGS_NO_AUTO_START,
 		-1,
@@ -609,6 +911,115 @@ ev_application_unregister_uri (EvApplication *application,
                 g_variant_unref (value);
 	}
 }
+
+static void
+on_unregister_uri_cb (GObject      *source_object,
+		      GAsyncResult *res,
+		      gpointer      user_data)
+{
+	EvRegisteredDoc *doc = (EvRegisteredDoc *)user_data;
+	GVariant        *value;
+	GError          *error = NULL;
+
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+	if (value == NULL) {
+		g_printerr ("Error unregistering document: %s\n", error->message);
+		g_error_free (error);
+	} else {
+                g_variant_unref (value);
+	}
+
+	ev_registered_doc_free (doc);
+        g_application_release (g_application_get_default ());
+}
+
+static gboolean
+ev_application_has_window_for_uri (EvApplication *application,
+				   const gchar   *uri)
+{
+	GList *windows, *l;
+
+	windows = gtk_application_get_windows (GTK_APPLICATION (application));
+	for (l = windows; l != NULL; l = g_list_next (l)) {
+		if (EV_IS_WINDOW (l->data) &&
+		    g_strcmp0 (ev_window_get_uri (EV_WINDOW (l->data)), uri) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Unregisters the documents not shown by any window anymore,
+ * so that the daemon doesn't report them as open
+ */
+static void
+ev_application_unregister_closed_uris (EvApplication *application)
+{
+	GHashTableIter   iter;
+	EvRegisteredDoc *doc;
+
+	if (!application->registered_uris)
+		return;
+
+	g_hash_table_iter_init (&iter, application->registered_uris);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&doc)) {
+		if (ev_application_has_window_for_uri (application, doc->uri))
+			continue;
+
+		g_hash_table_iter_steal (&iter);
+		g_dbus_connection_call (g_application_get_dbus_connection (G_APPLICATION (application)),
+					EVINCE_DAEMON_SERVICE,
+					EVINCE_DAEMON_OBJECT_PATH,
+					EVINCE_DAEMON_INTERFACE,
+					"UnregisterDocument",
+					g_variant_new ("(s)", doc->uri),
+					NULL,
+					G_DBUS_CALL_FLAGS_NO_AUTO_START,
+					-1,
+					NULL,
+					on_unregister_uri_cb,
+					doc);
+		g_application_hold (G_APPLICATION (application));
+	}
+}
+
+/* Asks the evince process hosting all documents to open @uri */
+static void
+ev_application_open_uri_remote (EvApplication  *application,
+				const gchar    *uri,
+				GdkScreen      *screen,
+				EvLinkDest     *dest,
+				EvWindowRunMode mode,
+				const gchar    *search_string)
+{
+	GVariantBuilder  builder;
+	GVariant        *args;
+	GFile           *file;
+	GDBusConnection *connection;
+	gchar           *hint;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+	ev_application_add_open_args (&builder, uri,
+				      screen ? screen : gdk_screen_get_default (),
+				      dest, mode, search_string);
+	args = g_variant_ref_sink (g_variant_builder_end (&builder));
+	hint = g_variant_print (args, TRUE);
+	g_variant_unref (args);
+
+	file = g_file_new_for_uri (uri);
+	g_application_open (G_APPLICATION (application), &file, 1, hint);
+	g_object_unref (file);
+	g_free (hint);
+
+	/* This process exits right away, make sure the message is sent */
+	connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+	if (connection) {
+		g_dbus_connection_flush_sync (connection, NULL, NULL);
+		g_object_unref (connection);
+	}
+
+	gdk_notify_startup_complete ();
+}
 #endif /* ENABLE_DBUS */
 
 static void
@@ -637,6 +1048,7 @@ ev_application_open_uri_in_window (EvApplication  *application,
 	   we can restore window size without flickering */
 	ev_window_open_uri (ev_window, uri, dest, mode, search_string);
 
+
 	if (!gtk_widget_get_realized (GTK_WIDGET (ev_window)))
 		gtk_widget_realize (GTK_WIDGET (ev_window));
 
@@ -697,10 +1109,20 @@ ev_application_open_uri_at_dest (EvApplication  *application,
 {
 	g_return_if_fail (uri != NULL);
 
-	if (application->uri && strcmp (application->uri, uri) != 0) {
-		/* spawn a new evince process */
-		ev_spawn (uri, screen, dest, mode, search_string, timestamp);
+#ifdef ENABLE_DBUS
+	if (g_application_get_is_remote (G_APPLICATION (application))) {
+		ev_application_open_uri_remote (application, uri, screen, dest,
+						mode, search_string);
 		return;
+	}
+#endif
+
+	if (application->uri && strcmp (application->uri, uri) != 0) {
+		if (!application->single_process) {
+			/* spawn a new evince process */
+			ev_spawn (uri, screen, dest, mode, search_string, timestamp);
+			return;
+		}
 	} else if (!application->uri) {
 		application->uri = g_strdup (uri);
 	}
@@ -761,16 +1183,23 @@ handle_get_window_list_cb (EvEvinceApplication   *object,
                            GDBusMethodInvocation *invocation,
                            EvApplication         *application)
 {
-        GList     *windows, *l;
-        GPtrArray *paths;
+        GList           *windows, *l;
+        GPtrArray       *paths;
+        EvRegisteredDoc *doc;
 
         paths = g_ptr_array_new ();
 
+        /* Asked on the name of a document, only its windows */
+        doc = ev_application_lookup_document_for_invocation (application, invocation);
+
         windows = gtk_application_get_windows (GTK_APPLICATION (application));
         for (l = windows; l; l = g_list_next (l)) {
                 if (!EV_IS_WINDOW (l->data))
                         continue;
 
+                if (doc && g_strcmp0 (ev_window_get_uri (EV_WINDOW (l->data)), doc->uri) != 0)
+                        continue;
+
                 g_ptr_array_add (paths, (gpointer) ev_window_get_dbus_object_path (EV_WINDOW (l->data)));
         }
 
@@ -790,54 +1219,29 @@ handle_reload_cb (EvEvinceApplication   *object,
                   guint                  timestamp,
                   EvApplication         *application)
 {
-        GList           *windows, *l;
-        GVariantIter     iter;
-        const gchar     *key;
-        GVariant        *value;
-        GdkDisplay      *display = NULL;
-        int              screen_number = 0;
-        EvLinkDest      *dest = NULL;
-        EvWindowRunMode  mode = EV_WINDOW_MODE_NORMAL;
-        const gchar     *search_string = NULL;
-        GdkScreen       *screen = NULL;
-
-        g_variant_iter_init (&iter, args);
+        const gchar     *uri;
+        EvLinkDest      *dest;
+        EvWindowRunMode  mode;
+        const gchar     *search_string;
+        GdkScreen       *screen;
 
-        while (g_variant_iter_loop (&iter, "{&sv}", &key, &value)) {
-                if (strcmp (key, "display") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
-                        display = ev_display_open_if_needed (g_variant_get_string (value, NULL));
-                } else if (strcmp (key, "screen") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_INT32) {
-                        screen_number = g_variant_get_int32 (value);
-                } else if (strcmp (key, "mode") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_UINT32) {
-                        mode = g_variant_get_uint32 (value);
-                } else if (strcmp (key, "page-label") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
-                        dest = ev_link_dest_new_page_label (g_variant_get_string (value, NULL));
-                } else if (strcmp (key, "named-dest") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
-                        dest = ev_link_dest_new_named (g_variant_get_string (value, NULL));
-                } else if (strcmp (key, "page-index") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_UINT32) {
-                        dest = ev_link_dest_new_page (g_variant_get_uint32 (value));
-                } else if (strcmp (key, "find-string") == 0 && g_variant_classify (value) == G_VARIANT_CLASS_STRING) {
-                        search_string = g_variant_get_string (value, NULL);
-                }
-        }
+        ev_application_parse_open_args (args, &uri, &screen, &dest, &mode, &search_string);
 
-        if (display != NULL &&
-                        screen_number >= 0 &&
-            screen_number < gdk_display_get_n_screens (display))
-                screen = gdk_display_get_screen (display, screen_number);
-        else
-                screen = gdk_screen_get_default ();
+        /* Older instances don't send the uri, it's the document
+         * the name belongs to, or the one all our windows show
+         */
+        if (!uri || !application->single_process) {
+                EvRegisteredDoc *doc;
 
-        windows = gtk_application_get_windows (GTK_APPLICATION ((application)));
-        for (l = windows; l != NULL; l = g_list_next (l)) {
-                if (!EV_IS_WINDOW (l->data))
-                        continue;
+                doc = ev_application_lookup_document_for_invocation (application, invocation);
+                uri = doc ? doc->uri : application->uri;
+        }
 
-                ev_application_open_uri_in_window (application, NULL,
-                                                   EV_WINDOW (l->data),
-                                                   screen, dest, mode,
-                                                   search_string,
-                                                   timestamp);
+        if (!ev_application_reload_uri (application, uri, screen, dest, mode,
+                                        search_string, timestamp) &&
+            application->single_process) {
+                _ev_application_open_uri_at_dest (application, uri, screen, dest, mode,
+                                                  search_string, timestamp);
         }
 
         if (dest)
@@ -1036,16 +1440,68 @@ ev_application_startup (GApplication *gapplication)
         g_object_unref (builder);
 }
 
+#ifdef ENABLE_DBUS
+static void
+ev_application_open (GApplication *gapplication,
+		     GFile       **files,
+		     gint          n_files,
+		     const gchar  *hint)
+{
+        EvApplication  *application = EV_APPLICATION (gapplication);
+        GVariant       *args;
+        gint            i;
+
+        /* Documents forwarded by another evince process in single process mode */
+        args = g_variant_parse (G_VARIANT_TYPE ("a{sv}"), hint, NULL, NULL, NULL);
+
+        for (i = 0; i < n_files; i++) {
+                const gchar     *uri = NULL;
+                EvLinkDest      *dest = NULL;
+                EvWindowRunMode  mode = EV_WINDOW_MODE_NORMAL;
+                const gchar     *search_string = NULL;
+                GdkScreen       *screen = gdk_screen_get_default ();
+                gchar           *file_uri;
+
+                if (args)
+                        ev_application_parse_open_args (args, &uri, &screen, &dest, &mode, &search_string);
+
+                file_uri = g_file_get_uri (files[i]);
+                ev_application_open_uri_at_dest (application,
+                                                 uri ? uri : file_uri,
+                                                 screen, dest, mode,
+                                                 search_string,
+                                                 GDK_CURRENT_TIME);
+                g_free (file_uri);
+
+                if (dest)
+                        g_object_unref (dest);
+        }
+
+        if (args)
+                g_variant_unref (args);
+}
+#endif /* ENABLE_DBUS */
+
 static void
 ev_application_shutdown (GApplication *gapplication)
 {
         EvApplication *application = EV_APPLICATION (gapplication);
 
-	if (application->uri) {
 #ifdef ENABLE_DBUS
-		ev_application_unregister_uri (application,
-					       application->uri);
+	if (application->registered_uris) {
+		GHashTableIter iter;
+		gpointer       doc;
+
+		g_hash_table_iter_init (&iter, application->registered_uris);
+		while (g_hash_table_iter_next (&iter, NULL, &doc))
+			ev_application_unregister_uri (application, doc);
+
+		g_hash_table_destroy (application->registered_uris);
+		application->registered_uris = NULL;
+	}
 #endif
+
+	if (application->uri) {
 		g_free (application->uri);
 		application->uri = NULL;
 	}
@@ -1064,6 +1520,19 @@ ev_application_activate (GApplication *gapplication)
         EvApplication *application = EV_APPLICATION (gapplication);
         GList *windows, *l;
 
+#ifdef ENABLE_DBUS
+        /* The host is activated without documents by a process that
+         * opened none, unless a document is about to open a window */
+        if (application->single_process &&
+            !g_application_get_is_remote (gapplication) &&
+            application->n_pending_registrations == 0 &&
+            !ev_application_has_window (application)) {
+                ev_application_open_window (application, gdk_screen_get_default (),
+                                            GDK_CURRENT_TIME);
+                return;
+        }
+#endif
+
         windows = gtk_application_get_windows (GTK_APPLICATION (application));
         for (l = windows; l != NULL; l = l->next) {
                 if (!EV_IS_WINDOW (l->data))
@@ -1073,6 +1542,17 @@ ev_application_activate (GApplication *gapplication)
         }
 }
 
+static void
+ev_application_window_removed (GtkApplication *gtk_application,
+			       GtkWindow      *window)
+{
+	GTK_APPLICATION_CLASS (ev_application_parent_class)->window_removed (gtk_application,
+									      window);
+#ifdef ENABLE_DBUS
+	ev_application_unregister_closed_uris (EV_APPLICATION (gtk_application));
+#endif
+}
+
 #ifdef ENABLE_DBUS
 static gboolean
 ev_application_dbus_register (GApplication    *gapplication,
@@ -1139,12 +1619,16 @@ static void
 ev_application_class_init (EvApplicationClass *ev_application_class)
 {
         GApplicationClass *g_application_class = G_APPLICATION_CLASS (ev_application_class);
+        GtkApplicationClass *gtk_application_class = GTK_APPLICATION_CLASS (ev_application_class);
 
         g_application_class->startup = ev_application_startup;
         g_application_class->activate = ev_application_activate;
         g_application_class->shutdown = ev_application_shutdown;
 
+        gtk_application_class->window_removed = ev_application_window_removed;
+
 #ifdef ENABLE_DBUS
+        g_application_class->open = ev_application_open;
         g_application_class->dbus_register = ev_application_dbus_register;
         g_application_class->dbus_unregister = ev_application_dbus_unregister;
 #endif
@@ -1161,6 +1645,13 @@ ev_application_init (EvApplication *ev_application)
 	ev_application_init_session (ev_application);
 
 	ev_application_accel_map_load (ev_application);
+
+#ifdef ENABLE_DBUS
+	ev_application->registered_uris = g_hash_table_new_full (g_str_hash,
+								 g_str_equal,
+								 NULL,
+								 (GDestroyNotify)ev_registered_doc_free);
+#endif
 }
 
 gboolean
@@ -71,6 +71,9 @@ G_DEFINE_TYPE (EvDaemonApplication, ev_daemon_application, G_TYPE_APPLICATION)
 
 typedef struct {
 	gchar *dbus_name;
+	/* Unique name of the process that registered the document, it
+	 * differs from dbus_name when registered with a well-known name */
+	gchar *sender;
 	gchar *uri;
         guint  watch_id;
 	guint  loaded_id;
@@ -83,6 +86,7 @@ ev_doc_free (EvDoc *doc)
 		return;
 
 	g_free (doc->dbus_name);
+	g_free (doc->sender);
 	g_free (doc->uri);
 
         g_bus_unwatch_name (doc->watch_id);
@@ -204,18 +208,20 @@ document_loaded_cb (GDBusConnection *connection,
 	g_variant_get (parameters, "(&s)", &uri);
         doc = ev_daemon_application_find_doc (application, uri);
         if (doc != NULL && strcmp (uri, doc->uri) == 0) {
-		process_pending_invocations (application, uri, sender_name);
+		process_pending_invocations (application, uri, doc->dbus_name);
         }
 
 	g_dbus_connection_signal_unsubscribe (connection, doc->loaded_id);
         doc->loaded_id = 0;
 }
 
-static gboolean
-handle_register_document_cb (EvDaemon              *object,
-                             GDBusMethodInvocation *invocation,
-                             const gchar           *uri,
-                             EvDaemonApplication   *application)
+/* Registers @dbus_name as the owner of @uri, returns the current owner
+ * if it was registered already or "" otherwise */
+static const gchar *
+ev_daemon_application_register_doc (EvDaemonApplication   *application,
+                                    GDBusMethodInvocation *invocation,
+                                    const gchar           *uri,
+                                    const gchar           *dbus_name)
 {
         GDBusConnection *connection;
         const char *sender;
@@ -224,18 +230,18 @@ handle_register_document_cb (EvDaemon              *object,
         doc = ev_daemon_application_find_doc (application, uri);
         if (doc != NULL) {
                 LOG ("RegisterDocument found owner '%s' for URI '%s'\n", doc->dbus_name, uri);
-                ev_daemon_complete_register_document (object, invocation, doc->dbus_name);
 
-                return TRUE;
+                return doc->dbus_name;
         }
 
         sender = g_dbus_method_invocation_get_sender (invocation);
         connection = g_dbus_method_invocation_get_connection (invocation);
 
-        LOG ("RegisterDocument registered owner '%s' for URI '%s'\n", sender, uri);
+        LOG ("RegisterDocument registered owner '%s' for URI '%s'\n", dbus_name, uri);
 
         doc = g_new (EvDoc, 1);
-        doc->dbus_name = g_strdup (sender);
+        doc->dbus_name = g_strdup (dbus_name);
+        doc->sender = g_strdup (sender);
         doc->uri = g_strdup (uri);
 
         application->docs = g_list_prepend (application->docs, doc);
@@ -250,14 +256,105 @@ handle_register_document_cb (EvDaemon              *object,
                                                              document_loaded_cb,
                                                              application, NULL);
         doc->watch_id = g_bus_watch_name_on_connection (connection,
-                                                        sender,
+                                                        doc->dbus_name,
                                                         G_BUS_NAME_WATCHER_FLAGS_NONE,
                                                         name_appeared_cb,
                                                         name_vanished_cb,
                                                         application, NULL);
 
-        ev_daemon_complete_register_document (object, invocation, "");
+        g_application_hold (G_APPLICATION (application));
+
+        return "";
+}
+
+static gboolean
+handle_register_document_cb (EvDaemon              *object,
+                             GDBusMethodInvocation *invocation,
+                             const gchar           *uri,
+                             EvDaemonApplication   *application)
+{
+        const gchar *owner;
 
+        owner = ev_daemon_application_register_doc (application, invocation, uri,
+                                                    g_dbus_method_invocation_get_sender (invocation));
+        ev_daemon_complete_register_document (object, invocation, owner);
+
+        return TRUE;
+}
+
+typedef struct {
+        EvDaemon              *object;
+        GDBusMethodInvocation *invocation;
+        EvDaemonApplication   *application;
+        gchar                 *uri;
+        gchar                 *name;
+} RegisterWithOwnerData;
+
+static void
+get_name_owner_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+        RegisterWithOwnerData *data = user_data;
+        GVariant              *value;
+        const gchar           *name_owner;
+
+        value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, NULL);
+        if (value)
+                g_variant_get (value, "(&s)", &name_owner);
+
+        /* Only the process owning the name can register documents with it */
+        if (!value || strcmp (name_owner, g_dbus_method_invocation_get_sender (data->invocation)) != 0) {
+                LOG ("RegisterDocumentWithOwner name '%s' not owned by the sender\n", data->name);
+                g_dbus_method_invocation_return_error_literal (data->invocation,
+                                                               G_DBUS_ERROR,
+                                                               G_DBUS_ERROR_ACCESS_DENIED,
+                                                               "The name is not owned by the sender");
+        } else {
+                const gchar *owner;
+
+                owner = ev_daemon_application_register_doc (data->application, data->invocation,
+                                                            data->uri, data->name);
+                ev_daemon_complete_register_document_with_owner (data->object, data->invocation, owner);
+        }
+
+        if (value)
+                g_variant_unref (value);
+        g_application_release (G_APPLICATION (data->application));
+        g_object_unref (data->object);
+        g_free (data->uri);
+        g_free (data->name);
+        g_free (data);
+}
+
+static gboolean
+handle_register_document_with_owner_cb (EvDaemon              *object,
+                                        GDBusMethodInvocation *invocation,
+                                        const gchar           *uri,
+                                        const gchar           *name,
+                                        EvDaemonApplication   *application)
+{
+        RegisterWithOwnerData *data;
+
+        data = g_new (RegisterWithOwnerData, 1);
+        data->object = g_object_ref (object);
+        data->invocation = invocation;
+        data->application = application;
+        data->uri = g_strdup (uri);
+        data->name = g_strdup (name);
+
+        g_dbus_connection_call (g_dbus_method_invocation_get_connection (invocation),
+                                "org.freedesktop.DBus",
+                                "/org/freedesktop/DBus",
+                                "org.freedesktop.DBus",
+                                "GetNameOwner",
+                                g_variant_new ("(s)", name),
+                                G_VARIANT_TYPE ("(s)"),
+                                G_DBUS_CALL_FLAGS_NONE,
+                                -1,
+                                NULL,
+                                get_name_owner_cb,
+                                data);
         g_application_hold (G_APPLICATION (application));
 
         return TRUE;
@@ -285,9 +382,9 @@ handle_unregister_document_cb (EvDaemon              *object,
         }
 
         sender = g_dbus_method_invocation_get_sender (invocation);
-        if (strcmp (doc->dbus_name, sender) != 0) {
+        if (strcmp (doc->sender, sender) != 0) {
                 LOG ("UnregisterDocument called by non-owner (owner '%s' sender '%s')\n",
-                     doc->dbus_name, sender);
+                     doc->sender, sender);
 
                 g_dbus_method_invocation_return_error_literal (invocation,
                                                                G_DBUS_ERROR,
@@ -388,6 +485,8 @@ ev_daemon_application_dbus_register (GApplication    *gapplication,
         application->daemon = skeleton;
         g_signal_connect (skeleton, "handle-register-document",
                           G_CALLBACK (handle_register_document_cb), application);
+        g_signal_connect (skeleton, "handle-register-document-with-owner",
+                          G_CALLBACK (handle_register_document_with_owner_cb), application);
         g_signal_connect (skeleton, "handle-unregister-document",
                           G_CALLBACK (handle_unregister_document_cb), application);
         g_signal_connect (skeleton, "handle-find-document",
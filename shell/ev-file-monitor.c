@@ -20,24 +20,55 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib.h>
 #include <gio/gio.h>
 
 #include "ev-file-monitor.h"
+#include "ev-debug.h"
+#include "ev-trace.h"
 
 enum {
 	CHANGED,
 	N_SIGNALS
 };
 
+/* Upper bound for how long we keep waiting for a file that never
+ * settles. After that we emit changed anyway and let the loader
+ * report whatever error it finds.
+ */
+#define MAX_SETTLE_TIME_USEC     (30 * G_USEC_PER_SEC)
+#define DEFAULT_DEBOUNCE_MSEC    1000
+#define PDF_TRAILER_SEARCH_SIZE  1024
+
 struct _EvFileMonitorPrivate {
 	GFileMonitor *monitor;
+	GFile        *file;
 
 	guint         timeout_id;
+	guint         debounce_interval;
+
+	/* The file is checked asynchronously, this cancels the
+	 * checks in progress when a new change arrives or the
+	 * monitor is finalized.
+	 */
+	GCancellable *cancellable;
+
+	/* Last sampled state of the file, used to detect
+	 * whether a writer is still busy with it.
+	 */
+	goffset       size;
+	guint64       mtime;
+	guint32       mtime_usec;
+
+	/* Metrics */
+	gint64        first_event_time;
+	guint         n_events;
 };
 
 static void ev_file_monitor_timeout_start (EvFileMonitor    *ev_monitor);
 static void ev_file_monitor_timeout_stop  (EvFileMonitor    *ev_monitor);
+static void ev_file_monitor_schedule_check (EvFileMonitor   *ev_monitor);
 static void ev_file_monitor_changed_cb    (GFileMonitor     *monitor,
 					   GFile            *file,
 					   GFile            *other_file,
@@ -55,6 +86,8 @@ static void
 ev_file_monitor_init (EvFileMonitor *ev_monitor)
 {
 	ev_monitor->priv = EV_FILE_MONITOR_GET_PRIVATE (ev_monitor);
+	ev_monitor->priv->debounce_interval = DEFAULT_DEBOUNCE_MSEC;
+	ev_monitor->priv->size = -1;
 }
 
 static void
@@ -72,6 +105,8 @@ ev_file_monitor_finalize (GObject *object)
 		ev_monitor->priv->monitor = NULL;
 	}
 
+	g_clear_object (&ev_monitor->priv->file);
+
 	G_OBJECT_CLASS (ev_file_monitor_parent_class)->finalize (object);
 }
 
@@ -95,30 +130,283 @@ ev_file_monitor_class_init (EvFileMonitorClass *klass)
 			      G_TYPE_NONE, 0);
 }
 
+#define SAMPLE_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+/* Records the state of the file in @info, and returns whether it's the
+ * same as the previous sample. @info is %NULL when the file doesn't exist.
+ */
 static gboolean
-timeout_cb (EvFileMonitor *ev_monitor)
+ev_file_monitor_sample_file (EvFileMonitor *ev_monitor,
+			     GFileInfo     *info)
+{
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+	goffset               size;
+	guint64               mtime;
+	guint32               mtime_usec;
+	gboolean              stable;
+
+	if (!info) {
+		/* The file might be temporarily gone while the writer
+		 * replaces it, consider it unstable.
+		 */
+		priv->size = -1;
+
+		return FALSE;
+	}
+
+	size = g_file_info_get_size (info);
+	mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	mtime_usec = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+	stable = (size == priv->size && mtime == priv->mtime && mtime_usec == priv->mtime_usec);
+
+	priv->size = size;
+	priv->mtime = mtime;
+	priv->mtime_usec = mtime_usec;
+
+	return stable;
+}
+
+/* PDF writers append the trailer last, so a PDF file without a %%EOF
+ * marker near its end is still being written. Other formats are
+ * considered complete once their size and mtime are stable. This runs
+ * in a thread, @task_data is the size of the file.
+ */
+static void
+file_is_complete_thread (GTask        *task,
+			 gpointer      source_object,
+			 gpointer      task_data,
+			 GCancellable *cancellable)
+{
+	GFile                *file = G_FILE (source_object);
+	goffset               size = *(goffset *)task_data;
+	GFileInputStream     *stream;
+	gchar                 header[5];
+	gchar                 buffer[PDF_TRAILER_SEARCH_SIZE];
+	gsize                 n_read = 0;
+	gsize                 i;
+	gboolean              complete = TRUE;
+
+	stream = g_file_read (file, cancellable, NULL);
+	if (!stream) {
+		g_task_return_boolean (task, FALSE);
+		return;
+	}
+
+	if (!g_input_stream_read_all (G_INPUT_STREAM (stream), header, sizeof (header), &n_read, cancellable, NULL) ||
+	    n_read != sizeof (header) || memcmp (header, "%PDF-", sizeof (header)) != 0) {
+		/* Not a PDF document (or too short to be one), nothing else to check */
+		g_object_unref (stream);
+		g_task_return_boolean (task, n_read > 0);
+
+		return;
+	}
+
+	if (size > PDF_TRAILER_SEARCH_SIZE &&
+	    !g_seekable_seek (G_SEEKABLE (stream), -PDF_TRAILER_SEARCH_SIZE,
+			      G_SEEK_END, cancellable, NULL)) {
+		g_object_unref (stream);
+		g_task_return_boolean (task, FALSE);
+
+		return;
+	}
+
+	if (g_input_stream_read_all (G_INPUT_STREAM (stream), buffer, sizeof (buffer), &n_read, cancellable, NULL)) {
+		complete = FALSE;
+		for (i = 0; n_read >= 5 && i <= n_read - 5; i++) {
+			if (memcmp (buffer + i, "%%EOF", 5) == 0) {
+				complete = TRUE;
+				break;
+			}
+		}
+	} else {
+		complete = FALSE;
+	}
+
+	g_object_unref (stream);
+
+	g_task_return_boolean (task, complete);
+}
+
+static void
+ev_file_monitor_emit_changed (EvFileMonitor *ev_monitor)
 {
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+
+	/* Time from the first change notification to the reload */
+	ev_trace_span (priv->first_event_time, g_get_monotonic_time (),
+		       "reload", EV_GET_TYPE_NAME (ev_monitor), ev_monitor, -1);
+	priv->first_event_time = 0;
+	priv->n_events = 0;
+
 	g_signal_emit (ev_monitor, signals[CHANGED], 0);
-	
-	ev_monitor->priv->timeout_id = 0;
+}
+
+static void
+ev_file_monitor_check_finished (EvFileMonitor *ev_monitor,
+				gboolean       exists,
+				gboolean       ready)
+{
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+
+	if (!ready && g_get_monotonic_time () - priv->first_event_time < MAX_SETTLE_TIME_USEC) {
+		/* Still being written, check again after another interval */
+		ev_file_monitor_schedule_check (ev_monitor);
+		return;
+	}
+
+	if (exists)
+		ev_file_monitor_emit_changed (ev_monitor);
+}
+
+static void
+file_is_complete_cb (GObject      *source_object,
+		     GAsyncResult *result,
+		     gpointer      user_data)
+{
+	GError   *error = NULL;
+	gboolean  complete;
+
+	complete = g_task_propagate_boolean (G_TASK (result), &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The monitor might be gone already */
+		g_error_free (error);
+		return;
+	}
+
+	ev_file_monitor_check_finished (EV_FILE_MONITOR (user_data), TRUE, complete);
+}
+
+static void
+check_query_info_cb (GObject      *source_object,
+		     GAsyncResult *result,
+		     gpointer      user_data)
+{
+	EvFileMonitor        *ev_monitor;
+	EvFileMonitorPrivate *priv;
+	GFileInfo            *info;
+	GError               *error = NULL;
+	GTask                *task;
+	goffset              *size;
+	gboolean              stable;
+
+	info = g_file_query_info_finish (G_FILE (source_object), result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The monitor might be gone already */
+		g_error_free (error);
+		return;
+	}
+	g_clear_error (&error);
+
+	ev_monitor = EV_FILE_MONITOR (user_data);
+	priv = ev_monitor->priv;
+
+	stable = ev_file_monitor_sample_file (ev_monitor, info);
+	if (!info) {
+		ev_file_monitor_check_finished (ev_monitor, FALSE, FALSE);
+		return;
+	}
+	g_object_unref (info);
+
+	if (!stable) {
+		ev_file_monitor_check_finished (ev_monitor, TRUE, FALSE);
+		return;
+	}
+
+	size = g_new (goffset, 1);
+	*size = priv->size;
+
+	task = g_task_new (priv->file, priv->cancellable, file_is_complete_cb, ev_monitor);
+	g_task_set_task_data (task, size, g_free);
+	g_task_run_in_thread (task, file_is_complete_thread);
+	g_object_unref (task);
+}
+
+static gboolean
+timeout_cb (EvFileMonitor *ev_monitor)
+{
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+
+	priv->timeout_id = 0;
+
+	g_file_query_info_async (priv->file, SAMPLE_ATTRIBUTES,
+				 G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+				 priv->cancellable,
+				 check_query_info_cb, ev_monitor);
+
 	return FALSE;
 }
 
+static void
+ev_file_monitor_schedule_check (EvFileMonitor *ev_monitor)
+{
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+
+	priv->timeout_id =
+		g_timeout_add (priv->debounce_interval, (GSourceFunc)timeout_cb, ev_monitor);
+}
+
+static void
+reset_query_info_cb (GObject      *source_object,
+		     GAsyncResult *result,
+		     gpointer      user_data)
+{
+	GFileInfo *info;
+	GError    *error = NULL;
+
+	info = g_file_query_info_finish (G_FILE (source_object), result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The monitor might be gone already */
+		g_error_free (error);
+		return;
+	}
+	g_clear_error (&error);
+
+	ev_file_monitor_sample_file (EV_FILE_MONITOR (user_data), info);
+	if (info)
+		g_object_unref (info);
+}
+
 static void
 ev_file_monitor_timeout_start (EvFileMonitor *ev_monitor)
 {
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+
 	ev_file_monitor_timeout_stop (ev_monitor);
-	
-	ev_monitor->priv->timeout_id =
-		g_timeout_add_seconds (5, (GSourceFunc)timeout_cb, ev_monitor);
+
+	if (priv->first_event_time == 0)
+		priv->first_event_time = g_get_monotonic_time ();
+	priv->n_events++;
+
+	/* Forget the previous sample so that the first check after the
+	 * interval compares against a state taken after this event.
+	 * All the queries until the next event share the cancellable.
+	 */
+	priv->cancellable = g_cancellable_new ();
+	g_file_query_info_async (priv->file, SAMPLE_ATTRIBUTES,
+				 G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+				 priv->cancellable,
+				 reset_query_info_cb, ev_monitor);
+
+	ev_file_monitor_schedule_check (ev_monitor);
 }
 
 static void
 ev_file_monitor_timeout_stop (EvFileMonitor *ev_monitor)
 {
-	if (ev_monitor->priv->timeout_id > 0) {
-		g_source_remove (ev_monitor->priv->timeout_id);
-		ev_monitor->priv->timeout_id = 0;
+	EvFileMonitorPrivate *priv = ev_monitor->priv;
+
+	if (priv->timeout_id > 0) {
+		g_source_remove (priv->timeout_id);
+		priv->timeout_id = 0;
+	}
+
+	if (priv->cancellable) {
+		g_cancellable_cancel (priv->cancellable);
+		g_clear_object (&priv->cancellable);
 	}
 }
 
@@ -130,12 +418,13 @@ ev_file_monitor_changed_cb (GFileMonitor     *monitor,
 			    EvFileMonitor    *ev_monitor)
 {
 	switch (event_type) {
-	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
-		ev_file_monitor_timeout_stop (ev_monitor);
-		g_signal_emit (ev_monitor, signals[CHANGED], 0);
-
-		break;
 	case G_FILE_MONITOR_EVENT_CHANGED:
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_CREATED:
+		/* Tools that rewrite the file in several passes produce
+		 * a burst of events, restart the debounce window on
+		 * every one of them and reload once it settles.
+		 */
 		ev_file_monitor_timeout_start (ev_monitor);
 		break;
 	default:
@@ -153,6 +442,7 @@ ev_file_monitor_new (const gchar *uri)
 	ev_monitor = EV_FILE_MONITOR (g_object_new (EV_TYPE_FILE_MONITOR, NULL));
 
 	file = g_file_new_for_uri (uri);
+	ev_monitor->priv->file = g_object_ref (file);
 	ev_monitor->priv->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
 	if (ev_monitor->priv->monitor) {
 		g_signal_connect (ev_monitor->priv->monitor, "changed",
@@ -166,3 +456,20 @@ ev_file_monitor_new (const gchar *uri)
 
 	return ev_monitor;
 }
+
+/**
+ * ev_file_monitor_set_debounce_interval:
+ * @ev_monitor: an #EvFileMonitor
+ * @interval: the interval in milliseconds
+ *
+ * Sets the time the file must stay unmodified after the last
+ * change notification before #EvFileMonitor::changed is emitted.
+ */
+void
+ev_file_monitor_set_debounce_interval (EvFileMonitor *ev_monitor,
+				       guint          interval)
+{
+	g_return_if_fail (EV_IS_FILE_MONITOR (ev_monitor));
+
+	ev_monitor->priv->debounce_interval = MAX (interval, 1);
+}
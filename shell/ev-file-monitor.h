@@ -52,6 +52,9 @@ struct _EvFileMonitorClass {
 GType          ev_file_monitor_get_type (void) G_GNUC_CONST;
 EvFileMonitor *ev_file_monitor_new      (const gchar *uri);
 
+void           ev_file_monitor_set_debounce_interval (EvFileMonitor *ev_monitor,
+						      guint          interval);
+
 G_END_DECLS
 
 #endif /* EV_FILE_MONITOR_H */
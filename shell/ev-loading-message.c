@@ -24,10 +24,14 @@
 #include <string.h>
 #include <glib/gi18n.h>
 
+/* Only long waits are worth an estimate, short ones aren't accurate */
+#define MIN_TIME_REMAINING 2
+
 struct _EvLoadingMessage {
         GtkBox     base_instance;
 
         GtkWidget *spinner;
+        GtkWidget *label;
 };
 
 struct _EvLoadingMessageClass {
@@ -39,17 +43,15 @@ G_DEFINE_TYPE (EvLoadingMessage, ev_loading_message, GTK_TYPE_BOX)
 static void
 ev_loading_message_init (EvLoadingMessage *message)
 {
-        GtkWidget *label;
-
         gtk_container_set_border_width (GTK_CONTAINER (message), 10);
 
         message->spinner = gtk_spinner_new ();
         gtk_box_pack_start (GTK_BOX (message), message->spinner, FALSE, FALSE, 0);
         gtk_widget_show (message->spinner);
 
-        label = gtk_label_new (_("Loading…"));
-        gtk_box_pack_start (GTK_BOX (message), label, FALSE, FALSE, 0);
-        gtk_widget_show (label);
+        message->label = gtk_label_new (_("Loading…"));
+        gtk_box_pack_start (GTK_BOX (message), message->label, FALSE, FALSE, 0);
+        gtk_widget_show (message->label);
 }
 
 static void
@@ -174,3 +176,25 @@ ev_loading_message_new (void)
         return message;
 }
 
+void
+ev_loading_message_set_time_remaining (EvLoadingMessage *message,
+                                       gdouble           seconds)
+{
+        gchar *text;
+        gint   n_seconds;
+
+        g_return_if_fail (EV_IS_LOADING_MESSAGE (message));
+
+        n_seconds = (gint) (seconds + 0.5);
+        if (n_seconds < MIN_TIME_REMAINING) {
+                gtk_label_set_text (GTK_LABEL (message->label), _("Loading…"));
+                return;
+        }
+
+        text = g_strdup_printf (ngettext ("Loading… about %d second left",
+                                          "Loading… about %d seconds left",
+                                          n_seconds),
+                                n_seconds);
+        gtk_label_set_text (GTK_LABEL (message->label), text);
+        g_free (text);
+}
@@ -38,6 +38,8 @@ typedef struct _EvLoadingMessageClass EvLoadingMessageClass;
 GType      ev_loading_message_get_type (void) G_GNUC_CONST;
 
 GtkWidget *ev_loading_message_new      (void);
+void       ev_loading_message_set_time_remaining (EvLoadingMessage *message,
+                                                  gdouble           seconds);
 
 G_END_DECLS
 
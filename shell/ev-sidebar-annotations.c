@@ -57,8 +57,10 @@ struct _EvSidebarAnnotationsPrivate {
 	GtkWidget   *palette;
 	GtkToolItem *annot_text_item;
 
-	EvJob       *job;
-	guint        selection_changed_id;
+	EvJob        *job;
+	GtkListStore *model;
+	GList        *last_annots;
+	guint         selection_changed_id;
 };
 
 static void ev_sidebar_annotations_page_iface_init (EvSidebarPageInterface *iface);
@@ -76,12 +78,34 @@ G_DEFINE_TYPE_EXTENDED (EvSidebarAnnotations,
 #define EV_SIDEBAR_ANNOTATIONS_GET_PRIVATE(object) \
 	(G_TYPE_INSTANCE_GET_PRIVATE ((object), EV_TYPE_SIDEBAR_ANNOTATIONS, EvSidebarAnnotationsPrivate))
 
+static void
+ev_sidebar_annotations_cancel_job (EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+
+	if (priv->job) {
+		g_signal_handlers_disconnect_by_data (priv->job, sidebar_annots);
+		if (!ev_job_is_finished (priv->job))
+			ev_job_cancel (priv->job);
+		g_object_unref (priv->job);
+		priv->job = NULL;
+	}
+
+	if (priv->model) {
+		g_object_unref (priv->model);
+		priv->model = NULL;
+	}
+	priv->last_annots = NULL;
+}
+
 static void
 ev_sidebar_annotations_dispose (GObject *object)
 {
 	EvSidebarAnnotations *sidebar_annots = EV_SIDEBAR_ANNOTATIONS (object);
 	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
+	ev_sidebar_annotations_cancel_job (sidebar_annots);
+
 	if (priv->document) {
 		g_object_unref (priv->document);
 		priv->document = NULL;
@@ -356,18 +380,15 @@ selection_changed_cb (GtkTreeSelection     *selection,
 }
 
 static void
-job_finished_callback (EvJobAnnots          *job,
-		       EvSidebarAnnotations *sidebar_annots)
+ev_sidebar_annotations_add_annots (EvSidebarAnnotations *sidebar_annots,
+				   GList                *annots)
 {
-	EvSidebarAnnotationsPrivate *priv;
-	GtkListStore *model;
-	GtkTreeSelection *selection;
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+	GtkListStore *model = priv->model;
 	GList *l;
 	GdkPixbuf *text_icon = NULL;
 	GdkPixbuf *attachment_icon = NULL;
 
-	priv = sidebar_annots->priv;
-
         static char *data[] = {
             /*
             { EV_ANNOTATION_TYPE_UNKNOWN, "Unknown" },
@@ -378,35 +399,7 @@ job_finished_callback (EvJobAnnots          *job,
             "Unknown", "Text", "Attachment", "Text Markup", "Line"
         };
  
-	if (!job->annots) {
-		GtkTreeModel *list;
-
-		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
-		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
-		g_object_unref (list);
-
-		g_object_unref (job);
-		priv->job = NULL;
-
-		return;
-	}
-
-	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
-	gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
-	if (priv->selection_changed_id == 0) {
-		priv->selection_changed_id =
-			g_signal_connect (selection, "changed",
-					  G_CALLBACK (selection_changed_cb),
-					  sidebar_annots);
-	}
-
-	model = gtk_list_store_new (N_COLUMNS,
-                                    G_TYPE_ULONG,
-				    G_TYPE_STRING,
-				    GDK_TYPE_PIXBUF,
-				    G_TYPE_POINTER);
-
-	for (l = job->annots; l; l = g_list_next (l)) {
+	for (l = annots; l; l = g_list_next (l)) {
 		EvMappingList *mapping_list;
 		GList         *ll;
 		gchar         *page_label;
@@ -498,36 +491,86 @@ job_finished_callback (EvJobAnnots          *job,
 			gtk_list_store_remove (model, &iter);
 	}
 
-	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
-				 GTK_TREE_MODEL (model));
-	g_object_unref (model);
-
 	if (text_icon)
 		g_object_unref (text_icon);
 	if (attachment_icon)
 		g_object_unref (attachment_icon);
+}
+
+static void
+job_updated_callback (EvJobAnnots          *job,
+		      gint                  page,
+		      EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+	GList *annots;
+
+	annots = priv->last_annots ? g_list_next (priv->last_annots) : job->annots;
+	if (!annots)
+		return;
 
-	g_object_unref (job);
-	priv->job = NULL;
+	if (!priv->model) {
+		GtkTreeSelection *selection;
+
+		selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
+		gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
+		if (priv->selection_changed_id == 0) {
+			priv->selection_changed_id =
+				g_signal_connect (selection, "changed",
+						  G_CALLBACK (selection_changed_cb),
+						  sidebar_annots);
+		}
+
+		priv->model = gtk_list_store_new (N_COLUMNS,
+						  G_TYPE_ULONG,
+						  G_TYPE_STRING,
+						  GDK_TYPE_PIXBUF,
+						  G_TYPE_POINTER);
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
+					 GTK_TREE_MODEL (priv->model));
+	}
+
+	/* Annotations are appended to the job list as pages are scanned,
+	 * only the ones we haven't seen yet are added to the model.
+	 */
+	ev_sidebar_annotations_add_annots (sidebar_annots, annots);
+	priv->last_annots = g_list_last (annots);
 }
 
 static void
-ev_sidebar_annotations_load (EvSidebarAnnotations *sidebar_annots)
+job_finished_callback (EvJobAnnots          *job,
+		       EvSidebarAnnotations *sidebar_annots)
 {
 	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
-	if (priv->job) {
-		g_signal_handlers_disconnect_by_func (priv->job,
-						      job_finished_callback,
-						      sidebar_annots);
-		g_object_unref (priv->job);
+	if (!job->annots) {
+		GtkTreeModel *list;
+
+		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
+		g_object_unref (list);
+	} else {
+		job_updated_callback (job, job->n_pages - 1, sidebar_annots);
 	}
 
+	ev_sidebar_annotations_cancel_job (sidebar_annots);
+}
+
+static void
+ev_sidebar_annotations_load (EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+
+	ev_sidebar_annotations_cancel_job (sidebar_annots);
+
 	priv->job = ev_job_annots_new (priv->document);
+	g_signal_connect (priv->job, "updated",
+			  G_CALLBACK (job_updated_callback),
+			  sidebar_annots);
 	g_signal_connect (priv->job, "finished",
 			  G_CALLBACK (job_finished_callback),
 			  sidebar_annots);
-	/* The priority doesn't matter for this job */
+	/* Annotations are scanned in the main loop when idle */
 	ev_job_scheduler_push_job (priv->job, EV_JOB_PRIORITY_NONE);
 }
 
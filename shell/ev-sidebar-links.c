@@ -47,6 +47,13 @@ struct _EvSidebarLinksPrivate {
 	GtkTreeModel *model;
 	EvDocument *document;
 	EvDocumentModel *doc_model;
+
+	/* Page labels of the rows already drawn, indexed by EvLink */
+	GHashTable *page_labels;
+	/* Links drawn whose page label is still to be resolved */
+	GPtrArray *pending_labels;
+	EvJob *labels_job;
+	guint labels_idle_id;
 };
 
 enum {
@@ -73,6 +80,8 @@ static void job_finished_callback 			(EvJobLinks     *job,
 				    		         EvSidebarLinks *sidebar_links);
 static void ev_sidebar_links_set_current_page           (EvSidebarLinks *sidebar_links,
 							 gint            current_page);
+static void ev_sidebar_links_resolve_page_labels        (EvSidebarLinks *sidebar_links);
+static void ev_sidebar_links_clear_page_labels          (EvSidebarLinks *sidebar_links);
 static void ev_sidebar_links_page_iface_init 		(EvSidebarPageInterface *iface);
 static gboolean ev_sidebar_links_support_document	(EvSidebarPage  *sidebar_page,
 						         EvDocument     *document);
@@ -152,6 +161,18 @@ ev_sidebar_links_dispose (GObject *object)
 		sidebar->priv->model = NULL;
 	}
 
+	ev_sidebar_links_clear_page_labels (sidebar);
+
+	if (sidebar->priv->page_labels) {
+		g_hash_table_destroy (sidebar->priv->page_labels);
+		sidebar->priv->page_labels = NULL;
+	}
+
+	if (sidebar->priv->pending_labels) {
+		g_ptr_array_unref (sidebar->priv->pending_labels);
+		sidebar->priv->pending_labels = NULL;
+	}
+
 	if (sidebar->priv->document) {
 		g_object_unref (sidebar->priv->document);
 		sidebar->priv->document = NULL;
@@ -383,6 +404,143 @@ button_press_cb (GtkWidget *treeview,
 }
 
 
+static void
+labels_job_finished_callback (EvJobLinkLabels *job,
+			      EvSidebarLinks  *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+	guint                  i;
+
+	for (i = 0; i < job->links->len; i++) {
+		g_hash_table_replace (priv->page_labels,
+				      g_ptr_array_index (job->links, i),
+				      job->page_labels[i]);
+		job->page_labels[i] = NULL;
+	}
+
+	g_object_unref (priv->labels_job);
+	priv->labels_job = NULL;
+
+	gtk_widget_queue_draw (priv->tree_view);
+
+	/* Rows drawn while the job was running */
+	if (priv->pending_labels->len > 0)
+		ev_sidebar_links_resolve_page_labels (sidebar_links);
+}
+
+static gboolean
+resolve_page_labels_idle_cb (EvSidebarLinks *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+
+	priv->labels_idle_id = 0;
+	if (!priv->labels_job)
+		ev_sidebar_links_resolve_page_labels (sidebar_links);
+
+	return FALSE;
+}
+
+static void
+ev_sidebar_links_resolve_page_labels (EvSidebarLinks *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+
+	priv->labels_job = ev_job_link_labels_new (priv->document, priv->pending_labels);
+	g_ptr_array_unref (priv->pending_labels);
+	priv->pending_labels = g_ptr_array_new_with_free_func (g_object_unref);
+
+	g_signal_connect (priv->labels_job, "finished",
+			  G_CALLBACK (labels_job_finished_callback),
+			  sidebar_links);
+	ev_job_scheduler_push_job (priv->labels_job, EV_JOB_PRIORITY_HIGH);
+}
+
+static void
+ev_sidebar_links_clear_page_labels (EvSidebarLinks *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+
+	if (priv->labels_job) {
+		g_signal_handlers_disconnect_by_func (priv->labels_job,
+						      labels_job_finished_callback,
+						      sidebar_links);
+		ev_job_cancel (priv->labels_job);
+		g_object_unref (priv->labels_job);
+		priv->labels_job = NULL;
+	}
+
+	if (priv->labels_idle_id > 0) {
+		g_source_remove (priv->labels_idle_id);
+		priv->labels_idle_id = 0;
+	}
+
+	if (priv->pending_labels)
+		g_ptr_array_set_size (priv->pending_labels, 0);
+	if (priv->page_labels)
+		g_hash_table_remove_all (priv->page_labels);
+}
+
+/* Page labels are resolved the first time a row is drawn, resolving
+ * all of them when the model is built is too slow for huge outlines.
+ * The rows drawn in a main loop iteration are resolved together in a
+ * thread, until then the label is left empty.
+ */
+static void
+page_label_cell_data_func (GtkTreeViewColumn *column,
+			   GtkCellRenderer   *renderer,
+			   GtkTreeModel      *model,
+			   GtkTreeIter       *iter,
+			   EvSidebarLinks    *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+	EvLink                *link;
+	gchar                 *page_label;
+
+	gtk_tree_model_get (model, iter,
+			    EV_DOCUMENT_LINKS_COLUMN_LINK, &link,
+			    EV_DOCUMENT_LINKS_COLUMN_PAGE_LABEL, &page_label,
+			    -1);
+
+	if (!page_label && link && priv->document) {
+		if (!g_hash_table_lookup_extended (priv->page_labels, link,
+						   NULL, (gpointer *)&page_label)) {
+			g_hash_table_insert (priv->page_labels, link, NULL);
+			g_ptr_array_add (priv->pending_labels, g_object_ref (link));
+			if (priv->labels_idle_id == 0)
+				priv->labels_idle_id =
+					g_idle_add ((GSourceFunc)resolve_page_labels_idle_cb,
+						    sidebar_links);
+		}
+		g_object_set (renderer, "text", page_label, NULL);
+	} else {
+		g_object_set (renderer, "text", page_label, NULL);
+		g_free (page_label);
+	}
+
+	if (link)
+		g_object_unref (link);
+}
+
+/* Backends can leave the children of collapsed nodes unbuilt until
+ * they are expanded for the first time.
+ */
+static gboolean
+test_expand_row_cb (GtkTreeView    *tree_view,
+		    GtkTreeIter    *iter,
+		    GtkTreePath    *path,
+		    EvSidebarLinks *sidebar_links)
+{
+	EvSidebarLinksPrivate *priv = sidebar_links->priv;
+
+	if (priv->document && priv->model &&
+	    gtk_tree_view_get_model (tree_view) == priv->model) {
+		ev_document_links_expand_links_node (EV_DOCUMENT_LINKS (priv->document),
+						     priv->model, iter);
+	}
+
+	return FALSE;
+}
+
 static void
 ev_sidebar_links_construct (EvSidebarLinks *ev_sidebar_links)
 {
@@ -437,9 +595,14 @@ ev_sidebar_links_construct (EvSidebarLinks *ev_sidebar_links)
 		      "xalign", 1.0,
 		      NULL);
 	gtk_tree_view_column_pack_start (GTK_TREE_VIEW_COLUMN (column), renderer, FALSE);
-	gtk_tree_view_column_set_attributes (GTK_TREE_VIEW_COLUMN (column), renderer,
-					     "text", EV_DOCUMENT_LINKS_COLUMN_PAGE_LABEL,
-					     NULL);
+	gtk_tree_view_column_set_cell_data_func (GTK_TREE_VIEW_COLUMN (column), renderer,
+						 (GtkTreeCellDataFunc) page_label_cell_data_func,
+						 ev_sidebar_links, NULL);
+
+	g_signal_connect (priv->tree_view,
+			  "test-expand-row",
+			  G_CALLBACK (test_expand_row_cb),
+			  ev_sidebar_links);
 
 	g_signal_connect (priv->tree_view,
 			  "button_press_event",
@@ -455,6 +618,11 @@ static void
 ev_sidebar_links_init (EvSidebarLinks *ev_sidebar_links)
 {
 	ev_sidebar_links->priv = EV_SIDEBAR_LINKS_GET_PRIVATE (ev_sidebar_links);
+	ev_sidebar_links->priv->page_labels = g_hash_table_new_full (g_direct_hash,
+								     g_direct_equal,
+								     NULL,
+								     g_free);
+	ev_sidebar_links->priv->pending_labels = g_ptr_array_new_with_free_func (g_object_unref);
 
 	ev_sidebar_links_construct (ev_sidebar_links);
 }
@@ -544,7 +712,8 @@ ev_sidebar_links_set_current_page (EvSidebarLinks *sidebar_links,
 	/* We go through the tree linearly looking for the first page that
 	 * matches.  This is pretty inefficient.  We can do something neat with
 	 * a GtkTreeModelSort here to make it faster, if it turns out to be
-	 * slow.
+	 * slow. Only the nodes built so far are visited: building the
+	 * collapsed ones would block the page changes on the whole outline.
 	 */
 	g_signal_handler_block (selection, sidebar_links->priv->selection_id);
 	g_signal_handler_block (sidebar_links->priv->tree_view, sidebar_links->priv->row_activated_id);
@@ -614,6 +783,7 @@ ev_sidebar_links_set_links_model (EvSidebarLinks *sidebar_links,
 	if (priv->model)
 		g_object_unref (priv->model);
 	priv->model = g_object_ref (model);
+	ev_sidebar_links_clear_page_labels (sidebar_links);
 
 	g_object_notify (G_OBJECT (sidebar_links), "model");
 }
@@ -33,8 +33,10 @@
 
 #include "ev-document-misc.h"
 #include "ev-job-scheduler.h"
+#include "ev-memory-governor.h"
 #include "ev-sidebar-page.h"
 #include "ev-sidebar-thumbnails.h"
+#include "ev-thumbnail-cache.h"
 #include "ev-utils.h"
 #include "ev-window.h"
 
@@ -67,6 +69,7 @@ struct _EvSidebarThumbnailsPrivate {
 	EvDocument *document;
 	EvDocumentModel *model;
 	EvThumbsSizeCache *size_cache;
+	EvThumbnailCache *thumbnail_cache;
 
 	gint n_pages, pages_done;
 
@@ -75,6 +78,8 @@ struct _EvSidebarThumbnailsPrivate {
 
 	/* Visible pages */
 	gint start_page, end_page;
+
+	EvMemoryConsumer *memory_consumer;
 };
 
 enum {
@@ -98,6 +103,8 @@ static const gchar* ev_sidebar_thumbnails_get_label        (EvSidebarPage
 static void         thumbnail_job_completed_callback       (EvJobThumbnail          *job,
 							    EvSidebarThumbnails     *sidebar_thumbnails);
 static void         adjustment_changed_cb                  (EvSidebarThumbnails     *sidebar_thumbnails);
+static void         thumbnail_cache_loaded_cb              (EvThumbnailCache        *thumbnail_cache,
+							    EvSidebarThumbnails     *sidebar_thumbnails);
 
 G_DEFINE_TYPE_EXTENDED (EvSidebarThumbnails, 
                         ev_sidebar_thumbnails, 
@@ -129,7 +136,8 @@ get_thumbnail_size_for_page (EvDocument *document,
 }
 
 static EvThumbsSizeCache *
-ev_thumbnails_size_cache_new (EvDocument *document)
+ev_thumbnails_size_cache_new (EvDocument       *document,
+			      EvThumbnailCache *thumbnail_cache)
 {
 	EvThumbsSizeCache *cache;
 	gint               i, n_pages;
@@ -150,14 +158,46 @@ ev_thumbnails_size_cache_new (EvDocument *document)
 
 	for (i = 0; i < n_pages; i++) {
 		thumb_size = &(cache->sizes[i]);
+		if (thumbnail_cache &&
+		    ev_thumbnail_cache_get_page_size (thumbnail_cache, i,
+						      &thumb_size->width,
+						      &thumb_size->height))
+			continue;
+
 		get_thumbnail_size_for_page (document, i,
 					     &thumb_size->width,
 					     &thumb_size->height);
+		if (thumbnail_cache)
+			ev_thumbnail_cache_set_page_size (thumbnail_cache, i,
+							  thumb_size->width,
+							  thumb_size->height);
 	}
 
 	return cache;
 }
 
+/* Takes the sizes stored in @thumbnail_cache, which is loaded after
+ * the size cache is built */
+static void
+ev_thumbnails_size_cache_update (EvThumbsSizeCache *cache,
+				 EvDocument        *document,
+				 EvThumbnailCache  *thumbnail_cache)
+{
+	gint i, n_pages;
+
+	if (cache->uniform)
+		return;
+
+	n_pages = ev_document_get_n_pages (document);
+	for (i = 0; i < n_pages; i++) {
+		EvThumbsSize *thumb_size = &(cache->sizes[i]);
+
+		ev_thumbnail_cache_get_page_size (thumbnail_cache, i,
+						  &thumb_size->width,
+						  &thumb_size->height);
+	}
+}
+
 static void
 ev_thumbnails_size_cache_get_size (EvThumbsSizeCache *cache,
 				   gint               page,
@@ -200,13 +240,14 @@ ev_thumbnails_size_cache_free (EvThumbsSizeCache *cache)
 }
 
 static EvThumbsSizeCache *
-ev_thumbnails_size_cache_get (EvDocument *document)
+ev_thumbnails_size_cache_get (EvDocument       *document,
+			      EvThumbnailCache *thumbnail_cache)
 {
 	EvThumbsSizeCache *cache;
 
 	cache = g_object_get_data (G_OBJECT (document), EV_THUMBNAILS_SIZE_CACHE_KEY);
 	if (!cache) {
-		cache = ev_thumbnails_size_cache_new (document);
+		cache = ev_thumbnails_size_cache_new (document, thumbnail_cache);
 		g_object_set_data_full (G_OBJECT (document),
 					EV_THUMBNAILS_SIZE_CACHE_KEY,
 					cache,
@@ -221,6 +262,16 @@ static void
 ev_sidebar_thumbnails_dispose (GObject *object)
 {
 	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (object);
+
+	if (sidebar_thumbnails->priv->memory_consumer) {
+		ev_memory_governor_unregister (sidebar_thumbnails->priv->memory_consumer);
+		sidebar_thumbnails->priv->memory_consumer = NULL;
+	}
+
+	if (sidebar_thumbnails->priv->thumbnail_cache) {
+		ev_thumbnail_cache_free (sidebar_thumbnails->priv->thumbnail_cache);
+		sidebar_thumbnails->priv->thumbnail_cache = NULL;
+	}
 	
 	if (sidebar_thumbnails->priv->loading_icons) {
 		g_hash_table_destroy (sidebar_thumbnails->priv->loading_icons);
@@ -327,6 +378,47 @@ ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 	return icon;
 }
 
+/* Only the thumbnails of the visible pages are kept, so there's
+ * nothing to release, but they count for the memory budget.
+ */
+static void
+update_memory_usage (EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gboolean result;
+	gint page;
+	gsize usage = 0;
+
+	if (!priv->memory_consumer)
+		return;
+
+	if (priv->start_page >= 0 && priv->end_page >= priv->start_page) {
+		page = priv->start_page;
+		path = gtk_tree_path_new_from_indices (page, -1);
+		for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
+		     result && page <= priv->end_page;
+		     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), page++) {
+			GdkPixbuf *pixbuf;
+			gboolean thumbnail_set;
+
+			gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store), &iter,
+					    COLUMN_PIXBUF, &pixbuf,
+					    COLUMN_THUMBNAIL_SET, &thumbnail_set,
+					    -1);
+			if (pixbuf) {
+				if (thumbnail_set)
+					usage += gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+				g_object_unref (pixbuf);
+			}
+		}
+		gtk_tree_path_free (path);
+	}
+
+	ev_memory_governor_set_usage (priv->memory_consumer, usage);
+}
+
 static void
 clear_range (EvSidebarThumbnails *sidebar_thumbnails,
 	     gint                 start_page,
@@ -393,6 +485,27 @@ get_scale_for_page (EvSidebarThumbnails *sidebar_thumbnails,
 	return (gdouble)THUMBNAIL_WIDTH / width;
 }
 
+static void
+ev_sidebar_thumbnails_set_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+				     GtkTreeIter         *iter,
+				     GdkPixbuf           *thumbnail)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+        GdkPixbuf                  *pixbuf;
+
+        pixbuf = ev_document_misc_render_thumbnail_with_frame (GTK_WIDGET (sidebar_thumbnails), thumbnail);
+
+	if (priv->inverted_colors)
+		ev_document_misc_invert_pixbuf (pixbuf);
+	gtk_list_store_set (priv->list_store,
+			    iter,
+			    COLUMN_PIXBUF, pixbuf,
+			    COLUMN_THUMBNAIL_SET, TRUE,
+			    COLUMN_JOB, NULL,
+			    -1);
+        g_object_unref (pixbuf);
+}
+
 static void
 add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	   gint                 start_page,
@@ -418,6 +531,23 @@ add_range (EvSidebarThumbnails *sidebar_thumbnails,
 				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
 				    -1);
 
+		/* The cache may have been loaded after the job was queued */
+		if (!thumbnail_set && priv->thumbnail_cache) {
+			GdkPixbuf *thumbnail;
+
+			thumbnail = ev_thumbnail_cache_lookup (priv->thumbnail_cache, page);
+			if (thumbnail) {
+				if (job) {
+					g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
+					ev_job_cancel (job);
+					g_object_unref (job);
+				}
+				ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, &iter, thumbnail);
+				g_object_unref (thumbnail);
+				continue;
+			}
+		}
+
 		if (job == NULL && !thumbnail_set) {
 			job = ev_job_thumbnail_new (priv->document,
 						    page, priv->rotation,
@@ -470,6 +600,8 @@ update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 	
 	priv->start_page = start_page;
 	priv->end_page = end_page;
+
+	update_memory_usage (sidebar_thumbnails);
 }
 
 static void
@@ -699,6 +831,9 @@ ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 					       GDK_TYPE_PIXBUF,
 					       G_TYPE_BOOLEAN,
 					       EV_TYPE_JOB_THUMBNAIL);
+	priv->memory_consumer = ev_memory_governor_register ("EvSidebarThumbnails",
+							     EV_MEMORY_PRIORITY_LOW,
+							     NULL, NULL);
 
 	priv->swindow = gtk_scrolled_window_new (NULL, NULL);
 
@@ -796,9 +931,18 @@ ev_sidebar_thumbnails_rotation_changed_cb (EvDocumentModel     *model,
 					   GParamSpec          *pspec,
 					   EvSidebarThumbnails *sidebar_thumbnails)
 {
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 	gint rotation = ev_document_model_get_rotation (model);
 
-	sidebar_thumbnails->priv->rotation = rotation;
+	priv->rotation = rotation;
+
+	/* Thumbnails are cached per rotation */
+	if (priv->thumbnail_cache) {
+		ev_thumbnail_cache_free (priv->thumbnail_cache);
+		priv->thumbnail_cache = ev_thumbnail_cache_new (priv->document, THUMBNAIL_WIDTH, rotation,
+								(EvThumbnailCacheLoadedFunc)thumbnail_cache_loaded_cb,
+								sidebar_thumbnails);
+	}
 	ev_sidebar_thumbnails_reload (sidebar_thumbnails);
 }
 
@@ -819,20 +963,28 @@ thumbnail_job_completed_callback (EvJobThumbnail      *job,
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 	GtkTreeIter                *iter;
-        GdkPixbuf                  *pixbuf;
-
-        pixbuf = ev_document_misc_render_thumbnail_with_frame (GTK_WIDGET (sidebar_thumbnails), job->thumbnail);
 
 	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
-	if (priv->inverted_colors)
-		ev_document_misc_invert_pixbuf (pixbuf);
-	gtk_list_store_set (priv->list_store,
-			    iter,
-			    COLUMN_PIXBUF, pixbuf,
-			    COLUMN_THUMBNAIL_SET, TRUE,
-			    COLUMN_JOB, NULL,
-			    -1);
-        g_object_unref (pixbuf);
+	if (priv->thumbnail_cache && job->thumbnail)
+		ev_thumbnail_cache_store (priv->thumbnail_cache, job->page, job->thumbnail);
+	ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, iter, job->thumbnail);
+
+	update_memory_usage (sidebar_thumbnails);
+}
+
+static void
+thumbnail_cache_loaded_cb (EvThumbnailCache    *thumbnail_cache,
+			   EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	ev_thumbnails_size_cache_update (priv->size_cache, priv->document, thumbnail_cache);
+
+	/* Replace the visible thumbnails still being rendered */
+	if (priv->start_page >= 0 && priv->end_page >= priv->start_page) {
+		add_range (sidebar_thumbnails, priv->start_page, priv->end_page);
+		update_memory_usage (sidebar_thumbnails);
+	}
 }
 
 static void
@@ -848,10 +1000,17 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 		return;
 	}
 
-	priv->size_cache = ev_thumbnails_size_cache_get (document);
 	priv->document = document;
 	priv->n_pages = ev_document_get_n_pages (document);
 	priv->rotation = ev_document_model_get_rotation (model);
+
+	/* Saves the thumbnails of the previous document */
+	ev_thumbnail_cache_free (priv->thumbnail_cache);
+	priv->thumbnail_cache = ev_thumbnail_cache_new (document, THUMBNAIL_WIDTH, priv->rotation,
+							(EvThumbnailCacheLoadedFunc)thumbnail_cache_loaded_cb,
+							sidebar_thumbnails);
+	priv->size_cache = ev_thumbnails_size_cache_get (document, priv->thumbnail_cache);
+
 	priv->inverted_colors = ev_document_model_get_inverted_colors (model);
 	priv->loading_icons = g_hash_table_new_full (g_str_hash,
 						     g_str_equal,
@@ -945,6 +1104,9 @@ ev_sidebar_thumbnails_clear_model (EvSidebarThumbnails *sidebar_thumbnails)
 	
 	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->list_store), ev_sidebar_thumbnails_clear_job, sidebar_thumbnails);
 	gtk_list_store_clear (priv->list_store);
+
+	if (priv->memory_consumer)
+		ev_memory_governor_set_usage (priv->memory_consumer, 0);
 }
 
 static gboolean
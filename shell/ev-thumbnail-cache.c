@@ -0,0 +1,780 @@
+/* ev-thumbnail-cache.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "ev-thumbnail-cache.h"
+
+/*
+ * Thumbnails of the sidebar are kept between sessions in a file per
+ * document and rotation, in the user cache directory:
+ *
+ *   header: "EvTC", version, n_pages, thumbnail width, rotation (guint32 LE)
+ *   index:  n_pages x { offset, length (guint32 LE), width, height (guint16 LE) }
+ *   data:   the thumbnails as PNG
+ *
+ * The width and height in the index are the thumbnail size of the
+ * unrotated page, or 0 if unknown, and a length of 0 means there's no
+ * thumbnail for the page. The file is mapped, so only the thumbnails of
+ * the pages scrolled into view are read and decoded.
+ */
+
+#define CACHE_MAGIC          "EvTC"
+#define CACHE_VERSION        1
+#define CACHE_HEADER_SIZE    20
+#define CACHE_ENTRY_SIZE     12
+
+/* The document is identified by its size, modification time and etag,
+ * and by the contents of its head and tail, where the header, trailer
+ * and cross reference tables of most formats live, so that renaming it
+ * keeps the thumbnails but modifying it in place doesn't.
+ */
+#define HASH_SAMPLE_SIZE     (64 * 1024)
+
+#define MAX_CACHED_DOCUMENTS 200
+
+/* Opening the cache file, encoding the thumbnails and writing the file
+ * are done in threads, the cache is only used from the main thread.
+ */
+struct _EvThumbnailCache {
+	gchar        *filename;
+	gint          n_pages;
+	gint          width;
+	gint          rotation;
+
+	GCancellable *cancellable;
+
+	GMappedFile  *mapped_file;
+	const guchar *index;
+	gsize         length;
+
+	guint16      *sizes;
+	GBytes      **new_thumbnails;
+
+	EvThumbnailCacheLoadedFunc loaded_func;
+	gpointer                   loaded_data;
+};
+static guint32
+read_uint32 (const guchar *data)
+{
+	guint32 value;
+
+	memcpy (&value, data, sizeof (value));
+
+	return GUINT32_FROM_LE (value);
+}
+
+static guint16
+read_uint16 (const guchar *data)
+{
+	guint16 value;
+
+	memcpy (&value, data, sizeof (value));
+
+	return GUINT16_FROM_LE (value);
+}
+
+static void
+append_uint32 (GByteArray *array,
+	       guint32     value)
+{
+	value = GUINT32_TO_LE (value);
+	g_byte_array_append (array, (const guint8 *)&value, sizeof (value));
+}
+
+static void
+append_uint16 (GByteArray *array,
+	       guint16     value)
+{
+	value = GUINT16_TO_LE (value);
+	g_byte_array_append (array, (const guint8 *)&value, sizeof (value));
+}
+
+static gchar *
+get_cache_dir (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "evince", "thumbnails", NULL);
+}
+
+static gchar *
+get_document_hash (const gchar  *uri,
+		   GCancellable *cancellable)
+{
+	GFile            *file;
+	GFileInputStream *stream;
+	GFileInfo        *info;
+	GChecksum        *checksum;
+	guchar           *buffer;
+	gsize             bytes_read;
+	goffset           size;
+	guint64           value_le;
+	const gchar      *etag;
+	gchar            *hash = NULL;
+
+	file = g_file_new_for_uri (uri);
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+				  G_FILE_ATTRIBUTE_ETAG_VALUE,
+				  G_FILE_QUERY_INFO_NONE,
+				  cancellable, NULL);
+	if (!info) {
+		g_object_unref (file);
+		return NULL;
+	}
+
+	stream = g_file_read (file, cancellable, NULL);
+	g_object_unref (file);
+	if (!stream) {
+		g_object_unref (info);
+		return NULL;
+	}
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+	size = g_file_info_get_size (info);
+	value_le = GUINT64_TO_LE ((guint64)size);
+	g_checksum_update (checksum, (const guchar *)&value_le, sizeof (value_le));
+	value_le = GUINT64_TO_LE (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+	g_checksum_update (checksum, (const guchar *)&value_le, sizeof (value_le));
+	value_le = GUINT64_TO_LE ((guint64)g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+	g_checksum_update (checksum, (const guchar *)&value_le, sizeof (value_le));
+	etag = g_file_info_get_etag (info);
+	if (etag)
+		g_checksum_update (checksum, (const guchar *)etag, strlen (etag));
+	g_object_unref (info);
+
+	buffer = g_malloc (HASH_SAMPLE_SIZE);
+	if (!g_input_stream_read_all (G_INPUT_STREAM (stream), buffer, HASH_SAMPLE_SIZE,
+				      &bytes_read, cancellable, NULL))
+		goto out;
+	g_checksum_update (checksum, buffer, bytes_read);
+
+	if (size > HASH_SAMPLE_SIZE) {
+		if (!g_seekable_seek (G_SEEKABLE (stream),
+				      MAX (size - HASH_SAMPLE_SIZE, HASH_SAMPLE_SIZE),
+				      G_SEEK_SET, cancellable, NULL) ||
+		    !g_input_stream_read_all (G_INPUT_STREAM (stream), buffer, HASH_SAMPLE_SIZE,
+					      &bytes_read, cancellable, NULL))
+			goto out;
+		g_checksum_update (checksum, buffer, bytes_read);
+	}
+
+	hash = g_strdup (g_checksum_get_string (checksum));
+ out:
+	g_free (buffer);
+	g_checksum_free (checksum);
+	g_object_unref (stream);
+
+	return hash;
+}
+
+static GMappedFile *
+map_cache_file (const gchar *filename,
+		gint         n_pages,
+		gint         width,
+		gint         rotation)
+{
+	GMappedFile  *mapped_file;
+	const guchar *data;
+	gsize         length;
+
+	mapped_file = g_mapped_file_new (filename, FALSE, NULL);
+	if (!mapped_file)
+		return NULL;
+
+	data = (const guchar *)g_mapped_file_get_contents (mapped_file);
+	length = g_mapped_file_get_length (mapped_file);
+
+	if (length < CACHE_HEADER_SIZE + (gsize)n_pages * CACHE_ENTRY_SIZE ||
+	    memcmp (data, CACHE_MAGIC, 4) != 0 ||
+	    read_uint32 (data + 4) != CACHE_VERSION ||
+	    read_uint32 (data + 8) != (guint32)n_pages ||
+	    read_uint32 (data + 12) != (guint32)width ||
+	    read_uint32 (data + 16) != (guint32)rotation) {
+		g_mapped_file_unref (mapped_file);
+
+		return NULL;
+	}
+
+	/* Mark it as recently used, see prune_cache_dir() */
+	g_utime (filename, NULL);
+
+	return mapped_file;
+}
+
+typedef struct {
+	gchar       *uri;
+	gint         n_pages;
+	gint         width;
+	gint         rotation;
+
+	/* Result */
+	gchar       *filename;
+	GMappedFile *mapped_file;
+} OpenCacheData;
+
+static void
+open_cache_data_free (OpenCacheData *data)
+{
+	g_free (data->uri);
+	g_free (data->filename);
+	if (data->mapped_file)
+		g_mapped_file_unref (data->mapped_file);
+	g_slice_free (OpenCacheData, data);
+}
+
+static void
+open_cache_thread (GTask        *task,
+		   gpointer      source_object,
+		   gpointer      task_data,
+		   GCancellable *cancellable)
+{
+	OpenCacheData *data = task_data;
+	gchar         *hash;
+	gchar         *dir;
+	gchar         *basename;
+
+	hash = get_document_hash (data->uri, cancellable);
+	if (!hash) {
+		g_task_return_boolean (task, FALSE);
+		return;
+	}
+
+	dir = get_cache_dir ();
+	basename = g_strdup_printf ("%s-%d.thumbs", hash, data->rotation);
+	data->filename = g_build_filename (dir, basename, NULL);
+	g_free (basename);
+	g_free (dir);
+	g_free (hash);
+
+	data->mapped_file = map_cache_file (data->filename, data->n_pages,
+					    data->width, data->rotation);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+open_cache_finished_cb (GObject      *source_object,
+			GAsyncResult *result,
+			gpointer      user_data)
+{
+	EvThumbnailCache *cache;
+	OpenCacheData    *data;
+	gint              i;
+
+	/* Fails when the cache was freed meanwhile */
+	if (!g_task_propagate_boolean (G_TASK (result), NULL))
+		return;
+
+	cache = (EvThumbnailCache *)user_data;
+	data = g_task_get_task_data (G_TASK (result));
+
+	cache->filename = data->filename;
+	data->filename = NULL;
+	cache->mapped_file = data->mapped_file;
+	data->mapped_file = NULL;
+	if (!cache->mapped_file)
+		return;
+
+	cache->index = (const guchar *)g_mapped_file_get_contents (cache->mapped_file) + CACHE_HEADER_SIZE;
+	cache->length = g_mapped_file_get_length (cache->mapped_file);
+
+	/* The stored sizes are the ones of the stored thumbnails */
+	for (i = 0; i < cache->n_pages; i++) {
+		const guchar *entry = cache->index + i * CACHE_ENTRY_SIZE;
+		guint16       width, height;
+
+		width = read_uint16 (entry + 8);
+		height = read_uint16 (entry + 10);
+		if (width == 0 || height == 0)
+			continue;
+
+		cache->sizes[2 * i] = width;
+		cache->sizes[2 * i + 1] = height;
+	}
+
+	if (cache->loaded_func)
+		cache->loaded_func (cache, cache->loaded_data);
+}
+
+/* Returns the thumbnail stored in the file for @page, if any */
+static gboolean
+ev_thumbnail_cache_get_stored (EvThumbnailCache *cache,
+			       gint              page,
+			       const guchar    **data,
+			       gsize            *length)
+{
+	const guchar *entry;
+	guint32       offset, size;
+
+	if (!cache->mapped_file)
+		return FALSE;
+
+	entry = cache->index + page * CACHE_ENTRY_SIZE;
+	offset = read_uint32 (entry);
+	size = read_uint32 (entry + 4);
+	if (size == 0 || offset > cache->length || size > cache->length - offset)
+		return FALSE;
+
+	*data = (const guchar *)g_mapped_file_get_contents (cache->mapped_file) + offset;
+	*length = size;
+
+	return TRUE;
+}
+
+/*
+ * ev_thumbnail_cache_new:
+ * @document: the #EvDocument
+ * @width: the width of the thumbnails
+ * @rotation: the rotation of the thumbnails
+ * @loaded_func: (allow-none): function called when cached thumbnails are found
+ * @user_data: user data to pass to @loaded_func
+ *
+ * Opens the thumbnail cache of @document, creating an empty one when
+ * there are no cached thumbnails yet. The cache file is looked up in a
+ * thread, until then the cache is empty; @loaded_func is called once the
+ * stored thumbnails and page sizes are available, unless the cache is
+ * freed before.
+ *
+ * Returns: a new #EvThumbnailCache, or %NULL if the document must not
+ *   be cached
+ */
+EvThumbnailCache *
+ev_thumbnail_cache_new (EvDocument                *document,
+			gint                       width,
+			gint                       rotation,
+			EvThumbnailCacheLoadedFunc loaded_func,
+			gpointer                   user_data)
+{
+	EvThumbnailCache *cache;
+	OpenCacheData    *data;
+	GTask            *task;
+	const gchar      *uri;
+
+	if (g_object_get_data (G_OBJECT (document), EV_THUMBNAIL_CACHE_DISABLED_KEY))
+		return NULL;
+
+	uri = ev_document_get_uri (document);
+	if (!uri)
+		return NULL;
+
+	cache = g_new0 (EvThumbnailCache, 1);
+	cache->n_pages = ev_document_get_n_pages (document);
+	cache->width = width;
+	cache->rotation = rotation;
+	cache->sizes = g_new0 (guint16, 2 * cache->n_pages);
+	cache->new_thumbnails = g_new0 (GBytes *, cache->n_pages);
+	cache->cancellable = g_cancellable_new ();
+	cache->loaded_func = loaded_func;
+	cache->loaded_data = user_data;
+
+	data = g_slice_new0 (OpenCacheData);
+	data->uri = g_strdup (uri);
+	data->n_pages = cache->n_pages;
+	data->width = width;
+	data->rotation = rotation;
+
+	task = g_task_new (NULL, cache->cancellable, open_cache_finished_cb, cache);
+	g_task_set_task_data (task, data, (GDestroyNotify)open_cache_data_free);
+	g_task_run_in_thread (task, open_cache_thread);
+	g_object_unref (task);
+
+	return cache;
+}
+
+static void
+ev_thumbnail_cache_destroy (EvThumbnailCache *cache)
+{
+	gint i;
+
+	if (cache->mapped_file)
+		g_mapped_file_unref (cache->mapped_file);
+
+	for (i = 0; i < cache->n_pages; i++) {
+		if (cache->new_thumbnails[i])
+			g_bytes_unref (cache->new_thumbnails[i]);
+	}
+	g_free (cache->new_thumbnails);
+	g_free (cache->sizes);
+	g_object_unref (cache->cancellable);
+	g_free (cache->filename);
+	g_free (cache);
+}
+
+/* Whether there are thumbnails or page sizes not in the file yet */
+static gboolean
+ev_thumbnail_cache_needs_save (EvThumbnailCache *cache)
+{
+	gint i;
+
+	if (!cache->filename)
+		return FALSE;
+
+	for (i = 0; i < cache->n_pages; i++) {
+		const guchar *entry;
+
+		if (cache->new_thumbnails[i])
+			return TRUE;
+
+		if (!cache->mapped_file) {
+			if (cache->sizes[2 * i] != 0 || cache->sizes[2 * i + 1] != 0)
+				return TRUE;
+			continue;
+		}
+
+		entry = cache->index + i * CACHE_ENTRY_SIZE;
+		if (cache->sizes[2 * i] != read_uint16 (entry + 8) ||
+		    cache->sizes[2 * i + 1] != read_uint16 (entry + 10))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void ev_thumbnail_cache_save_thread (GTask        *task,
+					    gpointer      source_object,
+					    gpointer      task_data,
+					    GCancellable *cancellable);
+
+/*
+ * ev_thumbnail_cache_free:
+ *
+ * Frees the cache. The thumbnails rendered since it was opened are
+ * saved in a thread, the ones still being encoded are dropped.
+ */
+void
+ev_thumbnail_cache_free (EvThumbnailCache *cache)
+{
+	GTask *task;
+
+	if (!cache)
+		return;
+
+	g_cancellable_cancel (cache->cancellable);
+
+	if (!ev_thumbnail_cache_needs_save (cache)) {
+		ev_thumbnail_cache_destroy (cache);
+		return;
+	}
+
+	/* The save thread owns the cache from now on */
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, cache, (GDestroyNotify)ev_thumbnail_cache_destroy);
+	g_task_run_in_thread (task, ev_thumbnail_cache_save_thread);
+	g_object_unref (task);
+}
+
+gboolean
+ev_thumbnail_cache_get_page_size (EvThumbnailCache *cache,
+				  gint              page,
+				  gint             *width,
+				  gint             *height)
+{
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, FALSE);
+
+	if (cache->sizes[2 * page] == 0 || cache->sizes[2 * page + 1] == 0)
+		return FALSE;
+
+	*width = cache->sizes[2 * page];
+	*height = cache->sizes[2 * page + 1];
+
+	return TRUE;
+}
+
+void
+ev_thumbnail_cache_set_page_size (EvThumbnailCache *cache,
+				  gint              page,
+				  gint              width,
+				  gint              height)
+{
+	g_return_if_fail (page >= 0 && page < cache->n_pages);
+
+	cache->sizes[2 * page] = CLAMP (width, 0, G_MAXUINT16);
+	cache->sizes[2 * page + 1] = CLAMP (height, 0, G_MAXUINT16);
+}
+
+static GdkPixbuf *
+decode_thumbnail (const guchar *data,
+		  gsize         length)
+{
+	GdkPixbufLoader *loader;
+	GdkPixbuf       *pixbuf = NULL;
+
+	loader = gdk_pixbuf_loader_new_with_type ("png", NULL);
+	if (!loader)
+		return NULL;
+
+	if (gdk_pixbuf_loader_write (loader, data, length, NULL) &&
+	    gdk_pixbuf_loader_close (loader, NULL)) {
+		pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+		if (pixbuf)
+			g_object_ref (pixbuf);
+	} else {
+		gdk_pixbuf_loader_close (loader, NULL);
+	}
+	g_object_unref (loader);
+
+	return pixbuf;
+}
+
+/*
+ * ev_thumbnail_cache_lookup:
+ * @cache: an #EvThumbnailCache
+ * @page: the page index
+ *
+ * Returns: (transfer full): the cached thumbnail of @page, or %NULL
+ */
+GdkPixbuf *
+ev_thumbnail_cache_lookup (EvThumbnailCache *cache,
+			   gint              page)
+{
+	const guchar *data;
+	gsize         length;
+
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, NULL);
+
+	if (cache->new_thumbnails[page]) {
+		data = g_bytes_get_data (cache->new_thumbnails[page], &length);
+
+		return decode_thumbnail (data, length);
+	}
+
+	if (ev_thumbnail_cache_get_stored (cache, page, &data, &length))
+		return decode_thumbnail (data, length);
+
+	return NULL;
+}
+
+typedef struct {
+	GdkPixbuf *thumbnail;
+	gint       page;
+} StoreThumbnailData;
+
+static void
+store_thumbnail_data_free (StoreThumbnailData *data)
+{
+	g_object_unref (data->thumbnail);
+	g_slice_free (StoreThumbnailData, data);
+}
+
+static void
+encode_thumbnail_thread (GTask        *task,
+			 gpointer      source_object,
+			 gpointer      task_data,
+			 GCancellable *cancellable)
+{
+	StoreThumbnailData *data = task_data;
+	gchar              *buffer;
+	gsize               length;
+	GError             *error = NULL;
+
+	if (!gdk_pixbuf_save_to_buffer (data->thumbnail, &buffer, &length, "png", &error, NULL)) {
+		g_task_return_error (task, error);
+		return;
+	}
+
+	g_task_return_pointer (task, g_bytes_new_take (buffer, length),
+			       (GDestroyNotify)g_bytes_unref);
+}
+
+static void
+encode_thumbnail_finished_cb (GObject      *source_object,
+			      GAsyncResult *result,
+			      gpointer      user_data)
+{
+	EvThumbnailCache   *cache;
+	StoreThumbnailData *data;
+	GBytes             *bytes;
+
+	/* Fails as well when the cache was freed meanwhile */
+	bytes = g_task_propagate_pointer (G_TASK (result), NULL);
+	if (!bytes)
+		return;
+
+	cache = (EvThumbnailCache *)user_data;
+	data = g_task_get_task_data (G_TASK (result));
+
+	if (cache->new_thumbnails[data->page])
+		g_bytes_unref (cache->new_thumbnails[data->page]);
+	cache->new_thumbnails[data->page] = bytes;
+}
+
+/*
+ * ev_thumbnail_cache_store:
+ * @cache: an #EvThumbnailCache
+ * @page: the page index
+ * @thumbnail: the thumbnail of @page
+ *
+ * Adds @thumbnail to the cache. It's encoded in a thread, and can be
+ * looked up once that's done.
+ */
+void
+ev_thumbnail_cache_store (EvThumbnailCache *cache,
+			  gint              page,
+			  GdkPixbuf        *thumbnail)
+{
+	StoreThumbnailData *data;
+	GTask              *task;
+
+	g_return_if_fail (page >= 0 && page < cache->n_pages);
+
+	data = g_slice_new (StoreThumbnailData);
+	data->thumbnail = g_object_ref (thumbnail);
+	data->page = page;
+
+	task = g_task_new (NULL, cache->cancellable, encode_thumbnail_finished_cb, cache);
+	g_task_set_task_data (task, data, (GDestroyNotify)store_thumbnail_data_free);
+	g_task_run_in_thread (task, encode_thumbnail_thread);
+	g_object_unref (task);
+}
+
+typedef struct {
+	gchar  *path;
+	time_t  mtime;
+} CacheFileInfo;
+
+static gint
+compare_cache_file_info (gconstpointer a,
+			 gconstpointer b)
+{
+	const CacheFileInfo *info_a = a;
+	const CacheFileInfo *info_b = b;
+
+	return info_a->mtime < info_b->mtime ? -1 : (info_a->mtime > info_b->mtime ? 1 : 0);
+}
+
+/* Keeps the thumbnails of the most recently used documents only */
+static void
+prune_cache_dir (const gchar *dir)
+{
+	GDir        *gdir;
+	const gchar *name;
+	GArray      *files;
+	guint        i;
+
+	gdir = g_dir_open (dir, 0, NULL);
+	if (!gdir)
+		return;
+
+	files = g_array_new (FALSE, FALSE, sizeof (CacheFileInfo));
+	while ((name = g_dir_read_name (gdir))) {
+		CacheFileInfo info;
+		GStatBuf      statbuf;
+
+		if (!g_str_has_suffix (name, ".thumbs"))
+			continue;
+
+		info.path = g_build_filename (dir, name, NULL);
+		if (g_stat (info.path, &statbuf) != 0) {
+			g_free (info.path);
+			continue;
+		}
+		info.mtime = statbuf.st_mtime;
+		g_array_append_val (files, info);
+	}
+	g_dir_close (gdir);
+
+	if (files->len > MAX_CACHED_DOCUMENTS) {
+		g_array_sort (files, compare_cache_file_info);
+		for (i = 0; i < files->len - MAX_CACHED_DOCUMENTS; i++)
+			g_unlink (g_array_index (files, CacheFileInfo, i).path);
+	}
+
+	for (i = 0; i < files->len; i++)
+		g_free (g_array_index (files, CacheFileInfo, i).path);
+	g_array_free (files, TRUE);
+}
+
+/*
+ * Writes the cache file, merging the thumbnails rendered since it was
+ * opened with the ones already stored, and prunes the cache directory.
+ * Runs in a thread, owning @cache.
+ */
+static void
+ev_thumbnail_cache_save_thread (GTask        *task,
+				gpointer      source_object,
+				gpointer      task_data,
+				GCancellable *cancellable)
+{
+	EvThumbnailCache *cache = task_data;
+	GByteArray       *contents;
+	gchar            *dir;
+	guint32           offset;
+	gint              i;
+
+	dir = get_cache_dir ();
+	if (g_mkdir_with_parents (dir, 0700) != 0) {
+		g_free (dir);
+		g_task_return_boolean (task, FALSE);
+		return;
+	}
+
+	contents = g_byte_array_new ();
+	g_byte_array_append (contents, (const guint8 *)CACHE_MAGIC, 4);
+	append_uint32 (contents, CACHE_VERSION);
+	append_uint32 (contents, cache->n_pages);
+	append_uint32 (contents, cache->width);
+	append_uint32 (contents, cache->rotation);
+
+	offset = CACHE_HEADER_SIZE + cache->n_pages * CACHE_ENTRY_SIZE;
+	for (i = 0; i < cache->n_pages; i++) {
+		const guchar *data;
+		gsize         length = 0;
+
+		if (cache->new_thumbnails[i])
+			g_bytes_get_data (cache->new_thumbnails[i], &length);
+		else if (!ev_thumbnail_cache_get_stored (cache, i, &data, &length))
+			length = 0;
+
+		append_uint32 (contents, length ? offset : 0);
+		append_uint32 (contents, length);
+		append_uint16 (contents, cache->sizes[2 * i]);
+		append_uint16 (contents, cache->sizes[2 * i + 1]);
+		offset += length;
+	}
+
+	for (i = 0; i < cache->n_pages; i++) {
+		const guchar *data;
+		gsize         length;
+
+		if (cache->new_thumbnails[i]) {
+			data = g_bytes_get_data (cache->new_thumbnails[i], &length);
+			g_byte_array_append (contents, data, length);
+		} else if (ev_thumbnail_cache_get_stored (cache, i, &data, &length)) {
+			g_byte_array_append (contents, data, length);
+		}
+	}
+
+	/* The file is replaced atomically, so mappings of it by other
+	 * caches of the same document are still valid */
+	if (g_file_set_contents (cache->filename, (const gchar *)contents->data,
+				 contents->len, NULL))
+		prune_cache_dir (dir);
+
+	g_byte_array_free (contents, TRUE);
+	g_free (dir);
+
+	g_task_return_boolean (task, TRUE);
+}
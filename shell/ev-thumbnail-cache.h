@@ -0,0 +1,58 @@
+/* ev-thumbnail-cache.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __EV_THUMBNAIL_CACHE_H__
+#define __EV_THUMBNAIL_CACHE_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "ev-document.h"
+
+G_BEGIN_DECLS
+
+/* Set on documents whose thumbnails must not be written to disk */
+#define EV_THUMBNAIL_CACHE_DISABLED_KEY "ev-thumbnail-cache-disabled"
+
+typedef struct _EvThumbnailCache EvThumbnailCache;
+
+typedef void (* EvThumbnailCacheLoadedFunc) (EvThumbnailCache *cache,
+					     gpointer          user_data);
+
+EvThumbnailCache *ev_thumbnail_cache_new           (EvDocument       *document,
+						    gint              width,
+						    gint              rotation,
+						    EvThumbnailCacheLoadedFunc loaded_func,
+						    gpointer          user_data);
+void              ev_thumbnail_cache_free          (EvThumbnailCache *cache);
+gboolean          ev_thumbnail_cache_get_page_size (EvThumbnailCache *cache,
+						    gint              page,
+						    gint             *width,
+						    gint             *height);
+void              ev_thumbnail_cache_set_page_size (EvThumbnailCache *cache,
+						    gint              page,
+						    gint              width,
+						    gint              height);
+GdkPixbuf        *ev_thumbnail_cache_lookup        (EvThumbnailCache *cache,
+						    gint              page);
+void              ev_thumbnail_cache_store         (EvThumbnailCache *cache,
+						    gint              page,
+						    GdkPixbuf        *thumbnail);
+
+G_END_DECLS
+
+#endif /* __EV_THUMBNAIL_CACHE_H__ */
@@ -67,6 +67,7 @@
 #include "ev-page-action.h"
 #include "ev-history-action.h"
 #include "ev-password-view.h"
+#include "ev-thumbnail-cache.h"
 #include "ev-properties-dialog.h"
 #include "ev-sidebar-annotations.h"
 #include "ev-sidebar-attachments.h"
@@ -228,6 +229,8 @@ struct _EvWindowPrivate {
 	/* DBus */
 	EvEvinceWindow *skeleton;
 	gchar          *dbus_object_path;
+	/* SyncView waiting for the synctex file to be parsed */
+	EvSourceLink   *pending_sync_link;
 #endif
 
         guint presentation_mode_inhibit_id;
@@ -259,6 +262,7 @@ struct _EvWindowPrivate {
 #define GS_OVERRIDE_RESTRICTIONS "override-restrictions"
 #define GS_PAGE_CACHE_SIZE       "page-cache-size"
 #define GS_AUTO_RELOAD           "auto-reload"
+#define GS_AUTO_RELOAD_DELAY     "auto-reload-delay"
 #define GS_LAST_DOCUMENT_DIRECTORY "document-directory"
 #define GS_LAST_PICTURES_DIRECTORY "pictures-directory"
 
@@ -375,6 +379,7 @@ static void     ev_window_media_player_key_pressed      (EvWindow         *windo
 #ifdef ENABLE_DBUS
 static void	ev_window_emit_closed			(EvWindow         *window);
 static void 	ev_window_emit_doc_loaded		(EvWindow	  *window);
+static void	ev_window_clear_pending_sync_view	(EvWindow	  *window);
 #endif
 static void     ev_window_setup_bookmarks               (EvWindow         *window);
 
@@ -763,12 +768,27 @@ ev_window_warning_message (EvWindow    *window,
 	ev_window_set_message_area (window, area);
 }
 
+static gboolean
+update_loading_message_cb (EvWindow *window)
+{
+	ev_loading_message_set_time_remaining (EV_LOADING_MESSAGE (window->priv->loading_message),
+					       ev_view_get_loading_time_remaining (EV_VIEW (window->priv->view)));
+
+	return TRUE;
+}
+
 static gboolean
 show_loading_message_cb (EvWindow *window)
 {
-	window->priv->loading_message_timeout = 0;
+	update_loading_message_cb (window);
 	gtk_widget_show (window->priv->loading_message);
 
+	/* The estimate changes as the pages get rendered */
+	window->priv->loading_message_timeout =
+		g_timeout_add_seconds_full (G_PRIORITY_LOW, 1,
+					    (GSourceFunc)update_loading_message_cb,
+					    window, NULL);
+
 	return FALSE;
 }
 
@@ -838,6 +858,7 @@ ev_window_find_title_for_link (EvWindow *window,
 			      "model", &model,
 			      NULL);
 		if (model) {
+			/* Nodes not expanded yet are not built for this */
 			gtk_tree_model_foreach (model,
 						(GtkTreeModelForeachFunc)find_link_cb,
 						&data);
@@ -1434,6 +1455,18 @@ lockdown_changed (GSettings   *lockdown,
 }
 #endif
 
+static void
+auto_reload_delay_changed (GSettings *settings,
+			   gchar     *key,
+			   EvWindow  *ev_window)
+{
+	if (!ev_window->priv->monitor)
+		return;
+
+	ev_file_monitor_set_debounce_interval (ev_window->priv->monitor,
+					       g_settings_get_uint (settings, GS_AUTO_RELOAD_DELAY));
+}
+
 static GSettings *
 ev_window_ensure_settings (EvWindow *ev_window)
 {
@@ -1451,6 +1484,10 @@ ev_window_ensure_settings (EvWindow *ev_window)
 			  "changed::"GS_PAGE_CACHE_SIZE,
 			  G_CALLBACK (page_cache_size_changed),
 			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_AUTO_RELOAD_DELAY,
+			  G_CALLBACK (auto_reload_delay_changed),
+			  ev_window);
 
         return priv->settings;
 }
@@ -1524,6 +1561,9 @@ ev_window_set_document (EvWindow *ev_window, EvDocument *document)
 	if (ev_window->priv->document == document)
 		return;
 
+#ifdef ENABLE_DBUS
+	ev_window_clear_pending_sync_view (ev_window);
+#endif
 	if (ev_window->priv->document)
 		g_object_unref (ev_window->priv->document);
 	ev_window->priv->document = g_object_ref (document);
@@ -1566,6 +1606,19 @@ ev_window_document_changed (EvWindow *ev_window,
 		ev_window_reload_document (ev_window, NULL);
 }
 
+static void
+ev_window_setup_file_monitor (EvWindow *ev_window)
+{
+	GSettings *settings = ev_window_ensure_settings (ev_window);
+
+	ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
+	ev_file_monitor_set_debounce_interval (ev_window->priv->monitor,
+					       g_settings_get_uint (settings, GS_AUTO_RELOAD_DELAY));
+	g_signal_connect_swapped (ev_window->priv->monitor, "changed",
+				  G_CALLBACK (ev_window_document_changed),
+				  ev_window);
+}
+
 static void
 ev_window_password_view_unlock (EvWindow *ev_window)
 {
@@ -1654,6 +1707,13 @@ ev_window_load_job_cb (EvJob *job,
 
 	/* Success! */
 	if (!ev_job_is_failed (job)) {
+		/* Don't keep thumbnails of protected documents on disk */
+		if (job_load->password) {
+			g_object_set_data (G_OBJECT (document),
+					   EV_THUMBNAIL_CACHE_DISABLED_KEY,
+					   GINT_TO_POINTER (TRUE));
+		}
+
 		ev_document_model_set_document (ev_window->priv->model, document);
 
 #ifdef ENABLE_DBUS
@@ -1692,10 +1752,7 @@ ev_window_load_job_cb (EvJob *job,
 		}
 
 		/* Create a monitor for the document */
-		ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
-		g_signal_connect_swapped (ev_window->priv->monitor, "changed",
-					  G_CALLBACK (ev_window_document_changed),
-					  ev_window);
+		ev_window_setup_file_monitor (ev_window);
 		
 		ev_window_clear_load_job (ev_window);
 		return;
@@ -2233,10 +2290,7 @@ ev_window_open_document (EvWindow       *ev_window,
 	}
 
 	/* Create a monitor for the document */
-	ev_window->priv->monitor = ev_file_monitor_new (ev_window->priv->uri);
-	g_signal_connect_swapped (ev_window->priv->monitor, "changed",
-				  G_CALLBACK (ev_window_document_changed),
-				  ev_window);
+	ev_window_setup_file_monitor (ev_window);
 }
 
 static void
@@ -5853,6 +5907,9 @@ ev_window_dispose (GObject *object)
 		priv->model = NULL;
 	}
 
+#ifdef ENABLE_DBUS
+	ev_window_clear_pending_sync_view (window);
+#endif
 	if (priv->document) {
 		g_object_unref (priv->document);
 		priv->document = NULL;
@@ -7254,6 +7311,36 @@ ev_window_emit_doc_loaded (EvWindow *window)
         ev_evince_window_emit_document_loaded (window->priv->skeleton, window->priv->uri);
 }
 
+static void
+ev_window_synctex_parsed_cb (EvDocument *document,
+			    EvWindow   *window)
+{
+	EvSourceLink *link = window->priv->pending_sync_link;
+
+	window->priv->pending_sync_link = NULL;
+	g_signal_handlers_disconnect_by_func (document,
+					      ev_window_synctex_parsed_cb,
+					      window);
+
+	if (link && ev_document_has_synctex (document))
+		ev_view_highlight_forward_search (EV_VIEW (window->priv->view), link);
+	if (link)
+		ev_source_link_free (link);
+}
+
+static void
+ev_window_clear_pending_sync_view (EvWindow *window)
+{
+	if (!window->priv->pending_sync_link)
+		return;
+
+	g_signal_handlers_disconnect_by_func (window->priv->document,
+					      ev_window_synctex_parsed_cb,
+					      window);
+	ev_source_link_free (window->priv->pending_sync_link);
+	window->priv->pending_sync_link = NULL;
+}
+
 static gboolean
 handle_sync_view_cb (EvEvinceWindow        *object,
 		     GDBusMethodInvocation *invocation,
@@ -7262,13 +7349,29 @@ handle_sync_view_cb (EvEvinceWindow        *object,
 		     guint                  timestamp,
 		     EvWindow              *window)
 {
-	if (window->priv->document && ev_document_has_synctex (window->priv->document)) {
+	EvDocument *document = window->priv->document;
+
+	if (document && ev_document_has_synctex (document)) {
 		EvSourceLink link;
 
 		link.filename = (char *) source_file;
 		g_variant_get (source_point, "(ii)", &link.line, &link.col);
 		ev_view_highlight_forward_search (EV_VIEW (window->priv->view), &link);
 		gtk_window_present_with_time (GTK_WINDOW (window), timestamp);
+	} else if (document && ev_document_is_parsing_synctex (document)) {
+		gint line, col;
+
+		/* Answered once the synctex file has been parsed, only
+		 * the last request matters */
+		g_variant_get (source_point, "(ii)", &line, &col);
+		if (!window->priv->pending_sync_link)
+			g_signal_connect (document, "synctex-parsed",
+					  G_CALLBACK (ev_window_synctex_parsed_cb),
+					  window);
+		else
+			ev_source_link_free (window->priv->pending_sync_link);
+		window->priv->pending_sync_link = ev_source_link_new (source_file, line, col);
+		gtk_window_present_with_time (GTK_WINDOW (window), timestamp);
 	}
 
 	ev_evince_window_complete_sync_view (object, invocation);
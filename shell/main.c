@@ -32,6 +32,13 @@
 #include "ev-file-helpers.h"
 #include "ev-stock-icons.h"
 #include "ev-metadata.h"
+#include "ev-trace.h"
+
+#ifdef G_OS_UNIX
+#include <signal.h>
+#include <unistd.h>
+#include <glib-unix.h>
+#endif
 
 #ifdef WITH_SMCLIENT
 #include "eggsmclient.h"
@@ -145,6 +152,42 @@ launch_previewer (void)
 	return retval;
 }
 
+#ifdef G_OS_UNIX
+/* SIGUSR1 starts recording a trace of the jobs, the next one writes it to
+ * the temporary directory, so that a slow session can be inspected without
+ * restarting evince with EV_TRACE.
+ */
+static gboolean
+toggle_trace_cb (gpointer data)
+{
+	gchar  *basename;
+	gchar  *filename;
+	GError *error = NULL;
+
+	if (!ev_trace_is_enabled ()) {
+		ev_trace_set_enabled (TRUE);
+
+		return TRUE;
+	}
+
+	basename = g_strdup_printf ("evince-trace-%d.json", getpid ());
+	filename = g_build_filename (g_get_tmp_dir (), basename, NULL);
+	g_free (basename);
+
+	if (ev_trace_dump (filename, &error)) {
+		g_printerr ("Trace written to %s\n", filename);
+	} else {
+		g_printerr ("Failed to write trace: %s\n", error->message);
+		g_error_free (error);
+	}
+	g_free (filename);
+
+	ev_trace_set_enabled (FALSE);
+
+	return TRUE;
+}
+#endif /* G_OS_UNIX */
+
 static gchar *
 get_label_from_filename (const gchar *filename)
 {
@@ -176,6 +219,17 @@ load_files (const char **files)
 	EvLinkDest      *global_dest = NULL;
 
 	if (!files) {
+		/* Let the evince process hosting the documents show a window */
+		if (g_application_get_is_remote (G_APPLICATION (EV_APP))) {
+			GDBusConnection *connection;
+
+			g_application_activate (G_APPLICATION (EV_APP));
+			connection = g_application_get_dbus_connection (G_APPLICATION (EV_APP));
+			if (connection)
+				g_dbus_connection_flush_sync (connection, NULL, NULL);
+			return;
+		}
+
 		if (!ev_application_has_window (EV_APP))
 			ev_application_open_window (EV_APP, screen, GDK_CURRENT_TIME);
 		return;
@@ -324,11 +378,21 @@ main (int argc, char *argv[])
 	ev_application_load_session (application);
 	load_files (file_arguments);
 
+	/* The documents have been sent to the evince process hosting them */
+	if (g_application_get_is_remote (G_APPLICATION (application))) {
+		status = 0;
+		goto done;
+	}
+
 	/* Change directory so we don't prevent unmounting in case the initial cwd
 	 * is on an external device (see bug #575436)
 	 */
 	g_chdir (g_get_home_dir ());
 
+#ifdef G_OS_UNIX
+	g_unix_signal_add (SIGUSR1, toggle_trace_cb, NULL);
+#endif
+
 	status = g_application_run (G_APPLICATION (application), 0, NULL);
 
     done:
@@ -0,0 +1,368 @@
+/* ev-bench.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Renders pages of a document without any UI and prints timings as JSON,
+ * so that the performance of the backends can be compared between releases:
+ *
+ *   ev-bench --pages=1-10 --scales=1,2 --rotations=0,90 --thumbnails doc.pdf
+ */
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#define THUMBNAIL_SIZE 128
+
+static gchar        *pages_option = NULL;
+static gchar        *scales_option = NULL;
+static gchar        *rotations_option = NULL;
+static gint          iterations = 1;
+static gboolean      thumbnails = FALSE;
+static const gchar **file_arguments = NULL;
+
+static const GOptionEntry goption_options[] = {
+	{ "pages", 'p', 0, G_OPTION_ARG_STRING, &pages_option, "Pages to render, like 1-10,15 (all by default)", "PAGES" },
+	{ "scales", 's', 0, G_OPTION_ARG_STRING, &scales_option, "Comma separated list of scales (1 by default)", "SCALES" },
+	{ "rotations", 'r', 0, G_OPTION_ARG_STRING, &rotations_option, "Comma separated list of rotations (0 by default)", "ROTATIONS" },
+	{ "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Number of times every page is rendered", "N" },
+	{ "thumbnails", 't', 0, G_OPTION_ARG_NONE, &thumbnails, "Also measure thumbnails", NULL },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "FILE" },
+	{ NULL }
+};
+
+typedef enum {
+	BENCH_RENDER,
+	BENCH_THUMBNAIL
+} BenchOperation;
+
+static gboolean
+parse_pages (const gchar *option,
+	     gint         n_pages,
+	     GArray      *pages)
+{
+	gchar **ranges;
+	gint    i;
+
+	if (!option) {
+		for (i = 0; i < n_pages; i++)
+			g_array_append_val (pages, i);
+
+		return TRUE;
+	}
+
+	ranges = g_strsplit (option, ",", -1);
+	for (i = 0; ranges[i]; i++) {
+		gchar *end;
+		gint   first, last, page;
+
+		first = last = strtol (ranges[i], &end, 10);
+		if (*end == '-')
+			last = strtol (end + 1, &end, 10);
+
+		if (*end != '\0' || first < 1 || last < first || last > n_pages) {
+			g_printerr ("Invalid page range: %s\n", ranges[i]);
+			g_strfreev (ranges);
+
+			return FALSE;
+		}
+
+		for (page = first - 1; page < last; page++)
+			g_array_append_val (pages, page);
+	}
+	g_strfreev (ranges);
+
+	return TRUE;
+}
+
+static gboolean
+parse_doubles (const gchar *option,
+	       const gchar *default_value,
+	       GArray      *values)
+{
+	gchar **tokens;
+	gint    i;
+
+	tokens = g_strsplit (option ? option : default_value, ",", -1);
+	for (i = 0; tokens[i]; i++) {
+		gchar  *end;
+		gdouble value;
+
+		value = g_ascii_strtod (tokens[i], &end);
+		if (*end != '\0' || end == tokens[i]) {
+			g_printerr ("Invalid value: %s\n", tokens[i]);
+			g_strfreev (tokens);
+
+			return FALSE;
+		}
+		g_array_append_val (values, value);
+	}
+	g_strfreev (tokens);
+
+	return TRUE;
+}
+
+static glong
+get_peak_rss (void)
+{
+#ifdef HAVE_SYS_RESOURCE_H
+	struct rusage usage;
+
+	/* In kilobytes on Linux */
+	if (getrusage (RUSAGE_SELF, &usage) == 0)
+		return usage.ru_maxrss;
+#endif
+	return -1;
+}
+
+static gint
+compare_doubles (gconstpointer a,
+		 gconstpointer b)
+{
+	gdouble da = *(const gdouble *)a;
+	gdouble db = *(const gdouble *)b;
+
+	return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static gdouble
+percentile (GArray *sorted,
+	    gdouble p)
+{
+	guint index;
+
+	if (sorted->len == 0)
+		return 0;
+
+	index = (guint)(p * (sorted->len - 1) + 0.5);
+
+	return g_array_index (sorted, gdouble, MIN (index, sorted->len - 1));
+}
+
+static void
+print_number (const gchar *name,
+	      gdouble      value,
+	      gboolean     last)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+	g_print ("\"%s\": %s%s", name,
+		 g_ascii_formatd (buffer, sizeof (buffer), "%.3f", value),
+		 last ? "" : ", ");
+}
+
+static void
+bench_run (EvDocument    *document,
+	   BenchOperation operation,
+	   GArray        *pages,
+	   gdouble        scale,
+	   gint           rotation,
+	   gboolean       first)
+{
+	GArray *samples;
+	gdouble total = 0;
+	guint   i;
+	gint    n;
+
+	samples = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), pages->len * iterations);
+
+	for (n = 0; n < iterations; n++) {
+		for (i = 0; i < pages->len; i++) {
+			gint             index = g_array_index (pages, gint, i);
+			EvPage          *page;
+			EvRenderContext *rc;
+			gdouble          page_scale = scale;
+			gint64           start;
+			gdouble          elapsed;
+
+			page = ev_document_get_page (document, index);
+			if (operation == BENCH_THUMBNAIL) {
+				gdouble width;
+
+				ev_document_get_page_size (document, index, &width, NULL);
+				page_scale = THUMBNAIL_SIZE / width;
+			}
+			rc = ev_render_context_new (page, rotation, page_scale);
+
+			start = g_get_monotonic_time ();
+			if (operation == BENCH_RENDER) {
+				cairo_surface_t *surface;
+
+				surface = ev_document_render (document, rc);
+				elapsed = (g_get_monotonic_time () - start) / 1000.;
+				if (surface)
+					cairo_surface_destroy (surface);
+			} else {
+				GdkPixbuf *pixbuf;
+
+				pixbuf = ev_document_get_thumbnail (document, rc);
+				elapsed = (g_get_monotonic_time () - start) / 1000.;
+				if (pixbuf)
+					g_object_unref (pixbuf);
+			}
+
+			g_object_unref (rc);
+			g_object_unref (page);
+
+			g_array_append_val (samples, elapsed);
+			total += elapsed;
+		}
+	}
+
+	g_array_sort (samples, compare_doubles);
+
+	g_print ("%s    { \"operation\": \"%s\", \"rotation\": %d, ",
+		 first ? "" : ",\n",
+		 operation == BENCH_RENDER ? "render" : "thumbnail",
+		 rotation);
+	if (operation == BENCH_RENDER)
+		print_number ("scale", scale, FALSE);
+	g_print ("\"samples\": %u, ", samples->len);
+	print_number ("total_ms", total, FALSE);
+	print_number ("pages_per_second", total > 0 ? samples->len * 1000. / total : 0, FALSE);
+	print_number ("mean_ms", samples->len > 0 ? total / samples->len : 0, FALSE);
+	print_number ("p50_ms", percentile (samples, 0.50), FALSE);
+	print_number ("p90_ms", percentile (samples, 0.90), FALSE);
+	print_number ("p99_ms", percentile (samples, 0.99), FALSE);
+	print_number ("max_ms", samples->len > 0 ? g_array_index (samples, gdouble, samples->len - 1) : 0, TRUE);
+	g_print (" }");
+
+	g_array_free (samples, TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	EvDocument     *document;
+	GArray         *pages;
+	GArray         *scales;
+	GArray         *rotations;
+	GFile          *file;
+	gchar          *uri;
+	gchar          *escaped;
+	gint64          start;
+	gdouble         load_time;
+	GError         *error = NULL;
+	gboolean        first = TRUE;
+	guint           i, j;
+	gint            retval = 0;
+
+	context = g_option_context_new ("- Evince rendering benchmark");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+
+		return 1;
+	}
+	g_option_context_free (context);
+
+	if (!file_arguments || !file_arguments[0]) {
+		g_printerr ("No document given\n");
+
+		return 1;
+	}
+
+	if (iterations < 1) {
+		g_printerr ("The number of iterations must be positive\n");
+
+		return 1;
+	}
+
+	if (!ev_init ())
+		return 1;
+
+	file = g_file_new_for_commandline_arg (file_arguments[0]);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	start = g_get_monotonic_time ();
+	document = ev_document_factory_get_document (uri, &error);
+	load_time = (g_get_monotonic_time () - start) / 1000.;
+	if (!document) {
+		g_printerr ("Error loading document %s: %s\n", uri, error->message);
+		g_error_free (error);
+		g_free (uri);
+		ev_shutdown ();
+
+		return 2;
+	}
+
+	if (EV_IS_ASYNC_RENDERER (document)) {
+		g_printerr ("Backends with asynchronous rendering are not supported\n");
+		g_object_unref (document);
+		g_free (uri);
+		ev_shutdown ();
+
+		return 2;
+	}
+
+	pages = g_array_new (FALSE, FALSE, sizeof (gint));
+	scales = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	rotations = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+	if (!parse_pages (pages_option, ev_document_get_n_pages (document), pages) ||
+	    !parse_doubles (scales_option, "1", scales) ||
+	    !parse_doubles (rotations_option, "0", rotations)) {
+		retval = 1;
+		goto out;
+	}
+
+	escaped = g_strescape (uri, NULL);
+	g_print ("{\n  \"document\": \"%s\",\n  \"backend\": \"%s\",\n  \"n_pages\": %d,\n  ",
+		 escaped, G_OBJECT_TYPE_NAME (document), ev_document_get_n_pages (document));
+	g_free (escaped);
+	print_number ("load_ms", load_time, TRUE);
+	g_print (",\n  \"runs\": [\n");
+
+	for (i = 0; i < rotations->len; i++) {
+		gint rotation = (gint)g_array_index (rotations, gdouble, i);
+
+		for (j = 0; j < scales->len; j++) {
+			bench_run (document, BENCH_RENDER, pages,
+				   g_array_index (scales, gdouble, j),
+				   rotation, first);
+			first = FALSE;
+		}
+
+		if (thumbnails) {
+			bench_run (document, BENCH_THUMBNAIL, pages, 0, rotation, first);
+			first = FALSE;
+		}
+	}
+
+	g_print ("\n  ],\n  \"peak_rss_kb\": %ld\n}\n", get_peak_rss ());
+
+ out:
+	g_array_free (pages, TRUE);
+	g_array_free (scales, TRUE);
+	g_array_free (rotations, TRUE);
+	g_object_unref (document);
+	g_free (uri);
+	ev_shutdown ();
+
+	return retval;
+}